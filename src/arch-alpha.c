@@ -205,7 +205,7 @@ alpha_apply_conflict_rela (struct prelink_info *info, GElf_Rela *rela,
       buf_write_le64 (buf, rela->r_addend);
       break;
     default:
-      abort ();
+      return 6;
     }
   return 0;
 }
@@ -270,7 +270,7 @@ i386_apply_conflict_rela (struct prelink_info *info, GElf_Rela *rela,
       ret->r_addend = rela->r_addend;
       break;
     default:
-      abort ();
+      return 6;
     }
   return 0;
 }
@@ -234,7 +234,7 @@ ia64_apply_conflict_rela (struct prelink_info *info, GElf_Rela *rela,
     case R_IA64_DIR64MSB: buf_write_be64 (buf, rela->r_addend); break;
     case R_IA64_DIR64LSB: buf_write_le64 (buf, rela->r_addend); break;
     default:
-      abort ();
+      return 6;
     }
   return 0;
 }
@@ -703,7 +703,7 @@ mips_apply_conflict_rela (struct prelink_info *info, GElf_Rela *rela,
       break;
 
     default:
-      abort ();
+      return 6;
     }
   return 0;
 }
@@ -161,7 +161,7 @@ sh_apply_conflict_rela (struct prelink_info *info, GElf_Rela *rela,
       buf_write_ne32 (info->dso, buf, rela->r_addend);
       break;
     default:
-      abort ();
+      return 6;
     }
   return 0;
 }
@@ -329,7 +329,7 @@ sparc64_apply_conflict_rela (struct prelink_info *info, GElf_Rela *rela,
       buf_write_8 (buf, rela->r_addend);
       break;
     default:
-      abort ();
+      return 6;
     }
   return 0;
 }
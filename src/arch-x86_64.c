@@ -198,7 +198,7 @@ x86_64_apply_conflict_rela (struct prelink_info *info, GElf_Rela *rela,
       buf_write_le32 (buf, rela->r_addend);
       break;
     default:
-      abort ();
+      return 6;
     }
   return 0;
 }
@@ -0,0 +1,374 @@
+/* blake3.c - Functions to compute the BLAKE3 hash (message-digest) of
+   files or blocks of memory, in its default 32 byte hash mode.
+
+   Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include "md5.h"
+#include "blake3.h"
+
+/* BLAKE3 splits the input into 1024 byte chunks, hashes each of them
+   separately and combines the results in a binary tree.  Whole chunks
+   are hashed BLAKE3_LANES at a time, using GCC vector extensions for
+   the BLAKE3_LANES independent compressions.  That gives SSE2 code on
+   x86 (and AVX2 code in a separately compiled copy for CPUs which have
+   it) and NEON code on ARM without writing any of them by hand.  */
+#define BLAKE3_CHUNK_LEN	1024
+#define BLAKE3_LANES		8
+
+#define CHUNK_START		1
+#define CHUNK_END		2
+#define PARENT			4
+#define ROOT			8
+
+#if (defined __x86_64__ || defined __i386__) && defined __GNUC__ \
+    && __GNUC__ >= 5
+# define BLAKE3_X86_AVX2 1
+#endif
+
+static const md5_uint32 blake3_iv[8] =
+{
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/* Message word order in each of the 7 rounds.  */
+static const unsigned char blake3_schedule[7][16] =
+{
+  { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+  { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+  { 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+  { 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+  { 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+  { 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+  { 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 }
+};
+
+static inline md5_uint32
+load_le32 (const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((md5_uint32) p[3] << 24);
+}
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define G(v, a, b, c, d, x, y) \
+  do								\
+    {								\
+      v[a] = v[a] + v[b] + (x);					\
+      v[d] = ROR (v[d] ^ v[a], 16);				\
+      v[c] = v[c] + v[d];					\
+      v[b] = ROR (v[b] ^ v[c], 12);				\
+      v[a] = v[a] + v[b] + (y);					\
+      v[d] = ROR (v[d] ^ v[a], 8);				\
+      v[c] = v[c] + v[d];					\
+      v[b] = ROR (v[b] ^ v[c], 7);				\
+    }								\
+  while (0)
+
+#define ROUND(v, m, r) \
+  do								\
+    {								\
+      const unsigned char *s = blake3_schedule[r];		\
+      G (v, 0, 4, 8, 12, m[s[0]], m[s[1]]);			\
+      G (v, 1, 5, 9, 13, m[s[2]], m[s[3]]);			\
+      G (v, 2, 6, 10, 14, m[s[4]], m[s[5]]);			\
+      G (v, 3, 7, 11, 15, m[s[6]], m[s[7]]);			\
+      G (v, 0, 5, 10, 15, m[s[8]], m[s[9]]);			\
+      G (v, 1, 6, 11, 12, m[s[10]], m[s[11]]);			\
+      G (v, 2, 7, 8, 13, m[s[12]], m[s[13]]);			\
+      G (v, 3, 4, 9, 14, m[s[14]], m[s[15]]);			\
+    }								\
+  while (0)
+
+/* Compress one BLOCK_LEN long block at BLOCK with chaining value CV
+   and store the 16 word result into OUT.  */
+static void
+blake3_compress (const md5_uint32 cv[8], const unsigned char *block,
+		 md5_uint32 block_len, uint64_t counter, md5_uint32 flags,
+		 md5_uint32 out[16])
+{
+  md5_uint32 v[16], m[16];
+  int i;
+
+  for (i = 0; i < 16; i++)
+    m[i] = load_le32 (block + 4 * i);
+  memcpy (v, cv, 8 * sizeof (md5_uint32));
+  memcpy (v + 8, blake3_iv, 4 * sizeof (md5_uint32));
+  v[12] = counter;
+  v[13] = counter >> 32;
+  v[14] = block_len;
+  v[15] = flags;
+  for (i = 0; i < 7; i++)
+    ROUND (v, m, i);
+  for (i = 0; i < 8; i++)
+    {
+      out[i] = v[i] ^ v[i + 8];
+      out[i + 8] = v[i + 8] ^ cv[i];
+    }
+}
+
+typedef md5_uint32 blake3_vec
+  __attribute__ ((vector_size (BLAKE3_LANES * sizeof (md5_uint32))));
+
+/* Hash BLAKE3_LANES whole chunks at INPUT, the first of which has
+   number COUNTER, and store their chaining values into OUT.  */
+static inline __attribute__ ((always_inline)) void
+blake3_hash_chunks_body (const unsigned char *input, uint64_t counter,
+			 md5_uint32 out[][8])
+{
+  blake3_vec h[8], v[16], m[16], lo, hi;
+  int b, i, l;
+
+  for (i = 0; i < 8; i++)
+    h[i] = (blake3_vec) {} + blake3_iv[i];
+  for (l = 0; l < BLAKE3_LANES; l++)
+    {
+      lo[l] = counter + l;
+      hi[l] = (counter + l) >> 32;
+    }
+
+  for (b = 0; b < BLAKE3_CHUNK_LEN / 64; b++)
+    {
+      for (i = 0; i < 16; i++)
+	for (l = 0; l < BLAKE3_LANES; l++)
+	  m[i][l] = load_le32 (input + l * BLAKE3_CHUNK_LEN + b * 64 + 4 * i);
+      for (i = 0; i < 8; i++)
+	{
+	  v[i] = h[i];
+	  v[i + 8] = (blake3_vec) {} + blake3_iv[i];
+	}
+      v[12] = lo;
+      v[13] = hi;
+      v[14] = (blake3_vec) {} + 64;
+      v[15] = (blake3_vec) {} + ((b == 0 ? CHUNK_START : 0)
+				 | (b == BLAKE3_CHUNK_LEN / 64 - 1
+				    ? CHUNK_END : 0));
+      for (i = 0; i < 7; i++)
+	ROUND (v, m, i);
+      for (i = 0; i < 8; i++)
+	h[i] = v[i] ^ v[i + 8];
+    }
+
+  for (l = 0; l < BLAKE3_LANES; l++)
+    for (i = 0; i < 8; i++)
+      out[l][i] = h[i][l];
+}
+
+static void
+blake3_hash_chunks_generic (const unsigned char *input, uint64_t counter,
+			    md5_uint32 out[][8])
+{
+  blake3_hash_chunks_body (input, counter, out);
+}
+
+#ifdef BLAKE3_X86_AVX2
+static void __attribute__ ((target ("avx2")))
+blake3_hash_chunks_avx2 (const unsigned char *input, uint64_t counter,
+			 md5_uint32 out[][8])
+{
+  blake3_hash_chunks_body (input, counter, out);
+}
+#endif
+
+static void (*blake3_hash_chunks) (const unsigned char *, uint64_t,
+				   md5_uint32 [][8]);
+static const char *blake3_name;
+
+static void
+blake3_choose (void)
+{
+  blake3_hash_chunks = blake3_hash_chunks_generic;
+  blake3_name = "vector";
+#ifdef BLAKE3_X86_AVX2
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    {
+      blake3_hash_chunks = blake3_hash_chunks_avx2;
+      blake3_name = "AVX2";
+    }
+#endif
+  if (getenv ("PRELINK_DIGEST_C") != NULL)
+    {
+      blake3_hash_chunks = NULL;
+      blake3_name = "C";
+    }
+}
+
+const char *
+blake3_implementation (void)
+{
+  if (blake3_name == NULL)
+    blake3_choose ();
+  return blake3_name;
+}
+
+void
+blake3_init_ctx (struct blake3_ctx *ctx)
+{
+  memcpy (ctx->cv, blake3_iv, sizeof (ctx->cv));
+  ctx->chunk_counter = 0;
+  ctx->stack_len = 0;
+  ctx->blocks_compressed = 0;
+  ctx->buflen = 0;
+}
+
+/* Add the chaining value CV of a whole chunk, after which there are
+   TOTAL_CHUNKS chunks, merging it with as many complete subtrees on the
+   stack as the number of trailing zero bits in TOTAL_CHUNKS says.
+   This is only done once more input is known to follow, so none of
+   the merged nodes can be the root.  */
+static void
+blake3_add_chunk_cv (struct blake3_ctx *ctx, const md5_uint32 cv[8],
+		     uint64_t total_chunks)
+{
+  md5_uint32 new_cv[16], block[16];
+  unsigned char buf[64];
+  int i;
+
+  memcpy (new_cv, cv, 8 * sizeof (md5_uint32));
+  while ((total_chunks & 1) == 0)
+    {
+      memcpy (block, ctx->stack[--ctx->stack_len], 8 * sizeof (md5_uint32));
+      memcpy (block + 8, new_cv, 8 * sizeof (md5_uint32));
+      for (i = 0; i < 16; i++)
+	{
+	  buf[4 * i] = block[i];
+	  buf[4 * i + 1] = block[i] >> 8;
+	  buf[4 * i + 2] = block[i] >> 16;
+	  buf[4 * i + 3] = block[i] >> 24;
+	}
+      blake3_compress (blake3_iv, buf, 64, 0, PARENT, new_cv);
+      total_chunks >>= 1;
+    }
+  memcpy (ctx->stack[ctx->stack_len++], new_cv, 8 * sizeof (md5_uint32));
+}
+
+void
+blake3_process_bytes (const void *buffer, size_t len, struct blake3_ctx *ctx)
+{
+  const unsigned char *p = buffer;
+  md5_uint32 out[16];
+
+  if (blake3_name == NULL)
+    blake3_choose ();
+
+  while (len > 0)
+    {
+      size_t add;
+
+      /* The current chunk is complete and more input follows.  */
+      if (ctx->blocks_compressed == BLAKE3_CHUNK_LEN / 64 - 1
+	  && ctx->buflen == 64)
+	{
+	  blake3_compress (ctx->cv, ctx->buffer, 64, ctx->chunk_counter,
+			   CHUNK_END, out);
+	  blake3_add_chunk_cv (ctx, out, ++ctx->chunk_counter);
+	  memcpy (ctx->cv, blake3_iv, sizeof (ctx->cv));
+	  ctx->blocks_compressed = 0;
+	  ctx->buflen = 0;
+	}
+
+      /* Hash whole chunks many at a time, but keep at least one byte
+	 for the last chunk, which might need the ROOT flag.  */
+      if (ctx->blocks_compressed == 0 && ctx->buflen == 0
+	  && blake3_hash_chunks != NULL)
+	while (len > BLAKE3_LANES * BLAKE3_CHUNK_LEN)
+	  {
+	    md5_uint32 cvs[BLAKE3_LANES][8];
+	    int l;
+
+	    blake3_hash_chunks (p, ctx->chunk_counter, cvs);
+	    for (l = 0; l < BLAKE3_LANES; l++)
+	      blake3_add_chunk_cv (ctx, cvs[l], ++ctx->chunk_counter);
+	    p += BLAKE3_LANES * BLAKE3_CHUNK_LEN;
+	    len -= BLAKE3_LANES * BLAKE3_CHUNK_LEN;
+	  }
+
+      /* The buffered block is complete and more input follows.  */
+      if (ctx->buflen == 64)
+	{
+	  blake3_compress (ctx->cv, ctx->buffer, 64, ctx->chunk_counter,
+			   ctx->blocks_compressed == 0 ? CHUNK_START : 0, out);
+	  memcpy (ctx->cv, out, sizeof (ctx->cv));
+	  ctx->blocks_compressed++;
+	  ctx->buflen = 0;
+	}
+
+      add = 64 - ctx->buflen;
+      if (add > len)
+	add = len;
+      memcpy (ctx->buffer + ctx->buflen, p, add);
+      ctx->buflen += add;
+      p += add;
+      len -= add;
+    }
+}
+
+void *
+blake3_finish_ctx (struct blake3_ctx *ctx, void *resbuf)
+{
+  md5_uint32 cv[8], out[16], flags, block_len;
+  unsigned char block[64];
+  uint64_t counter;
+  int i;
+
+  /* Output of the current chunk.  */
+  memcpy (cv, ctx->cv, sizeof (cv));
+  memset (block, 0, sizeof (block));
+  memcpy (block, ctx->buffer, ctx->buflen);
+  block_len = ctx->buflen;
+  counter = ctx->chunk_counter;
+  flags = CHUNK_END | (ctx->blocks_compressed == 0 ? CHUNK_START : 0);
+
+  /* Fold in the subtrees on the stack from right to left.  */
+  while (ctx->stack_len > 0)
+    {
+      blake3_compress (cv, block, block_len, counter, flags, out);
+      memcpy (cv, ctx->stack[--ctx->stack_len], sizeof (cv));
+      for (i = 0; i < 16; i++)
+	{
+	  md5_uint32 w = i < 8 ? cv[i] : out[i - 8];
+
+	  block[4 * i] = w;
+	  block[4 * i + 1] = w >> 8;
+	  block[4 * i + 2] = w >> 16;
+	  block[4 * i + 3] = w >> 24;
+	}
+      memcpy (cv, blake3_iv, sizeof (cv));
+      block_len = 64;
+      counter = 0;
+      flags = PARENT;
+    }
+
+  blake3_compress (cv, block, block_len, counter, flags | ROOT, out);
+  for (i = 0; i < 32; i++)
+    ((unsigned char *) resbuf)[i] = out[i / 4] >> (8 * (i % 4));
+  return resbuf;
+}
+
+void *
+blake3_buffer (const char *buffer, size_t len, void *resblock)
+{
+  struct blake3_ctx ctx;
+
+  blake3_init_ctx (&ctx);
+  blake3_process_bytes (buffer, len, &ctx);
+  return blake3_finish_ctx (&ctx, resblock);
+}
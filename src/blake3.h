@@ -0,0 +1,57 @@
+/* blake3.h - Declaration of functions and datatypes for BLAKE3 sum
+   computing library functions.
+
+   Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifndef _BLAKE3_H
+# define _BLAKE3_H 1
+
+# include "md5.h"
+
+/* Structure to save state of computation between the single steps.  */
+struct blake3_ctx
+{
+  /* Chaining value of the current chunk.  */
+  md5_uint32 cv[8];
+  /* Chaining values of the complete subtrees to the left of it;
+     54 entries are enough for 2^64 bytes of input.  */
+  md5_uint32 stack[54][8];
+  uint64_t chunk_counter;
+  md5_uint32 stack_len;
+  md5_uint32 blocks_compressed;
+  md5_uint32 buflen;
+  unsigned char buffer[64];
+};
+
+/* Initialize structure containing state of computation.  */
+extern void blake3_init_ctx (struct blake3_ctx *ctx);
+
+/* Update the context for the next LEN bytes starting at BUFFER.  */
+extern void blake3_process_bytes (const void *buffer, size_t len,
+				  struct blake3_ctx *ctx);
+
+/* Put the 32 byte BLAKE3 digest of all the bytes processed in CTX
+   to RESBUF.  */
+extern void *blake3_finish_ctx (struct blake3_ctx *ctx, void *resbuf);
+
+/* Compute BLAKE3 message digest for LEN bytes beginning at BUFFER.  */
+extern void *blake3_buffer (const char *buffer, size_t len, void *resblock);
+
+/* Name of the implementation used for hashing whole chunks.  */
+extern const char *blake3_implementation (void);
+
+#endif
@@ -24,8 +24,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/wait.h>
 #include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 #include "prelinktab.h"
 
 htab_t prelink_devino_htab, prelink_filename_htab;
@@ -395,6 +396,9 @@ prelink_load_cache (void)
   ents = (struct prelink_entry **)
 	 alloca (cache->nlibs * sizeof (struct prelink_entry *));
   memset (ents, 0, cache->nlibs * sizeof (struct prelink_entry *));
+  if (! htab_reserve (prelink_filename_htab, cache->nlibs)
+      || ! htab_reserve (prelink_devino_htab, cache->nlibs))
+    error (EXIT_FAILURE, ENOMEM, "Cannot read cache file %s", prelink_cache);
   for (i = 0; i < cache->nlibs; i++)
     {
       /* Sanity checks.  */
@@ -485,6 +489,189 @@ prelink_load_cache (void)
   return 0;
 }
 
+#define HASHTAB_BENCHMARK_ENTRIES	100000
+
+/* Copy of the insertion path of the hash table prelink used before
+   power of two sizes and cached hash values, kept only so that
+   --hashtab-benchmark can compare against it: prime sizes, double
+   hashing and a hash_f call per entry whenever the table expands.  */
+struct old_htab
+{
+  void **entries;
+  size_t size;
+  size_t n_elements;
+};
+
+static size_t
+old_htab_higher_prime (size_t n)
+{
+  static const size_t primes[] = {
+    7, 13, 31, 61, 127, 251, 509, 1021, 2039, 4093, 8191, 16381,
+    32749, 65521, 131071, 262139, 524287, 1048573, 2097143, 4194301
+  };
+  size_t i;
+
+  for (i = 0; i < sizeof (primes) / sizeof (primes[0]) - 1; ++i)
+    if (primes[i] >= n)
+      break;
+  return primes[i];
+}
+
+static int
+old_htab_expand (struct old_htab *htab)
+{
+  void **oentries = htab->entries, **p;
+  size_t osize = htab->size;
+
+  htab->size = old_htab_higher_prime (htab->size * 2);
+  htab->entries = calloc (htab->size, sizeof (void *));
+  if (htab->entries == NULL)
+    return 0;
+
+  for (p = oentries; p < oentries + osize; ++p)
+    if (*p != NULL)
+      {
+	hashval_t hash = filename_hash (*p);
+	hashval_t hash2 = 1 + hash % (htab->size - 2);
+	size_t index = hash % htab->size;
+
+	while (htab->entries[index] != NULL)
+	  {
+	    index += hash2;
+	    if (index >= htab->size)
+	      index -= htab->size;
+	  }
+	htab->entries[index] = *p;
+      }
+
+  free (oentries);
+  return 1;
+}
+
+static void **
+old_htab_find_slot_with_hash (struct old_htab *htab, const void *element,
+			      hashval_t hash)
+{
+  hashval_t hash2;
+  size_t index;
+
+  if (htab->size * 3 <= htab->n_elements * 4 && ! old_htab_expand (htab))
+    return NULL;
+
+  hash2 = 1 + hash % (htab->size - 2);
+  index = hash % htab->size;
+  for (;;)
+    {
+      void *entry = htab->entries[index];
+
+      if (entry == NULL)
+	{
+	  htab->n_elements++;
+	  return &htab->entries[index];
+	}
+      if (filename_eq (entry, element))
+	return &htab->entries[index];
+      index += hash2;
+      if (index >= htab->size)
+	index -= htab->size;
+    }
+}
+
+/* Time inserting HASHTAB_BENCHMARK_ENTRIES synthetic library names
+   into a filename hash table, once with the old prime sized table,
+   once with htab_find_slot_with_hash growing the table from its
+   initial size and once after htab_reserve as prelink_load_cache
+   does, and print the cost per insertion.  Each variant runs for at
+   least a second.  */
+int
+prelink_hashtab_benchmark (void)
+{
+  static const char *const variants[] = { "old", "grow", "reserve" };
+  struct prelink_entry *ents;
+  hashval_t *hashes;
+  int i, variant;
+
+  ents = calloc (HASHTAB_BENCHMARK_ENTRIES, sizeof (*ents));
+  hashes = malloc (HASHTAB_BENCHMARK_ENTRIES * sizeof (*hashes));
+  if (ents == NULL || hashes == NULL)
+    error (EXIT_FAILURE, ENOMEM, "Could not run hashtab benchmark");
+  for (i = 0; i < HASHTAB_BENCHMARK_ENTRIES; ++i)
+    {
+      char *name;
+
+      if (asprintf (&name, "/usr/lib%d/pkg%d/lib%x.so.%d", i % 2 ? 64 : 32,
+		    i / 37, i * 0x9e3779b9U, i % 7) < 0)
+	error (EXIT_FAILURE, ENOMEM, "Could not run hashtab benchmark");
+      ents[i].filename = name;
+      hashes[i] = filename_hash (&ents[i]);
+    }
+
+  for (variant = 0; variant < 3; ++variant)
+    {
+      struct timeval start, now;
+      double elapsed;
+      uint64_t inserted = 0;
+
+      gettimeofday (&start, NULL);
+      do
+	{
+	  struct old_htab old = { NULL, 0, 0 };
+	  htab_t htab = NULL;
+
+	  if (variant == 0)
+	    {
+	      old.size = old_htab_higher_prime (100);
+	      old.entries = calloc (old.size, sizeof (void *));
+	      if (old.entries == NULL)
+		error (EXIT_FAILURE, ENOMEM,
+		       "Could not run hashtab benchmark");
+	    }
+	  else
+	    {
+	      htab = htab_try_create (100, filename_hash, filename_eq, NULL);
+	      if (htab == NULL
+		  || (variant == 2
+		      && ! htab_reserve (htab, HASHTAB_BENCHMARK_ENTRIES)))
+		error (EXIT_FAILURE, ENOMEM,
+		       "Could not run hashtab benchmark");
+	    }
+	  for (i = 0; i < HASHTAB_BENCHMARK_ENTRIES; ++i)
+	    {
+	      void **slot;
+
+	      if (variant == 0)
+		slot = old_htab_find_slot_with_hash (&old, &ents[i],
+						     hashes[i]);
+	      else
+		slot = htab_find_slot_with_hash (htab, &ents[i], hashes[i],
+						 INSERT);
+	      if (slot == NULL)
+		error (EXIT_FAILURE, ENOMEM,
+		       "Could not run hashtab benchmark");
+	      *slot = &ents[i];
+	    }
+	  if (variant == 0)
+	    free (old.entries);
+	  else
+	    htab_delete (htab);
+	  inserted += HASHTAB_BENCHMARK_ENTRIES;
+	  gettimeofday (&now, NULL);
+	  elapsed = (now.tv_sec - start.tv_sec)
+		    + (now.tv_usec - start.tv_usec) / 1000000.0;
+	}
+      while (elapsed < 1.0);
+
+      printf ("%-8s %8.1f ns/insert\n", variants[variant],
+	      elapsed * 1e9 / inserted);
+    }
+
+  for (i = 0; i < HASHTAB_BENCHMARK_ENTRIES; ++i)
+    free ((char *) ents[i].filename);
+  free (hashes);
+  free (ents);
+  return 0;
+}
+
 static int
 prelink_print_cache_size (void **p, void *info)
 {
@@ -27,25 +27,15 @@
 #include <unistd.h>
 #include "prelink.h"
 
-int
-prelink_set_checksum (DSO *dso)
+/* CRC of the allocated sections of DSO, as DT_CHECKSUM records it.  */
+
+static uint32_t
+compute_checksum (DSO *dso)
 {
   extern uint32_t crc32 (uint32_t crc, unsigned char *buf, size_t len);
   uint32_t crc;
   int i, cvt;
 
-  if (set_dynamic (dso, DT_CHECKSUM, 0, 1))
-    return 1;
-
-  if (dso->info_DT_GNU_PRELINKED
-      && set_dynamic (dso, DT_GNU_PRELINKED, 0, 1))
-    return 1;
-
-  /* Ensure any pending .mdebug/.dynsym/.dynstr etc. modifications
-     write_dso would do happen before checksumming.  */
-  if (prepare_write_dso (dso))
-    return 1;
-
   cvt = ! ((__BYTE_ORDER == __LITTLE_ENDIAN
 	    && dso->ehdr.e_ident[EI_DATA] == ELFDATA2LSB)
 	   || (__BYTE_ORDER == __BIG_ENDIAN
@@ -77,6 +67,27 @@ prelink_set_checksum (DSO *dso)
 	    }
 	}
     }
+  return crc;
+}
+
+int
+prelink_set_checksum (DSO *dso)
+{
+  uint32_t crc;
+
+  if (set_dynamic (dso, DT_CHECKSUM, 0, 1))
+    return 1;
+
+  if (dso->info_DT_GNU_PRELINKED
+      && set_dynamic (dso, DT_GNU_PRELINKED, 0, 1))
+    return 1;
+
+  /* Ensure any pending .mdebug/.dynsym/.dynstr etc. modifications
+     write_dso would do happen before checksumming.  */
+  if (prepare_write_dso (dso))
+    return 1;
+
+  crc = compute_checksum (dso);
 
   if (set_dynamic (dso, DT_CHECKSUM, crc, 1))
     abort ();
@@ -87,3 +98,30 @@ prelink_set_checksum (DSO *dso)
 
   return 0;
 }
+
+/* Return nonzero if the allocated sections of the unmodified DSO as
+   read from disk still have the CRC recorded in its DT_CHECKSUM.  */
+
+int
+prelink_checksum_matches (DSO *dso)
+{
+  uint32_t crc;
+
+  if (! dynamic_info_is_set (dso, DT_CHECKSUM_BIT)
+      || set_dynamic (dso, DT_CHECKSUM, 0, 1))
+    return 0;
+
+  if (dso->info_DT_GNU_PRELINKED
+      && set_dynamic (dso, DT_GNU_PRELINKED, 0, 1))
+    abort ();
+
+  crc = compute_checksum (dso);
+
+  if (set_dynamic (dso, DT_CHECKSUM, dso->info_DT_CHECKSUM, 1))
+    abort ();
+  if (dso->info_DT_GNU_PRELINKED
+      && set_dynamic (dso, DT_GNU_PRELINKED, dso->info_DT_GNU_PRELINKED, 1))
+    abort ();
+
+  return crc == dso->info_DT_CHECKSUM;
+}
@@ -23,9 +23,250 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/time.h>
 #include "prelink.h"
 #include "reloc.h"
 
+/* Return the first slot to probe for SYMOFF in CONFLICTS.  symoff is
+   a multiple of the symbol size, so its low bits carry little
+   information; multiply by 2^64 divided by the golden ratio and use
+   the top bits of the product.  */
+static inline size_t
+conflict_hash (struct prelink_conflicts *conflicts, GElf_Addr symoff)
+{
+  return (size_t) (((uint64_t) symoff * 0x9e3779b97f4a7c15ULL)
+		   >> conflicts->hash_shift);
+}
+
+/* Return the next conflict with SYMOFF in CONFLICTS, or NULL
+   if there are no more.  *POS must be 0 before the first call.  */
+struct prelink_conflict *
+prelink_conflict_iter (struct prelink_conflicts *conflicts, GElf_Addr symoff,
+		       size_t *pos)
+{
+  size_t mask, idx;
+
+  if (conflicts->hash == NULL)
+    return NULL;
+
+  mask = conflicts->hash_size - 1;
+  idx = *pos ? *pos & mask : conflict_hash (conflicts, symoff);
+  while (conflicts->hash[idx] != NULL)
+    {
+      if (conflicts->hash[idx]->symoff == symoff)
+	{
+	  *pos = idx + 1;
+	  return conflicts->hash[idx];
+	}
+      idx = (idx + 1) & mask;
+    }
+
+  return NULL;
+}
+
+struct prelink_conflict *
+prelink_conflict_find (struct prelink_conflicts *conflicts, GElf_Addr symoff,
+		       int reloc_class)
+{
+  struct prelink_conflict *conflict;
+  size_t pos = 0;
+
+  while ((conflict = prelink_conflict_iter (conflicts, symoff, &pos)) != NULL)
+    if (conflict->reloc_class == reloc_class)
+      break;
+
+  return conflict;
+}
+
+static void
+conflict_hash_insert (struct prelink_conflicts *conflicts,
+		      struct prelink_conflict *conflict)
+{
+  size_t mask = conflicts->hash_size - 1;
+  size_t idx = conflict_hash (conflicts, conflict->symoff);
+
+  while (conflicts->hash[idx] != NULL)
+    idx = (idx + 1) & mask;
+  conflicts->hash[idx] = conflict;
+}
+
+/* Allocate a new conflict for SYMOFF and RELOC_CLASS, which is not
+   in CONFLICTS yet, and add it there.  The caller is responsible
+   for filling in the remaining fields.  */
+struct prelink_conflict *
+prelink_conflict_new (struct prelink_conflicts *conflicts, GElf_Addr symoff,
+		      int reloc_class)
+{
+  struct prelink_conflict_chunk *chunk = conflicts->chunks;
+  struct prelink_conflict *conflict;
+
+  /* Keep the index at most half full.  */
+  if (2 * (conflicts->count + 1) > conflicts->hash_size)
+    {
+      size_t size = conflicts->hash_size ? 2 * conflicts->hash_size : 16;
+      struct prelink_conflict **hash;
+
+      hash = calloc (size, sizeof (struct prelink_conflict *));
+      if (hash == NULL)
+	return NULL;
+      free (conflicts->hash);
+      conflicts->hash = hash;
+      conflicts->hash_size = size;
+      conflicts->hash_shift = 64;
+      while (size > 1)
+	{
+	  conflicts->hash_shift--;
+	  size >>= 1;
+	}
+      for (conflict = conflicts->first; conflict; conflict = conflict->next)
+	conflict_hash_insert (conflicts, conflict);
+    }
+
+  if (chunk == NULL || chunk->used == chunk->size)
+    {
+      size_t size = chunk ? 2 * chunk->size : 16;
+
+      if (size > 4096)
+	size = 4096;
+      chunk = malloc (sizeof (struct prelink_conflict_chunk)
+		      + size * sizeof (struct prelink_conflict));
+      if (chunk == NULL)
+	return NULL;
+      chunk->next = conflicts->chunks;
+      chunk->used = 0;
+      chunk->size = size;
+      conflicts->chunks = chunk;
+    }
+
+  conflict = &chunk->conflicts[chunk->used++];
+  memset (conflict, 0, sizeof (*conflict));
+  conflict->symoff = symoff;
+  conflict->reloc_class = reloc_class;
+  conflict->next = conflicts->first;
+  conflicts->first = conflict;
+  conflict_hash_insert (conflicts, conflict);
+  ++conflicts->count;
+  return conflict;
+}
+
+void
+prelink_conflicts_free (struct prelink_conflicts *conflicts)
+{
+  struct prelink_conflict_chunk *chunk, *next;
+
+  for (chunk = conflicts->chunks; chunk; chunk = next)
+    {
+      next = chunk->next;
+      free (chunk);
+    }
+  free (conflicts->hash);
+  free (conflicts->hash2);
+}
+
+#define CONFLICT_BENCHMARK_OLD_BUCKETS	251
+
+/* Look up SYMOFF and RELOC_CLASS the way prelink did before conflicts
+   got an open addressing index: walk a single chain while there are
+   fewer than 16 conflicts, otherwise one of 251 chains picked by
+   symoff modulo 251.  */
+static struct prelink_conflict *
+conflict_benchmark_old_find (struct prelink_conflict **hash, size_t count,
+			     GElf_Addr symoff, int reloc_class)
+{
+  struct prelink_conflict *conflict;
+
+  conflict = hash[count < 16 ? 0 : symoff % CONFLICT_BENCHMARK_OLD_BUCKETS];
+  for (; conflict; conflict = conflict->next)
+    if (conflict->symoff == symoff && conflict->reloc_class == reloc_class)
+      break;
+  return conflict;
+}
+
+/* For a range of conflict counts, time prelink_conflict_find against
+   the old chain walk, looking up every conflict once and as many
+   symbols without a conflict, and print the cost per lookup.  Each
+   measurement runs for at least a second.  */
+int
+prelink_conflict_benchmark (void)
+{
+  static const size_t counts[] = { 8, 64, 1024, 16384, 65536 };
+  size_t c;
+
+  for (c = 0; c < sizeof (counts) / sizeof (counts[0]); ++c)
+    {
+      struct prelink_conflicts conflicts;
+      struct prelink_conflict *old, **hash;
+      size_t count = counts[c], i;
+      double ns[2];
+      int variant;
+
+      memset (&conflicts, 0, sizeof (conflicts));
+      old = calloc (count, sizeof (*old));
+      hash = calloc (CONFLICT_BENCHMARK_OLD_BUCKETS, sizeof (*hash));
+      if (old == NULL || hash == NULL)
+	error (EXIT_FAILURE, ENOMEM, "Could not run conflict benchmark");
+      /* Conflicts against every other symbol, alternating between
+	 the normal and copy relocation classes.  */
+      for (i = 0; i < count; ++i)
+	{
+	  GElf_Addr symoff = 2 * i * sizeof (Elf64_Sym);
+	  int reloc_class = (i & 1) ? RTYPE_CLASS_COPY : RTYPE_CLASS_VALID;
+	  size_t idx = count < 16 ? 0 : symoff % CONFLICT_BENCHMARK_OLD_BUCKETS;
+
+	  if (prelink_conflict_new (&conflicts, symoff, reloc_class) == NULL)
+	    error (EXIT_FAILURE, ENOMEM, "Could not run conflict benchmark");
+	  old[i].symoff = symoff;
+	  old[i].reloc_class = reloc_class;
+	  old[i].next = hash[idx];
+	  hash[idx] = &old[i];
+	}
+
+      for (variant = 0; variant < 2; ++variant)
+	{
+	  struct timeval start, now;
+	  double elapsed;
+	  uint64_t lookups = 0;
+	  size_t found;
+
+	  gettimeofday (&start, NULL);
+	  do
+	    {
+	      found = 0;
+	      for (i = 0; i < 2 * count; ++i)
+		{
+		  GElf_Addr symoff = i * sizeof (Elf64_Sym);
+		  int reloc_class
+		    = ((i >> 1) & 1) ? RTYPE_CLASS_COPY : RTYPE_CLASS_VALID;
+
+		  if (variant == 0)
+		    found += conflict_benchmark_old_find (hash, count, symoff,
+							  reloc_class) != NULL;
+		  else
+		    found += prelink_conflict_find (&conflicts, symoff,
+						    reloc_class) != NULL;
+		}
+	      if (found != count)
+		error (EXIT_FAILURE, 0, "Conflict benchmark found %zd of %zd"
+		       " conflicts", found, count);
+	      lookups += 2 * count;
+	      gettimeofday (&now, NULL);
+	      elapsed = (now.tv_sec - start.tv_sec)
+			+ (now.tv_usec - start.tv_usec) / 1000000.0;
+	    }
+	  while (elapsed < 1.0);
+	  ns[variant] = elapsed * 1e9 / lookups;
+	}
+
+      printf ("%7zd conflicts: old %8.1f ns/lookup, new %8.1f ns/lookup\n",
+	      count, ns[0], ns[1]);
+      prelink_conflicts_free (&conflicts);
+      free (hash);
+      free (old);
+    }
+
+  return 0;
+}
+
 struct prelink_conflict *
 prelink_conflict (struct prelink_info *info, GElf_Word r_sym,
 		  int reloc_type)
@@ -33,19 +274,12 @@ prelink_conflict (struct prelink_info *info, GElf_Word r_sym,
   GElf_Word symoff = info->symtab_start + r_sym * info->symtab_entsize;
   struct prelink_conflict *conflict;
   int reloc_class = info->dso->arch->reloc_class (reloc_type);
-  size_t idx = 0;
 
-  if (info->curconflicts->hash != &info->curconflicts->first)
-    idx = symoff % 251;
-  for (conflict = info->curconflicts->hash[idx]; conflict;
-       conflict = conflict->next)
-    if (conflict->symoff == symoff && conflict->reloc_class == reloc_class)
-      {
-	conflict->used = 1;
-	return conflict;
-      }
+  conflict = prelink_conflict_find (info->curconflicts, symoff, reloc_class);
+  if (conflict != NULL)
+    ++conflict->used;
 
-  return NULL;
+  return conflict;
 }
 
 GElf_Rela *
@@ -55,7 +289,10 @@ prelink_conflict_add_rela (struct prelink_info *info)
 
   if (info->conflict_rela_alloced == info->conflict_rela_size)
     {
-      info->conflict_rela_alloced += 10;
+      if (info->conflict_rela_alloced)
+	info->conflict_rela_alloced *= 2;
+      else
+	info->conflict_rela_alloced = 64;
       info->conflict_rela = realloc (info->conflict_rela,
 				     info->conflict_rela_alloced
 				     * sizeof (GElf_Rela));
@@ -160,7 +397,7 @@ prelink_add_copy_rel (DSO *dso, int n, GElf_Rel *rel, struct copy_relocs *cr)
 
 	  if (cr->alloced == cr->count)
 	    {
-	      cr->alloced += 10;
+	      cr->alloced = cr->alloced ? 2 * cr->alloced : 16;
 	      cr->rela = realloc (cr->rela, cr->alloced * sizeof (GElf_Rela));
 	      if (cr->rela == NULL)
 		{
@@ -195,12 +432,14 @@ prelink_find_copy_rel (DSO *dso, int n, struct copy_relocs *cr)
       for (ndx = 0; ndx < maxndx; ++ndx)
 	{
 	  gelfx_getrel (dso->elf, data, ndx, &rel);
+	  if (GELF_R_TYPE (rel.r_info) != dso->arch->R_COPY)
+	    continue;
+
 	  sec = addr_to_sec (dso, rel.r_offset);
 	  if (sec == -1)
 	    continue;
 
-	  if (GELF_R_TYPE (rel.r_info) == dso->arch->R_COPY
-	      && prelink_add_copy_rel (dso, n, &rel, cr))
+	  if (prelink_add_copy_rel (dso, n, &rel, cr))
 	    return 1;
 	}
     }
@@ -224,61 +463,96 @@ prelink_find_copy_rela (DSO *dso, int n, struct copy_relocs *cr)
       for (ndx = 0; ndx < maxndx; ++ndx)
 	{
 	  gelfx_getrela (dso->elf, data, ndx, &u.rela);
+	  if (GELF_R_TYPE (u.rela.r_info) != dso->arch->R_COPY)
+	    continue;
+
 	  sec = addr_to_sec (dso, u.rela.r_offset);
 	  if (sec == -1)
 	    continue;
 
-	  if (GELF_R_TYPE (u.rela.r_info) == dso->arch->R_COPY)
+	  if (u.rela.r_addend != 0)
 	    {
-	      if (u.rela.r_addend != 0)
-		{
-		  error (0, 0, "%s: COPY reloc with non-zero addend?",
-			 dso->filename);
-		  return 1;
-		}
-	      if (prelink_add_copy_rel (dso, n, &u.rel, cr))
-		return 1;
+	      error (0, 0, "%s: COPY reloc with non-zero addend?",
+		     dso->filename);
+	      return 1;
 	    }
+	  if (prelink_add_copy_rel (dso, n, &u.rel, cr))
+	    return 1;
 	}
     }
   return 0;
 }
 
-static int
-rela_cmp (const void *A, const void *B)
-{
-  GElf_Rela *a = (GElf_Rela *)A;
-  GElf_Rela *b = (GElf_Rela *)B;
+/* Number of 8-bit digits in the r_offset resp. R_SYM keys.  */
+#define RELA_OFFSET_DIGITS	8
+#define RELA_SYM_DIGITS		4
 
-  if (a->r_offset < b->r_offset)
-    return -1;
-  if (a->r_offset > b->r_offset)
-    return 1;
-  return 0;
+static unsigned int
+rela_radix_digit (GElf_Rela *rela, int pass)
+{
+  if (pass < RELA_OFFSET_DIGITS)
+    return (rela->r_offset >> (pass * 8)) & 0xff;
+  pass -= RELA_OFFSET_DIGITS;
+  return (GELF_R_SYM (rela->r_info) >> (pass * 8)) & 0xff;
 }
 
+/* Sort the N relocations in *RELAP by r_offset, or if BY_SYM is
+   non-zero by R_SYM and then r_offset.  This is a stable LSD radix
+   sort, passes on digits which are the same in all keys are skipped.
+   *RELAP may be replaced by a different malloced array.  */
 static int
-conflict_rela_cmp (const void *A, const void *B)
+rela_radix_sort (GElf_Rela **relap, size_t n, int by_sym)
 {
-  GElf_Rela *a = (GElf_Rela *)A;
-  GElf_Rela *b = (GElf_Rela *)B;
-
-  if (GELF_R_SYM (a->r_info) < GELF_R_SYM (b->r_info))
-    return -1;
-  if (GELF_R_SYM (a->r_info) > GELF_R_SYM (b->r_info))
-    return 1;
-  if (a->r_offset < b->r_offset)
-    return -1;
-  if (a->r_offset > b->r_offset)
+  size_t count[RELA_OFFSET_DIGITS + RELA_SYM_DIGITS][256];
+  GElf_Rela *src = *relap, *dst, *tmp;
+  int pass, npasses;
+  size_t i, d, sum;
+
+  npasses = RELA_OFFSET_DIGITS + (by_sym ? RELA_SYM_DIGITS : 0);
+  tmp = malloc (n * sizeof (GElf_Rela));
+  if (tmp == NULL)
     return 1;
+  dst = tmp;
+
+  memset (count, 0, sizeof (count));
+  for (i = 0; i < n; ++i)
+    for (pass = 0; pass < npasses; ++pass)
+      ++count[pass][rela_radix_digit (&src[i], pass)];
+
+  for (pass = 0; pass < npasses; ++pass)
+    {
+      if (count[pass][rela_radix_digit (&src[0], pass)] == n)
+	continue;
+      for (d = 0, sum = 0; d < 256; ++d)
+	{
+	  size_t c = count[pass][d];
+
+	  count[pass][d] = sum;
+	  sum += c;
+	}
+      for (i = 0; i < n; ++i)
+	dst[count[pass][rela_radix_digit (&src[i], pass)]++] = src[i];
+      tmp = src;
+      src = dst;
+      dst = tmp;
+    }
+
+  if (src != *relap)
+    {
+      free (*relap);
+      *relap = src;
+    }
+  else
+    free (dst);
   return 0;
 }
 
-int
-get_relocated_mem (struct prelink_info *info, DSO *dso, GElf_Addr addr,
-		   char *buf, GElf_Word size, GElf_Addr dest_addr)
+/* Copy SIZE bytes at ADDR from DSO's image into BUF, without
+   applying any relocations.  */
+static int
+get_dso_mem (DSO *dso, GElf_Addr addr, char *buf, GElf_Word size)
 {
-  int sec = addr_to_sec (dso, addr), j;
+  int sec = addr_to_sec (dso, addr);
   Elf_Scn *scn;
   Elf_Data *data;
   off_t off;
@@ -314,18 +588,240 @@ get_relocated_mem (struct prelink_info *info, DSO *dso, GElf_Addr addr,
 	}
     }
 
+  return 0;
+}
+
+struct conflict_span
+{
+  GElf_Addr start, end;
+  size_t idx;
+};
+
+static int
+conflict_span_cmp (const void *A, const void *B)
+{
+  const struct conflict_span *a = (const struct conflict_span *) A;
+  const struct conflict_span *b = (const struct conflict_span *) B;
+
+  if (a->start != b->start)
+    return a->start < b->start ? -1 : 1;
+  return a->idx < b->idx ? -1 : a->idx > b->idx;
+}
+
+/* Set OVERLAP[i] if the i-th conflict overlaps some other conflict.
+   conflict_rela is sorted by search scope entry first, so the check
+   is done on a copy sorted by address.  Returns non-zero if memory
+   allocation fails.  */
+static int
+mark_overlapping_conflicts (struct prelink_info *info, char *overlap)
+{
+  struct conflict_span *spans;
+  size_t i, n = info->conflict_rela_size, last = 0;
+  GElf_Addr end = 0;
+
+  spans = malloc (n * sizeof (*spans));
+  if (spans == NULL)
+    return 1;
+  for (i = 0; i < n; ++i)
+    {
+      GElf_Rela *r = &info->conflict_rela[i];
+
+      spans[i].start = r->r_offset;
+      spans[i].end = r->r_offset
+		     + info->dso->arch->reloc_size (GELF_R_TYPE (r->r_info));
+      spans[i].idx = i;
+    }
+  qsort (spans, n, sizeof (*spans), conflict_span_cmp);
+
+  /* A span overlaps an earlier one iff it starts before the largest
+     end seen so far; the span with that end is overlapped too.  */
+  memset (overlap, 0, n);
+  for (i = 0; i < n; ++i)
+    {
+      if (i && spans[i].start < end)
+	{
+	  overlap[spans[i].idx] = 1;
+	  overlap[spans[last].idx] = 1;
+	}
+      if (i == 0 || spans[i].end > end)
+	{
+	  end = spans[i].end;
+	  last = i;
+	}
+    }
+  free (spans);
+  return 0;
+}
+
+/* Remove conflicts which would store into a library the value its
+   prelinked image already contains at that address.  Conflicts which
+   overlap other conflicts are left alone, as are TLS, COPY and PLT
+   ones, whose effect is not a plain store, and those whose type the
+   architecture's apply_conflict_rela does not know.  */
+static void
+fold_redundant_conflicts (struct prelink_info *info)
+{
+  int n, ndeps = info->ent->ndepends + 1;
+  int max_reloc_size = info->dso->arch->max_reloc_size;
+  size_t i, j;
+  DSO *dso = NULL;
+  char *mem1, *mem2, *overlap;
+
+  if (info->conflict_rela_size == 0)
+    return;
+  overlap = malloc (info->conflict_rela_size);
+  if (overlap == NULL || mark_overlapping_conflicts (info, overlap))
+    {
+      /* Folding is only an optimization.  */
+      free (overlap);
+      return;
+    }
+
+  mem1 = alloca (2 * max_reloc_size);
+  mem2 = mem1 + max_reloc_size;
+  for (i = 0, j = 0; i < info->conflict_rela_size; ++i)
+    {
+      GElf_Rela *r = &info->conflict_rela[i];
+      int reloc_type = GELF_R_TYPE (r->r_info);
+      int reloc_size = info->dso->arch->reloc_size (reloc_type);
+      int reloc_class = info->dso->arch->reloc_class (reloc_type);
+
+      if (overlap[i]
+	  || reloc_type == info->dso->arch->R_JMP_SLOT
+	  || reloc_type == info->dso->arch->R_COPY
+	  || reloc_class == RTYPE_CLASS_TLS
+	  || (reloc_class & RTYPE_CLASS_COPY) == RTYPE_CLASS_COPY)
+	goto keep;
+
+      if (dso == NULL || r->r_offset < dso->base || r->r_offset >= dso->end)
+	{
+	  dso = NULL;
+	  for (n = 1; n < ndeps; ++n)
+	    if (r->r_offset >= info->dsos[n]->base
+		&& r->r_offset < info->dsos[n]->end)
+	      {
+		dso = info->dsos[n];
+		break;
+	      }
+	  if (dso == NULL)
+	    goto keep;
+	}
+
+      if (get_dso_mem (dso, r->r_offset, mem1, reloc_size))
+	goto keep;
+      memcpy (mem2, mem1, reloc_size);
+      if (info->dso->arch->apply_conflict_rela (info, r, mem2, 0) == 0
+	  && memcmp (mem1, mem2, reloc_size) == 0)
+	{
+	  if (verbose > 3)
+	    error (0, 0, "%s: Removing conflict at %08llx, %s already contains its value",
+		   info->dso->filename, (unsigned long long) r->r_offset,
+		   dso->filename);
+	  continue;
+	}
+
+keep:
+      if (i != j)
+	info->conflict_rela[j] = *r;
+      ++j;
+    }
+  info->conflict_rela_size = j;
+  free (overlap);
+}
+
+/* Record in conflict_scope where the conflicts of each search scope
+   entry start in the conflict_rela array, which must be sorted by
+   R_SYM and r_offset.  */
+static void
+conflict_scope_index (struct prelink_info *info, int ndeps)
+{
+  size_t i, k;
+
+  free (info->conflict_scope);
+  info->conflict_scope = malloc ((ndeps + 1) * sizeof (size_t));
+  if (info->conflict_scope == NULL)
+    return;
+
+  for (i = 0, k = 0; i < info->conflict_rela_size; ++i)
+    {
+      GElf_Rela *r = &info->conflict_rela[i];
+      size_t n = GELF_R_SYM (r->r_info);
+
+      /* Conflicts of an object are expected to be against its own
+	 memory, don't use the index otherwise.  */
+      if (r->r_offset < info->dsos[n]->base
+	  || r->r_offset >= info->dsos[n]->end)
+	{
+	  free (info->conflict_scope);
+	  info->conflict_scope = NULL;
+	  return;
+	}
+      while (k <= n)
+	info->conflict_scope[k++] = i;
+    }
+  while (k <= (size_t) ndeps)
+    info->conflict_scope[k++] = i;
+}
+
+int
+get_relocated_mem (struct prelink_info *info, DSO *dso, GElf_Addr addr,
+		   char *buf, GElf_Word size, GElf_Addr dest_addr)
+{
+  Elf_Scn *scn;
+  Elf_Data *data;
+  int j;
+
+  if (get_dso_mem (dso, addr, buf, size))
+    return 1;
+
   if (info->dso != dso)
     {
+      size_t first = 0, last = info->conflict_rela_size;
+      int sorted = 0;
+
+      if (info->conflict_scope)
+	{
+	  int n, ndeps = info->ent->ndepends + 1;
+
+	  for (n = 1; n < ndeps; ++n)
+	    if (info->dsos[n] == dso)
+	      break;
+	  if (n < ndeps)
+	    {
+	      size_t lo = info->conflict_scope[n];
+	      size_t hi = info->conflict_scope[n + 1];
+
+	      /* Find the first conflict which may overlap ADDR.  */
+	      last = hi;
+	      while (lo < hi)
+		{
+		  size_t mid = (lo + hi) / 2;
+
+		  if (info->conflict_rela[mid].r_offset
+		      + dso->arch->max_reloc_size <= addr)
+		    lo = mid + 1;
+		  else
+		    hi = mid;
+		}
+	      first = lo;
+	      sorted = 1;
+	    }
+	}
+
       /* This is tricky. We need to apply any conflicts
 	 against memory area which we've copied to the COPY
 	 reloc offset.  */
-      for (j = 0; j < info->conflict_rela_size; ++j)
+      for (j = first; j < last; ++j)
 	{
 	  int reloc_type, reloc_size, ret;
 	  off_t off;
 
 	  if (info->conflict_rela[j].r_offset >= addr + size)
-	    continue;
+	    {
+	      if (sorted)
+		break;
+	      continue;
+	    }
 	  if (info->conflict_rela[j].r_offset + dso->arch->max_reloc_size
 	      <= addr)
 	    continue;
@@ -358,6 +854,10 @@ get_relocated_mem (struct prelink_info *info, DSO *dso, GElf_Addr addr,
       union { GElf_Rel rel; GElf_Rela rela; } u;
       off_t off;
 
+      /* All COPY relocated objects of the binary are contiguous in
+	 .dynbss resp. .sdynbss and were copied into one buffer each,
+	 so whether ADDR is inside a copied object is a range check and
+	 no per-object index is needed.  */
       if (addr + size > info->dynbss_base
 	  && addr < info->dynbss_base + info->dynbss_size)
 	{
@@ -441,6 +941,370 @@ get_relocated_mem (struct prelink_info *info, DSO *dso, GElf_Addr addr,
   return 0;
 }
 
+/* Rough startup cost of a conflict, used by --explain-conflicts: ld.so
+   applies conflict relocations without any symbol lookup, so they are
+   cheap, but the first store into each page takes a copy on write
+   fault.  Both in nanoseconds.  */
+#define EXPLAIN_RELOC_NS	10
+#define EXPLAIN_PAGE_NS		1500
+
+struct explain_conflict
+{
+  struct prelink_entry *lookup, *conflict;
+  struct prelink_conflict *cfl;
+  const char *name;
+};
+
+struct explain_interposer
+{
+  struct prelink_entry *ent, *last;
+  size_t nrelocs, nsyms, nbins;
+};
+
+static struct explain_interposer *explain_interposers;
+static size_t explain_ninterposers, explain_interposers_alloced;
+
+static struct prelink_entry *
+explain_ent (struct prelink_info *info, struct prelink_conflict *conflict,
+	     int lookup)
+{
+  struct prelink_tls *tls;
+  int n;
+
+  if (conflict->reloc_class != RTYPE_CLASS_TLS)
+    return lookup ? conflict->lookup.ent : conflict->conflict.ent;
+
+  tls = lookup ? conflict->lookup.tls : conflict->conflict.tls;
+  if (tls == NULL)
+    return NULL;
+  n = tls - info->tls;
+  return n ? info->ent->depends[n - 1] : info->ent;
+}
+
+static const char *
+explain_ent_name (struct prelink_entry *ent)
+{
+  return ent ? ent->canon_filename : "<unresolved>";
+}
+
+static const char *
+explain_symbol_name (DSO *dso, GElf_Addr symoff)
+{
+  GElf_Addr addr = dso->base + symoff;
+  int sec = addr_to_sec (dso, addr);
+  const char *name;
+  Elf_Data *data;
+  GElf_Sym sym;
+
+  if (sec == -1 || dso->shdr[sec].sh_type != SHT_DYNSYM)
+    return "???";
+  data = elf_getdata (dso->scn[sec], NULL);
+  gelfx_getsym (dso->elf, data,
+		(addr - dso->shdr[sec].sh_addr) / dso->shdr[sec].sh_entsize,
+		&sym);
+  name = strptr (dso, dso->shdr[sec].sh_link, sym.st_name);
+  return name ? name : "???";
+}
+
+static const char *
+explain_class_name (struct prelink_info *info, int reloc_class)
+{
+  if (reloc_class == info->dso->arch->rtype_class_valid)
+    return "data";
+  switch (reloc_class)
+    {
+    case RTYPE_CLASS_PLT: return "plt";
+    case RTYPE_CLASS_TLS: return "tls";
+    default:
+      if ((reloc_class & RTYPE_CLASS_COPY) == RTYPE_CLASS_COPY)
+	return "copy";
+      return "other";
+    }
+}
+
+static int
+explain_cmp (const void *A, const void *B)
+{
+  const struct explain_conflict *a = (const struct explain_conflict *) A;
+  const struct explain_conflict *b = (const struct explain_conflict *) B;
+  int ret;
+
+  ret = strcmp (explain_ent_name (a->lookup), explain_ent_name (b->lookup));
+  if (ret)
+    return ret;
+  ret = strcmp (explain_ent_name (a->conflict),
+		explain_ent_name (b->conflict));
+  if (ret)
+    return ret;
+  if (a->cfl->applied != b->cfl->applied)
+    return a->cfl->applied > b->cfl->applied ? -1 : 1;
+  return strcmp (a->name, b->name);
+}
+
+static int
+explain_interposer_cmp (const void *A, const void *B)
+{
+  const struct explain_interposer *a = (const struct explain_interposer *) A;
+  const struct explain_interposer *b = (const struct explain_interposer *) B;
+
+  if (a->nrelocs != b->nrelocs)
+    return a->nrelocs > b->nrelocs ? -1 : 1;
+  return strcmp (a->ent->canon_filename, b->ent->canon_filename);
+}
+
+static int
+explain_add_interposer (struct prelink_info *info, struct prelink_entry *ent,
+			size_t nrelocs, size_t nsyms)
+{
+  size_t i;
+
+  for (i = 0; i < explain_ninterposers; ++i)
+    if (explain_interposers[i].ent == ent)
+      break;
+
+  if (i == explain_ninterposers)
+    {
+      if (explain_ninterposers == explain_interposers_alloced)
+	{
+	  struct explain_interposer *e;
+
+	  explain_interposers_alloced = 2 * explain_interposers_alloced + 16;
+	  e = realloc (explain_interposers,
+		       explain_interposers_alloced * sizeof (*e));
+	  if (e == NULL)
+	    return 1;
+	  explain_interposers = e;
+	}
+      memset (&explain_interposers[i], 0, sizeof (explain_interposers[i]));
+      explain_interposers[i].ent = ent;
+      ++explain_ninterposers;
+    }
+
+  explain_interposers[i].nrelocs += nrelocs;
+  explain_interposers[i].nsyms += nsyms;
+  if (explain_interposers[i].last != info->ent)
+    {
+      explain_interposers[i].last = info->ent;
+      ++explain_interposers[i].nbins;
+    }
+  return 0;
+}
+
+static int
+explain_addr_cmp (const void *A, const void *B)
+{
+  GElf_Addr a = *(const GElf_Addr *) A;
+  GElf_Addr b = *(const GElf_Addr *) B;
+
+  return a < b ? -1 : a > b;
+}
+
+/* Set the applied field of each conflict of INFO to the number of
+   relocations needing it which still have an entry in conflict_rela,
+   i.e. were not removed by the C++ pass or as redundant.  */
+static int
+explain_count_applied (struct prelink_info *info)
+{
+  int i, j, sec, ndx, maxndx, ndeps = info->ent->ndepends + 1;
+  size_t k, n = info->conflict_rela_size;
+  struct prelink_conflict *conflict;
+  GElf_Addr *offs, symtab_start;
+  Elf_Data *data;
+  GElf_Rela rela;
+  GElf_Rel rel;
+  DSO *dso;
+
+  offs = malloc ((n ?: 1) * sizeof (*offs));
+  if (offs == NULL)
+    return 1;
+  for (k = 0; k < n; ++k)
+    offs[k] = info->conflict_rela[k].r_offset;
+  qsort (offs, n, sizeof (*offs), explain_addr_cmp);
+
+  for (i = 0; i < ndeps; ++i)
+    {
+      for (conflict = info->conflicts[i].first; conflict;
+	   conflict = conflict->next)
+	conflict->applied = 0;
+      if (info->conflicts[i].first == NULL || n == 0)
+	continue;
+
+      /* Walk the relocations like prelink_build_conflicts did.  */
+      dso = info->dsos[i];
+      sec = addr_to_sec (dso, dso->info[DT_SYMTAB]);
+      if (sec == -1)
+	continue;
+      symtab_start = dso->shdr[sec].sh_addr - dso->base;
+      for (j = 1; j < dso->ehdr.e_shnum; ++j)
+	{
+	  if (! (dso->shdr[j].sh_flags & SHF_ALLOC)
+	      || (dso->shdr[j].sh_type != SHT_REL
+		  && dso->shdr[j].sh_type != SHT_RELA)
+	      || (i == 0
+		  && strcmp (strptr (dso, dso->ehdr.e_shstrndx,
+				     dso->shdr[j].sh_name),
+			     ".gnu.conflict") == 0))
+	    continue;
+
+	  data = NULL;
+	  while ((data = elf_getdata (dso->scn[j], data)) != NULL)
+	    {
+	      maxndx = data->d_size / dso->shdr[j].sh_entsize;
+	      for (ndx = 0; ndx < maxndx; ++ndx)
+		{
+		  if (dso->shdr[j].sh_type == SHT_REL)
+		    {
+		      gelfx_getrel (dso->elf, data, ndx, &rel);
+		      rela.r_offset = rel.r_offset;
+		      rela.r_info = rel.r_info;
+		    }
+		  else
+		    gelfx_getrela (dso->elf, data, ndx, &rela);
+
+		  if (bsearch (&rela.r_offset, offs, n, sizeof (*offs),
+			       explain_addr_cmp) == NULL)
+		    continue;
+		  conflict
+		    = prelink_conflict_find (&info->conflicts[i],
+					     symtab_start
+					     + GELF_R_SYM (rela.r_info)
+					       * info->symtab_entsize,
+					     dso->arch->reloc_class
+					       (GELF_R_TYPE (rela.r_info)));
+		  if (conflict != NULL)
+		    ++conflict->applied;
+		}
+	    }
+	}
+    }
+
+  free (offs);
+  return 0;
+}
+
+/* Print which symbols are responsible for the conflicts of the
+   binary described by INFO, grouped by the library the symbol was
+   interposed by and the library it would otherwise resolve to.
+   Conflicts where both are the same object, e.g. for TLS or copy
+   relocations, are not interposition and are left out, and so are
+   those all of whose relocations were removed by the C++ pass or as
+   redundant.  */
+static int
+explain_binary_conflicts (struct prelink_info *info)
+{
+  int i, ndeps = info->ent->ndepends + 1;
+  size_t j, k, n = 0, npages = 0;
+  struct explain_conflict *e;
+  struct prelink_conflict *conflict;
+  GElf_Addr page_size = info->dso->arch->page_size;
+
+  if (explain_count_applied (info))
+    {
+      error (0, ENOMEM, "%s: Could not explain conflicts", info->dso->filename);
+      return 1;
+    }
+
+  for (i = 0; i < ndeps; ++i)
+    for (conflict = info->conflicts[i].first; conflict;
+	 conflict = conflict->next)
+      if (conflict->applied
+	  && explain_ent (info, conflict, 1) != explain_ent (info, conflict, 0))
+	++n;
+
+  /* conflict_rela is sorted by search scope entry and then address,
+     and the conflicts of different entries are against different
+     objects, so no page is counted twice.  */
+  for (j = 0; j < info->conflict_rela_size; ++j)
+    if (j == 0
+	|| info->conflict_rela[j].r_offset / page_size
+	   != info->conflict_rela[j - 1].r_offset / page_size)
+      ++npages;
+
+  printf ("%s: %zu conflicts applied at startup, %zu pages written, "
+	  "estimated cost %llu us\n", info->ent->canon_filename,
+	  info->conflict_rela_size, npages,
+	  (unsigned long long) (info->conflict_rela_size * EXPLAIN_RELOC_NS
+				+ npages * EXPLAIN_PAGE_NS + 500) / 1000);
+  if (n == 0)
+    return 0;
+
+  e = malloc (n * sizeof (*e));
+  if (e == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not explain conflicts", info->dso->filename);
+      return 1;
+    }
+
+  for (i = 0, n = 0; i < ndeps; ++i)
+    for (conflict = info->conflicts[i].first; conflict;
+	 conflict = conflict->next)
+      if (conflict->applied)
+	{
+	  e[n].lookup = explain_ent (info, conflict, 1);
+	  e[n].conflict = explain_ent (info, conflict, 0);
+	  if (e[n].lookup == e[n].conflict)
+	    continue;
+	  e[n].cfl = conflict;
+	  e[n].name = explain_symbol_name (info->dsos[i], conflict->symoff);
+	  ++n;
+	}
+
+  qsort (e, n, sizeof (*e), explain_cmp);
+
+  for (j = 0; j < n; j = k)
+    {
+      size_t nrelocs = 0, nsyms;
+
+      for (k = j; k < n; ++k)
+	{
+	  if (e[k].lookup != e[j].lookup || e[k].conflict != e[j].conflict)
+	    break;
+	  nrelocs += e[k].cfl->applied;
+	}
+      nsyms = k - j;
+
+      printf ("  %s interposes %s: %zu symbols, %zu relocations\n",
+	      explain_ent_name (e[j].lookup), explain_ent_name (e[j].conflict),
+	      nsyms, nrelocs);
+      for (; j < k; ++j)
+	printf ("    %s %s%s %u\n", e[j].name,
+		explain_class_name (info, e[j].cfl->reloc_class),
+		e[j].cfl->ifunc ? " ifunc" : "", e[j].cfl->applied);
+
+      if (e[k - 1].lookup
+	  && explain_add_interposer (info, e[k - 1].lookup, nrelocs, nsyms))
+	{
+	  error (0, ENOMEM, "%s: Could not explain conflicts",
+		 info->dso->filename);
+	  free (e);
+	  return 1;
+	}
+    }
+
+  free (e);
+  return 0;
+}
+
+/* Print the interposers seen by --explain-conflicts, those which
+   caused the most conflict relocations first.  */
+void
+prelink_explain_summary (void)
+{
+  size_t i;
+
+  qsort (explain_interposers, explain_ninterposers,
+	 sizeof (struct explain_interposer), explain_interposer_cmp);
+  printf ("# interposer\trelocations\tsymbols\tbinaries\n");
+  for (i = 0; i < explain_ninterposers; ++i)
+    printf ("%s\t%zu\t%zu\t%zu\n", explain_interposers[i].ent->canon_filename,
+	    explain_interposers[i].nrelocs, explain_interposers[i].nsyms,
+	    explain_interposers[i].nbins);
+  free (explain_interposers);
+  explain_interposers = NULL;
+  explain_ninterposers = 0;
+  explain_interposers_alloced = 0;
+}
+
 int
 prelink_build_conflicts (struct prelink_info *info)
 {
@@ -473,7 +1337,7 @@ prelink_build_conflicts (struct prelink_info *info)
 
   for (i = 0; i < ndeps; ++i)
     {
-      int j, sec, first_conflict, maxidx;
+      int j, sec, first_conflict;
       struct prelink_conflict *conflict;
 
       dso = info->dsos[i];
@@ -589,18 +1453,14 @@ prelink_build_conflicts (struct prelink_info *info)
 	  && dso->arch->arch_prelink_conflict (dso, info))
 	goto error_out;
 
-      maxidx = 1;
-      if (info->curconflicts->hash != &info->curconflicts->first)
-	maxidx = 251;
-      for (j = 0; j < maxidx; j++)
-	for (conflict = info->curconflicts->hash[j]; conflict;
-	     conflict = conflict->next)
-	  if (! conflict->used && (i || conflict->ifunc))
-	    {
-	      error (0, 0, "%s: Conflict %08llx not found in any relocation",
-		     dso->filename, (unsigned long long) conflict->symoff);
-	      ret = 1;
-	    }
+      for (conflict = info->curconflicts->first; conflict;
+	   conflict = conflict->next)
+	if (! conflict->used && (i || conflict->ifunc))
+	  {
+	    error (0, 0, "%s: Conflict %08llx not found in any relocation",
+		   dso->filename, (unsigned long long) conflict->symoff);
+	    ret = 1;
+	  }
 
       /* Record library's position in search scope into R_SYM field.  */
       for (j = first_conflict; j < info->conflict_rela_size; ++j)
@@ -653,7 +1513,12 @@ prelink_build_conflicts (struct prelink_info *info)
       int bss1, bss2, firstbss2 = 0;
       const char *name;
 
-      qsort (cr.rela, cr.count, sizeof (GElf_Rela), rela_cmp);
+      if (rela_radix_sort (&cr.rela, cr.count, 0))
+	{
+	  error (0, ENOMEM, "%s: Could not sort COPY relocations",
+		 dso->filename);
+	  goto error_out;
+	}
       bss1 = addr_to_sec (dso, cr.rela[0].r_offset);
       bss2 = addr_to_sec (dso, cr.rela[cr.count - 1].r_offset);
       if (bss1 != bss2)
@@ -730,6 +1595,21 @@ prelink_build_conflicts (struct prelink_info *info)
 	  goto error_out;
 	}
 
+      /* Sort the conflicts found so far, so that get_relocated_mem
+	 can find those against each library quickly.  Conflicts added
+	 while handling COPY relocs are against the binary.  */
+      if (info->conflict_rela_size)
+	{
+	  if (rela_radix_sort (&info->conflict_rela, info->conflict_rela_size,
+			       1))
+	    {
+	      error (0, ENOMEM, "%s: Could not sort conflicts", dso->filename);
+	      goto error_out;
+	    }
+	  info->conflict_rela_alloced = info->conflict_rela_size;
+	  conflict_scope_index (info, ndeps);
+	}
+
       for (i = 0; i < cr.count; ++i)
 	{
 	  struct prelink_symbol *s;
@@ -741,10 +1621,8 @@ prelink_build_conflicts (struct prelink_info *info)
 
 	  assert (reloc_class != RTYPE_CLASS_TLS);
 
-	  for (s = & info->symbols[GELF_R_SYM (cr.rela[i].r_info)]; s;
-	       s = s->next)
-	    if (s->reloc_class == reloc_class)
-	      break;
+	  s = prelink_symbol_lookup (info, GELF_R_SYM (cr.rela[i].r_info),
+				     reloc_class);
 
 	  if (s == NULL || s->u.ent == NULL)
 	    {
@@ -784,24 +1662,68 @@ prelink_build_conflicts (struct prelink_info *info)
 		     (long long) cr.rela[i].r_offset,
 		     (long long) (cr.rela[i].r_offset + cr.rela[i].r_addend));
 	      goto error_out;
+	    case 6:
+	      error (0, 0, "%s: Unsupported conflict relocation against %08llx-%08llx area",
+		     dso->filename,
+		     (long long) cr.rela[i].r_offset,
+		     (long long) (cr.rela[i].r_offset + cr.rela[i].r_addend));
+	      goto error_out;
 	    }
 	}
     }
 
   if (info->conflict_rela_size)
     {
-      qsort (info->conflict_rela, info->conflict_rela_size, sizeof (GElf_Rela),
-	     conflict_rela_cmp);
+      size_t j, nconflicts = info->conflict_rela_size;
 
-      /* Now make sure all conflict RELA's are against absolute 0 symbol.  */
-      for (i = 0; i < info->conflict_rela_size; ++i)
-	info->conflict_rela[i].r_info
-	  = GELF_R_INFO (0, GELF_R_TYPE (info->conflict_rela[i].r_info));
+      if (rela_radix_sort (&info->conflict_rela, info->conflict_rela_size, 1))
+	{
+	  error (0, ENOMEM, "%s: Could not sort conflicts", dso->filename);
+	  goto error_out;
+	}
+
+      /* Drop conflicts which are superseded by a later conflict of the
+	 same type against the same address in the same search scope
+	 entry; the sort is stable, so the last one is what ld.so would
+	 leave in memory.  */
+      for (i = 0, j = 0; i < info->conflict_rela_size; ++i)
+	{
+	  GElf_Rela *r = &info->conflict_rela[i];
+
+	  if (j
+	      && r->r_offset == info->conflict_rela[j - 1].r_offset
+	      && r->r_info == info->conflict_rela[j - 1].r_info)
+	    --j;
+	  info->conflict_rela[j++] = *r;
+	}
+      info->conflict_rela_size = j;
+      info->conflict_rela_alloced = j;
+
+      conflict_scope_index (info, ndeps);
+
+      /* Now make sure all conflict RELA's are against absolute 0
+	 symbol.  */
+      for (j = 0; j < info->conflict_rela_size; ++j)
+	info->conflict_rela[j].r_info
+	  = GELF_R_INFO (0, GELF_R_TYPE (info->conflict_rela[j].r_info));
 
       if (enable_cxx_optimizations && remove_redundant_cxx_conflicts (info))
 	goto error_out;
+
+      /* From now on conflicts are removed.  */
+      free (info->conflict_scope);
+      info->conflict_scope = NULL;
+
+      fold_redundant_conflicts (info);
+
+      if (verbose > 1)
+	printf ("%s: %zu conflicts, %zu after removing redundant ones\n",
+		info->dso->filename, nconflicts, info->conflict_rela_size);
     }
 
+  if (explain_conflicts && explain_binary_conflicts (info))
+    goto error_out;
+
   for (i = 1; i < ndeps; ++i)
     if (info->dsos[i])
       close_dso (info->dsos[i]);
@@ -814,8 +1736,10 @@ error_out:
   free (cr.rela);
   free (info->dynbss);
   free (info->sdynbss);
+  free (info->conflict_scope);
   info->dynbss = NULL;
   info->sdynbss = NULL;
+  info->conflict_scope = NULL;
   for (i = 1; i < ndeps; ++i)
     if (info->dsos[i])
       close_dso (info->dsos[i]);
@@ -39,6 +39,10 @@ specials[] =
     { "_ZTV", 4, GELF_ST_INFO (STB_WEAK, STT_OBJECT), 1 },
     /* Typeinfo.  */
     { "_ZTI", 4, GELF_ST_INFO (STB_WEAK, STT_OBJECT), 0 },
+    /* VTT.  */
+    { "_ZTT", 4, GELF_ST_INFO (STB_WEAK, STT_OBJECT), 0 },
+    /* Construction virtual table.  */
+    { "_ZTC", 4, GELF_ST_INFO (STB_WEAK, STT_OBJECT), 1 },
     /* G++ 2.96-RH ABI.  */
     /* Virtual table.  */
     { "__vt_", 5, GELF_ST_INFO (STB_WEAK, STT_OBJECT), 0 },
@@ -53,10 +57,14 @@ struct find_cxx_sym_valsize
   unsigned char mark;
 };
 
+/* For the caches of C++ tables, built once per library and kept
+   in its prelink_entry, vals[1] ... vals[count] are sorted
+   non-overlapping intervals stored in Eytzinger (BFS) order.
+   For the per-binary .plt cache, vals[0] ... vals[count - 1] are
+   simply sorted by address.  */
 struct find_cxx_sym_cache
 {
-  Elf_Data *symtab, *strtab;
-  int symsec, strsec, count;
+  int count;
   struct find_cxx_sym_valsize vals[];
 };
 
@@ -68,7 +76,6 @@ struct find_cxx_sym
   struct prelink_entry *ent;
   Elf_Data *symtab, *strtab;
   int symsec, strsec;
-  int lastndx;
   GElf_Sym sym;
 };
 
@@ -92,40 +99,56 @@ cachecmp (const void *a, const void *b)
   return va > vb;
 }
 
-static struct find_cxx_sym_cache *
-create_cache (DSO *dso, int plt)
+/* Fill in .dynsym and .dynstr of DSO into FCS.  */
+static int
+find_cxx_symtab (DSO *dso, struct find_cxx_sym *fcs)
 {
-  Elf_Data *symtab, *strtab;
   Elf_Scn *scn;
-  int symsec, strsec, ndx, dndx, maxndx;
+
+  fcs->symsec = addr_to_sec (dso, dso->info[DT_SYMTAB]);
+  if (fcs->symsec == -1)
+    return 1;
+  scn = dso->scn[fcs->symsec];
+  fcs->symtab = elf_getdata (scn, NULL);
+  assert (elf_getdata (scn, fcs->symtab) == NULL);
+  fcs->strsec = addr_to_sec (dso, dso->info[DT_STRTAB]);
+  if (fcs->strsec == -1)
+    return 1;
+  scn = dso->scn[fcs->strsec];
+  fcs->strtab = elf_getdata (scn, NULL);
+  assert (elf_getdata (scn, fcs->strtab) == NULL);
+  return 0;
+}
+
+static void
+eytzinger_fill (struct find_cxx_sym_valsize *dst,
+		struct find_cxx_sym_valsize *src, int count, int *pos, int k)
+{
+  if (k > count)
+    return;
+  eytzinger_fill (dst, src, count, pos, 2 * k);
+  dst[k] = src[(*pos)++];
+  eytzinger_fill (dst, src, count, pos, 2 * k + 1);
+}
+
+static struct find_cxx_sym_cache *
+create_cache (DSO *dso, struct find_cxx_sym *fcs, int plt)
+{
+  Elf_Data *symtab = fcs->symtab, *strtab = fcs->strtab;
+  int ndx, dndx, maxndx;
   struct find_cxx_sym_cache *cache;
+  struct find_cxx_sym_valsize *sorted;
   GElf_Addr top;
 
-  symsec = addr_to_sec (dso, dso->info[DT_SYMTAB]);
-  if (symsec == -1)
-    return (struct find_cxx_sym_cache *) -1UL;
-  scn = dso->scn[symsec];
-  symtab = elf_getdata (scn, NULL);
-  assert (elf_getdata (scn, symtab) == NULL);
-  strsec = addr_to_sec (dso, dso->info[DT_STRTAB]);
-  if (strsec == -1)
-    return (struct find_cxx_sym_cache *) -1UL;
-  scn = dso->scn[strsec];
-  strtab = elf_getdata (scn, NULL);
-  assert (elf_getdata (scn, strtab) == NULL);
-  maxndx = symtab->d_size / dso->shdr[symsec].sh_entsize;
-
-  cache = malloc (sizeof (*cache) + sizeof (cache->vals[0]) * maxndx);
+  maxndx = symtab->d_size / dso->shdr[fcs->symsec].sh_entsize;
+
+  cache = malloc (sizeof (*cache) + sizeof (cache->vals[0]) * (maxndx + 1));
   if (cache == NULL)
     {
       error (0, ENOMEM, "%s: Could load symbol table", dso->filename);
       return NULL;
     }
 
-  cache->symsec = symsec;
-  cache->strsec = strsec;
-  cache->symtab = symtab;
-  cache->strtab = strtab;
   for (ndx = 0, dndx = 0; ndx < maxndx; ++ndx)
     {
       GElf_Sym sym;
@@ -175,6 +198,18 @@ create_cache (DSO *dso, int plt)
       for (ndx = dndx = 0; ndx < maxndx; ++ndx)
 	if (cache->vals[ndx].mark)
 	  cache->vals[dndx++] = cache->vals[ndx];
+
+      sorted = malloc (sizeof (cache->vals[0]) * (dndx + 1));
+      if (sorted == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could load symbol table", dso->filename);
+	  free (cache);
+	  return NULL;
+	}
+      memcpy (sorted, cache->vals, sizeof (cache->vals[0]) * dndx);
+      ndx = 0;
+      eytzinger_fill (cache->vals, sorted, dndx, &ndx, 1);
+      free (sorted);
     }
   cache->count = dndx;
   return cache;
@@ -183,12 +218,12 @@ create_cache (DSO *dso, int plt)
 static int
 find_cxx_sym (struct prelink_info *info, GElf_Addr addr,
 	      struct find_cxx_sym *fcs, int reloc_size,
-	      struct find_cxx_sym_cache **cache)
+	      struct find_cxx_sym_cache **bincache)
 {
-  int n, ndeps = info->ent->ndepends + 1;
-  unsigned int hi, lo, mid;
+  int n, k, best, ndeps = info->ent->ndepends + 1;
   DSO *dso = NULL;
-  struct find_cxx_sym_cache *c;
+  struct find_cxx_sym_cache *c, **cachep;
+  struct find_cxx_sym newfcs;
 
   if (fcs->dso == NULL
       || addr < fcs->dso->base
@@ -212,78 +247,57 @@ find_cxx_sym (struct prelink_info *info, GElf_Addr addr,
 
       assert (n < ndeps);
 
-      if (cache[n] == NULL)
+      /* Libraries don't change once they have been prelinked, so their
+	 caches are shared by all binaries using them.  */
+      newfcs.ent = n ? info->ent->depends[n - 1] : info->ent;
+      cachep = n ? &newfcs.ent->cxx_cache : bincache;
+      if (*cachep == (struct find_cxx_sym_cache *) -1UL
+	  || find_cxx_symtab (dso, &newfcs))
+	{
+	  *cachep = (struct find_cxx_sym_cache *) -1UL;
+	  return -1;
+	}
+      if (*cachep == NULL)
 	{
-	  cache[n] = create_cache (dso, 0);
-	  if (cache[n] == NULL)
+	  *cachep = create_cache (dso, &newfcs, 0);
+	  if (*cachep == NULL)
 	    return -2;
 	}
-      if (cache[n] == (struct find_cxx_sym_cache *) -1UL)
-	return -1;
 
       fcs->n = n;
-      fcs->ent = n ? info->ent->depends[n - 1] : info->ent;
+      fcs->ent = newfcs.ent;
       fcs->dso = dso;
-      fcs->cache = cache[n];
-      fcs->symsec = fcs->cache->symsec;
-      fcs->symtab = fcs->cache->symtab;
-      fcs->strsec = fcs->cache->strsec;
-      fcs->strtab = fcs->cache->strtab;
-      fcs->lastndx = -1;
+      fcs->cache = *cachep;
+      fcs->symsec = newfcs.symsec;
+      fcs->symtab = newfcs.symtab;
+      fcs->strsec = newfcs.strsec;
+      fcs->strtab = newfcs.strtab;
     }
   else
     dso = fcs->dso;
 
+  /* Find the last interval starting at or below ADDR.  */
   c = fcs->cache;
-  lo = 0;
-  hi = c->count;
-  if (fcs->lastndx != -1)
+  for (k = 1, best = 0; k <= c->count; )
+    if (c->vals[k].start <= addr)
+      {
+	best = k;
+	k = 2 * k + 1;
+      }
+    else
+      k = 2 * k;
+
+  if (best && c->vals[best].end >= addr + reloc_size)
     {
-      if (c->vals[fcs->lastndx].start <= addr)
-	{
-	  lo = fcs->lastndx;
-	  if (hi - lo >= 16)
-	    {
-	      if (c->vals[lo + 2].start > addr)
-		hi = lo + 2;
-	      else if (c->vals[lo + 15].start > addr)
-		hi = lo + 15;
-	    }
-	}
-      else
-	{
-	  hi = fcs->lastndx;
-	  if (hi >= 15)
-	    {
-	      if (c->vals[hi - 2].start <= addr)
-		lo = hi - 2;
-	      else if (c->vals[hi - 15].start <= addr)
-		lo = hi - 15;
-	    }
-	}
-    }
-  while (lo < hi)
-    {
-      mid = (lo + hi) / 2;
-      if (c->vals[mid].start <= addr)
-	{
-	  if (c->vals[mid].end >= addr + reloc_size)
-	    {
-	      gelfx_getsym (dso->elf, fcs->symtab, c->vals[mid].idx,
-			    &fcs->sym);
-	      fcs->lastndx = mid;
-	      return c->vals[mid].idx;
-	    }
-	  lo = mid + 1;
-	}
-      else
-	hi = mid;
+      gelfx_getsym (dso->elf, fcs->symtab, c->vals[best].idx, &fcs->sym);
+      return c->vals[best].idx;
     }
 
   return -1;
 }
 
-/* The idea here is that C++ virtual tables are always emitted
+/* The idea here is that C++ virtual tables (and typeinfo, VTTs and
+   construction virtual tables) are always emitted
    in .gnu.linkonce.d.* sections as WEAK symbols and they
    need to be the same.
    We check if they are and if yes, remove conflicts against
@@ -304,7 +318,7 @@ remove_redundant_cxx_conflicts (struct prelink_info *info)
   Elf_Data *binsymtab = NULL;
   int binsymtabsec;
   struct prelink_conflict *conflict;
-  struct find_cxx_sym_cache **cache;
+  struct find_cxx_sym_cache *bincache = NULL;
   struct find_cxx_sym_cache *binsymcache = NULL;
   int ret = 0;
   int rtype_class_valid;
@@ -330,14 +344,8 @@ remove_redundant_cxx_conflicts (struct prelink_info *info)
   state = 0;
   memset (&fcs1, 0, sizeof (fcs1));
   memset (&fcs2, 0, sizeof (fcs2));
-  cache = alloca (sizeof (struct find_cxx_sym_cache *)
-		  * (info->ent->ndepends + 1));
-  memset (cache, '\0', sizeof (struct find_cxx_sym_cache *)
-		       * (info->ent->ndepends + 1));
   for (i = 0; i < info->conflict_rela_size; ++i)
     {
-      size_t cidx;
-
       reloc_type = GELF_R_TYPE (info->conflict_rela[i].r_info);
       reloc_size = info->dso->arch->reloc_size (reloc_type);
 
@@ -357,7 +365,7 @@ remove_redundant_cxx_conflicts (struct prelink_info *info)
 	}
 
       n = find_cxx_sym (info, info->conflict_rela[i].r_offset,
-			&fcs1, reloc_size, cache);
+			&fcs1, reloc_size, &bincache);
 
       state = 0;
       if (n == -1)
@@ -398,14 +406,8 @@ remove_redundant_cxx_conflicts (struct prelink_info *info)
       symtab_start = fcs1.dso->shdr[fcs1.symsec].sh_addr - fcs1.dso->base;
       symoff = symtab_start + n * fcs1.dso->shdr[fcs1.symsec].sh_entsize;
 
-      cidx = 0;
-      if (info->conflicts[fcs1.n].hash != &info->conflicts[fcs1.n].first)
-	cidx = symoff % 251;
-      for (conflict = info->conflicts[fcs1.n].hash[cidx]; conflict;
-	   conflict = conflict->next)
-	if (conflict->symoff == symoff
-	    && conflict->reloc_class == rtype_class_valid)
-	  break;
+      conflict = prelink_conflict_find (&info->conflicts[fcs1.n], symoff,
+					rtype_class_valid);
 
       if (conflict == NULL)
 	goto check_pltref;
@@ -424,7 +426,7 @@ remove_redundant_cxx_conflicts (struct prelink_info *info)
 	goto check_pltref;
 
       o = find_cxx_sym (info, conflict->lookup.ent->base + conflict->lookupval,
-			&fcs2, fcs1.sym.st_size, cache);
+			&fcs2, fcs1.sym.st_size, &bincache);
 
       if (o == -2)
 	{
@@ -489,7 +491,12 @@ check_pltref:
 
       if (binsymcache == NULL)
 	{
-	  binsymcache = create_cache (info->dso, 1);
+	  struct find_cxx_sym binfcs;
+
+	  if (find_cxx_symtab (info->dso, &binfcs))
+	    binsymcache = (struct find_cxx_sym_cache *) -1UL;
+	  else
+	    binsymcache = create_cache (info->dso, &binfcs, 1);
 	  if (binsymcache == NULL)
 	    {
 	      ret = 1;
@@ -533,7 +540,6 @@ check_pltref:
 	  if (sym.st_shndx == SHN_UNDEF && sym.st_value)
 	    {
 	      struct prelink_symbol *s;
-	      size_t maxidx, l;
 
 	      if (verbose > 4)
 		error (0, 0, "Possible C++ conflict removal due to reference to binary's .plt at %s:%s+%d",
@@ -541,16 +547,12 @@ check_pltref:
 		       (int) (info->conflict_rela[i].r_offset
 			      - fcs1.sym.st_value));
 
-	      for (s = &info->symbols[ndx]; s; s = s->next)
-		if (s->reloc_class == RTYPE_CLASS_PLT)
-		  break;
+	      s = prelink_symbol_lookup (info, ndx, RTYPE_CLASS_PLT);
 
 	      if (s == NULL)
 		break;
 
-	      maxidx = 1;
-	      if (info->conflicts[fcs1.n].hash
-		  != &info->conflicts[fcs1.n].first)
+	      if (info->conflicts[fcs1.n].count >= 16)
 		{
 		  if (info->conflicts[fcs1.n].hash2 == NULL)
 		    {
@@ -558,20 +560,19 @@ check_pltref:
 			= calloc (sizeof (struct prelink_conflict *), 251);
 		      if (info->conflicts[fcs1.n].hash2 != NULL)
 			{
-			  for (l = 0; l < 251; l++)
-			    for (conflict = info->conflicts[fcs1.n].hash[l];
-				 conflict; conflict = conflict->next)
-			      if (conflict->reloc_class == rtype_class_valid
-				  && conflict->conflict.ent)
-				{
-				  size_t ccidx
-				    = (conflict->lookup.ent->base
-				       + conflict->lookupval) % 251;
-				  conflict->next2
-				    = info->conflicts[fcs1.n].hash2[ccidx];
-				  info->conflicts[fcs1.n].hash2[ccidx]
-				    = conflict;
-				}
+			  for (conflict = info->conflicts[fcs1.n].first;
+			       conflict; conflict = conflict->next)
+			    if (conflict->reloc_class == rtype_class_valid
+				&& conflict->conflict.ent)
+			      {
+				size_t ccidx
+				  = (conflict->lookup.ent->base
+				     + conflict->lookupval) % 251;
+				conflict->next2
+				  = info->conflicts[fcs1.n].hash2[ccidx];
+				info->conflicts[fcs1.n].hash2[ccidx]
+				  = conflict;
+			      }
 			}
 		    }
 		  if (info->conflicts[fcs1.n].hash2 != NULL)
@@ -587,31 +588,29 @@ check_pltref:
 			  goto pltref_remove;
 		      break;
 		    }
-		  maxidx = 251;
 		}
 
-	      for (l = 0; l < maxidx; l++)
-		for (conflict = info->conflicts[fcs1.n].hash[l];
-		     conflict; conflict = conflict->next)
-		  if (conflict->lookup.ent->base + conflict->lookupval
-		      == info->conflict_rela[i].r_addend
-		      && conflict->conflict.ent
-		      && (conflict->conflict.ent->base
-			  + conflict->conflictval == s->u.ent->base + s->value)
-		      && conflict->reloc_class == rtype_class_valid)
-		    {
+	      for (conflict = info->conflicts[fcs1.n].first;
+		   conflict; conflict = conflict->next)
+		if (conflict->lookup.ent->base + conflict->lookupval
+		    == info->conflict_rela[i].r_addend
+		    && conflict->conflict.ent
+		    && (conflict->conflict.ent->base
+			+ conflict->conflictval == s->u.ent->base + s->value)
+		    && conflict->reloc_class == rtype_class_valid)
+		  {
 pltref_remove:
-		      if (verbose > 3)
-			error (0, 0, "Removing C++ conflict due to reference to binary's .plt at %s:%s+%d",
-			       fcs1.dso->filename, name,
-			       (int) (info->conflict_rela[i].r_offset
-				      - fcs1.sym.st_value));
-
-		      info->conflict_rela[i].r_info =
-			GELF_R_INFO (1, GELF_R_TYPE (info->conflict_rela[i].r_info));
-		      ++removed;
-		      goto pltref_check_done;
-		    }
+		    if (verbose > 3)
+		      error (0, 0, "Removing C++ conflict due to reference to binary's .plt at %s:%s+%d",
+			     fcs1.dso->filename, name,
+			     (int) (info->conflict_rela[i].r_offset
+				    - fcs1.sym.st_value));
+
+		    info->conflict_rela[i].r_info =
+		      GELF_R_INFO (1, GELF_R_TYPE (info->conflict_rela[i].r_info));
+		    ++removed;
+		    goto pltref_check_done;
+		  }
 
 pltref_check_done:
 	      break;
@@ -632,9 +631,8 @@ pltref_check_done:
     }
 
 out_free_cache:
-  for (i = 0; i < info->ent->ndepends + 1; i++)
-    if (cache[i] && cache[i] != (struct find_cxx_sym_cache *) -1UL)
-      free (cache[i]);
+  if (bincache && bincache != (struct find_cxx_sym_cache *) -1UL)
+    free (bincache);
   if (binsymcache && binsymcache != (struct find_cxx_sym_cache *) -1UL)
     free (binsymcache);
   return ret;
@@ -0,0 +1,427 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <assert.h>
+#include <errno.h>
+#include <error.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prelink.h"
+
+/* With --defer-debug, adjust_dso does not touch .debug_info, .stab
+   and .mdebug, but records its arguments in a non-allocated
+   .gnu.prelink_debug section instead.  The section is a sequence of
+   target byte order words of address size:
+
+     nsteps
+     start adjust nranges (range_start range_end) * nranges
+     ...
+
+   where the ranges are the allocated sections at the time of the
+   adjust_dso call.  adjust_stabs and adjust_dwarf2 only change
+   addresses which fall into some section, so replaying the steps
+   against the recorded ranges gives exactly what adjusting them
+   right away would have.  */
+
+static const char debug_delta_name[] = ".gnu.prelink_debug";
+
+static int
+find_debug_delta (DSO *dso)
+{
+  int i;
+
+  for (i = 1; i < dso->ehdr.e_shnum; ++i)
+    if (dso->shdr[i].sh_type == SHT_PROGBITS
+	&& ! strcmp (strptr (dso, dso->ehdr.e_shstrndx,
+			     dso->shdr[i].sh_name), debug_delta_name))
+      return i;
+  return 0;
+}
+
+static GElf_Addr
+debug_delta_read (DSO *dso, unsigned char *ptr)
+{
+  if (gelf_getclass (dso->elf) == ELFCLASS32)
+    return buf_read_une32 (dso, ptr);
+  return buf_read_une64 (dso, ptr);
+}
+
+static void
+debug_delta_write (DSO *dso, unsigned char *ptr, GElf_Addr val)
+{
+  if (gelf_getclass (dso->elf) == ELFCLASS32)
+    buf_write_ne32 (dso, ptr, val);
+  else
+    buf_write_ne64 (dso, ptr, val);
+}
+
+static void
+free_debug_steps (struct PLDebugStep **stepsp, int *nstepsp)
+{
+  int i;
+
+  for (i = 0; i < *nstepsp; ++i)
+    free ((*stepsp)[i].ranges);
+  free (*stepsp);
+  *stepsp = NULL;
+  *nstepsp = 0;
+}
+
+void
+free_debug_delta (DSO *dso)
+{
+  free_debug_steps (&dso->debug_steps, &dso->ndebug_steps);
+  free_debug_steps (&dso->debuginfo_steps, &dso->ndebuginfo_steps);
+}
+
+/* Read pending steps from .gnu.prelink_debug, if DSO has one.  */
+int
+read_debug_delta (DSO *dso)
+{
+  Elf_Data *data;
+  unsigned char *ptr, *end;
+  size_t w;
+  GElf_Addr nsteps;
+  int sec, i, j;
+
+  sec = find_debug_delta (dso);
+  if (sec == 0)
+    return 0;
+
+  dso->debug_deferred = 1;
+  data = elf_getdata (dso->scn[sec], NULL);
+  if (data == NULL || data->d_size == 0)
+    return 0;
+
+  w = gelf_fsize (dso->elf, ELF_T_ADDR, 1, EV_CURRENT);
+  ptr = data->d_buf;
+  end = ptr + data->d_size;
+  if (end - ptr < w)
+    goto corrupt;
+  nsteps = debug_delta_read (dso, ptr);
+  ptr += w;
+  if (nsteps > (end - ptr) / (3 * w))
+    goto corrupt;
+
+  dso->debug_steps = calloc (nsteps, sizeof (struct PLDebugStep));
+  if (dso->debug_steps == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not read %s section", dso->filename,
+	     debug_delta_name);
+      return 1;
+    }
+  dso->ndebug_steps = nsteps;
+
+  for (i = 0; i < nsteps; ++i)
+    {
+      struct PLDebugStep *step = &dso->debug_steps[i];
+      GElf_Addr nranges;
+
+      if (end - ptr < 3 * w)
+	goto corrupt;
+      step->start = debug_delta_read (dso, ptr);
+      step->adjust = debug_delta_read (dso, ptr + w);
+      nranges = debug_delta_read (dso, ptr + 2 * w);
+      ptr += 3 * w;
+      if (nranges > (end - ptr) / (2 * w))
+	goto corrupt;
+      step->nranges = nranges;
+      if (nranges == 0)
+	continue;
+      step->ranges = malloc (2 * nranges * sizeof (GElf_Addr));
+      if (step->ranges == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could not read %s section", dso->filename,
+		 debug_delta_name);
+	  return 1;
+	}
+      for (j = 0; j < 2 * nranges; ++j, ptr += w)
+	step->ranges[j] = debug_delta_read (dso, ptr);
+    }
+
+  return 0;
+
+corrupt:
+  error (0, 0, "%s: Corrupted %s section", dso->filename, debug_delta_name);
+  return 1;
+}
+
+/* Store the address ranges of the allocated sections of DSO into
+   *RANGESP as start, end pairs, merging adjacent ones.  Return the
+   number of ranges, or -1 on failure.  */
+int
+debug_ranges (DSO *dso, GElf_Addr **rangesp)
+{
+  GElf_Addr *ranges;
+  int i, nranges = 0;
+
+  ranges = malloc (2 * dso->ehdr.e_shnum * sizeof (GElf_Addr));
+  if (ranges == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not record debug adjustment",
+	     dso->filename);
+      return -1;
+    }
+
+  for (i = 1; i < dso->ehdr.e_shnum; ++i)
+    {
+      if (! RELOCATE_SCN (dso->shdr[i].sh_flags)
+	  || dso->shdr[i].sh_size == 0
+	  || (dso->shdr[i].sh_type == SHT_NOBITS
+	      && (dso->shdr[i].sh_flags & SHF_TLS)))
+	continue;
+      if (nranges && ranges[2 * nranges - 1] == dso->shdr[i].sh_addr)
+	ranges[2 * nranges - 1] += dso->shdr[i].sh_size;
+      else
+	{
+	  ranges[2 * nranges] = dso->shdr[i].sh_addr;
+	  ranges[2 * nranges + 1] = dso->shdr[i].sh_addr
+				    + dso->shdr[i].sh_size;
+	  ++nranges;
+	}
+    }
+
+  *rangesp = ranges;
+  return nranges;
+}
+
+/* Append adjust_dso (DSO, START, ADJUST) to the *NSTEPSP steps
+   in *STEPSP.  */
+static int
+record_debug_step (DSO *dso, struct PLDebugStep **stepsp, int *nstepsp,
+		   GElf_Addr start, GElf_Addr adjust)
+{
+  struct PLDebugStep *step, *last;
+  GElf_Addr *ranges;
+  int i, nranges;
+
+  if (adjust == 0)
+    return 0;
+
+  nranges = debug_ranges (dso, &ranges);
+  if (nranges == -1)
+    return 1;
+
+  /* Moving the whole object twice is the same as moving it once,
+     which keeps the section from growing on each re-prelink and
+     lets --verify reproduce it.  */
+  last = *nstepsp ? &(*stepsp)[*nstepsp - 1] : NULL;
+  if (start == 0 && last != NULL && last->start == 0
+      && last->nranges == nranges)
+    {
+      for (i = 0; i < 2 * nranges; ++i)
+	if (last->ranges[i] + last->adjust != ranges[i])
+	  break;
+      if (i == 2 * nranges)
+	{
+	  free (ranges);
+	  last->adjust += adjust;
+	  if (last->adjust == 0)
+	    {
+	      free (last->ranges);
+	      --*nstepsp;
+	    }
+	  return 0;
+	}
+    }
+
+  step = realloc (*stepsp, (*nstepsp + 1) * sizeof (struct PLDebugStep));
+  if (step == NULL)
+    {
+      free (ranges);
+      error (0, ENOMEM, "%s: Could not record debug adjustment",
+	     dso->filename);
+      return 1;
+    }
+  *stepsp = step;
+  step += (*nstepsp)++;
+  step->start = start;
+  step->adjust = adjust;
+  step->nranges = nranges;
+  step->ranges = ranges;
+  return 0;
+}
+
+/* Record adjust_dso (DSO, START, ADJUST) for later replay.  */
+int
+record_debug_delta (DSO *dso, GElf_Addr start, GElf_Addr adjust)
+{
+  return record_debug_step (dso, &dso->debug_steps, &dso->ndebug_steps,
+			    start, adjust);
+}
+
+/* Record adjust_dso (DSO, START, ADJUST) for the separate debuginfo
+   file of DSO.  */
+int
+record_debuginfo_delta (DSO *dso, GElf_Addr start, GElf_Addr adjust)
+{
+  return record_debug_step (dso, &dso->debuginfo_steps,
+			    &dso->ndebuginfo_steps, start, adjust);
+}
+
+/* Store the recorded steps into .gnu.prelink_debug before DSO is
+   written.  */
+int
+finalize_debug_delta (DSO *dso)
+{
+  Elf_Data *data;
+  unsigned char *buf, *ptr;
+  GElf_Addr size, end, next;
+  size_t w;
+  int sec, i, j;
+
+  sec = find_debug_delta (dso);
+  if (sec == 0)
+    return 0;
+
+  w = gelf_fsize (dso->elf, ELF_T_ADDR, 1, EV_CURRENT);
+  size = 1;
+  for (i = 0; i < dso->ndebug_steps; ++i)
+    size += 3 + 2 * dso->debug_steps[i].nranges;
+  size *= w;
+
+  buf = malloc (size);
+  if (buf == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not write %s section", dso->filename,
+	     debug_delta_name);
+      return 1;
+    }
+
+  ptr = buf;
+  debug_delta_write (dso, ptr, dso->ndebug_steps);
+  ptr += w;
+  for (i = 0; i < dso->ndebug_steps; ++i)
+    {
+      struct PLDebugStep *step = &dso->debug_steps[i];
+
+      debug_delta_write (dso, ptr, step->start);
+      debug_delta_write (dso, ptr + w, step->adjust);
+      debug_delta_write (dso, ptr + 2 * w, step->nranges);
+      ptr += 3 * w;
+      for (j = 0; j < 2 * step->nranges; ++j, ptr += w)
+	debug_delta_write (dso, ptr, step->ranges[j]);
+    }
+
+  /* Make room if the section would overlap whatever follows it.  */
+  end = dso->shdr[sec].sh_offset + size;
+  next = dso->ehdr.e_shoff >= dso->shdr[sec].sh_offset
+	 ? dso->ehdr.e_shoff : end;
+  for (i = sec + 1; i < dso->ehdr.e_shnum; ++i)
+    if (! RELOCATE_SCN (dso->shdr[i].sh_flags)
+	&& dso->shdr[i].sh_type != SHT_NULL
+	&& dso->shdr[i].sh_type != SHT_NOBITS
+	&& dso->shdr[i].sh_offset >= dso->shdr[sec].sh_offset
+	&& dso->shdr[i].sh_offset < next)
+      next = dso->shdr[i].sh_offset;
+  if (end > next
+      && adjust_dso_nonalloc (dso, sec + 1, dso->shdr[sec].sh_offset,
+			      end - next))
+    {
+      free (buf);
+      return 1;
+    }
+
+  data = elf_getdata (dso->scn[sec], NULL);
+  assert (data != NULL && elf_getdata (dso->scn[sec], data) == NULL);
+  free (data->d_buf);
+  data->d_buf = buf;
+  data->d_size = size;
+  data->d_off = 0;
+  data->d_align = w;
+  data->d_type = ELF_T_BYTE;
+  dso->shdr[sec].sh_size = size;
+  elf_flagscn (dso->scn[sec], ELF_C_SET, ELF_F_DIRTY);
+  return 0;
+}
+
+/* Return non-zero if DSO has any sections adjust_debug_section
+   would change.  */
+int
+has_debug_sections (DSO *dso)
+{
+  int i;
+
+  for (i = 1; i < dso->ehdr.e_shnum; ++i)
+    if (debug_section_p (dso, i))
+      return 1;
+  return 0;
+}
+
+/* Apply the adjustments recorded in .gnu.prelink_debug to the
+   debugging sections of DSO and remove the section.  */
+int
+prelink_apply_debug (DSO *dso)
+{
+  struct section_move *move;
+  Elf_Data *data;
+  GElf_Shdr *shstr;
+  size_t len;
+  int sec, i, j;
+
+  sec = find_debug_delta (dso);
+  if (sec == 0)
+    return 0;
+
+  move = init_section_move (dso);
+  if (move == NULL)
+    return 1;
+
+  remove_section (move, sec);
+  if (reopen_dso (dso, move, NULL))
+    {
+      free (move);
+      return 1;
+    }
+  free (move);
+
+  /* The section name was added last to .shstrtab, drop it again.  */
+  shstr = &dso->shdr[dso->ehdr.e_shstrndx];
+  data = elf_getdata (dso->scn[dso->ehdr.e_shstrndx], NULL);
+  len = sizeof (debug_delta_name);
+  if (data != NULL && data->d_size == shstr->sh_size
+      && data->d_size >= len
+      && ! memcmp (data->d_buf + data->d_size - len, debug_delta_name, len))
+    {
+      for (i = 1; i < dso->ehdr.e_shnum; ++i)
+	if (dso->shdr[i].sh_name >= data->d_size - len)
+	  break;
+      if (i == dso->ehdr.e_shnum)
+	{
+	  data->d_size -= len;
+	  shstr->sh_size -= len;
+	}
+    }
+
+  for (i = 0; i < dso->ndebug_steps; ++i)
+    {
+      dso->debug_replay = &dso->debug_steps[i];
+      for (j = 1; j < dso->ehdr.e_shnum; ++j)
+	if (adjust_debug_section (dso, j, dso->debug_replay->start,
+				  dso->debug_replay->adjust))
+	  {
+	    dso->debug_replay = NULL;
+	    return 1;
+	  }
+    }
+
+  dso->debug_replay = NULL;
+  free_debug_steps (&dso->debug_steps, &dso->ndebug_steps);
+  dso->debug_deferred = 0;
+  return 0;
+}
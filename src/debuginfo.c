@@ -0,0 +1,529 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "prelink.h"
+
+#ifndef NT_GNU_BUILD_ID
+#define NT_GNU_BUILD_ID 3
+#endif
+
+#ifndef SHF_COMPRESSED
+#define SHF_COMPRESSED (1 << 11)
+#endif
+
+/* With --rebase-debuginfo, adjust_dso records its arguments, and
+   before a DSO is written the same adjustments are made to the
+   separate debuginfo file found through its build-id note or its
+   .gnu_debuglink section.  */
+
+extern uint32_t crc32 (uint32_t crc, unsigned char *buf, size_t len);
+
+/* Return the first section of DSO named NAME, or 0.  */
+static int
+find_section (DSO *dso, const char *name)
+{
+  int i;
+
+  for (i = 1; i < dso->ehdr.e_shnum; ++i)
+    if (! strcmp (strptr (dso, dso->ehdr.e_shstrndx,
+			  dso->shdr[i].sh_name), name))
+      return i;
+  return 0;
+}
+
+/* Find the NT_GNU_BUILD_ID note of DSO.  */
+static unsigned char *
+find_build_id (DSO *dso, size_t *lenp)
+{
+  int i;
+
+  for (i = 1; i < dso->ehdr.e_shnum; ++i)
+    {
+      Elf_Data *data;
+      unsigned char *ptr, *end;
+      GElf_Xword align;
+
+      if (dso->shdr[i].sh_type != SHT_NOTE
+	  || ! (dso->shdr[i].sh_flags & SHF_ALLOC))
+	continue;
+
+      data = elf_getdata (dso->scn[i], NULL);
+      if (data == NULL || data->d_buf == NULL)
+	continue;
+
+      align = dso->shdr[i].sh_addralign == 8 ? 8 : 4;
+      ptr = data->d_buf;
+      end = ptr + data->d_size;
+      while (end - ptr >= 12)
+	{
+	  uint32_t namesz = buf_read_une32 (dso, ptr);
+	  uint32_t descsz = buf_read_une32 (dso, ptr + 4);
+	  uint32_t type = buf_read_une32 (dso, ptr + 8);
+	  unsigned char *name = ptr + 12, *desc;
+
+	  desc = name + ((namesz + align - 1) & ~(align - 1));
+	  if (desc > end || descsz > end - desc)
+	    break;
+	  ptr = desc + ((descsz + align - 1) & ~(align - 1));
+	  if (type == NT_GNU_BUILD_ID && namesz == sizeof "GNU"
+	      && memcmp (name, "GNU", sizeof "GNU") == 0 && descsz >= 2)
+	    {
+	      *lenp = descsz;
+	      return desc;
+	    }
+	}
+    }
+  return NULL;
+}
+
+/* Return a pointer to the CRC in the .gnu_debuglink section of DSO
+   and store the section into *SECP, or return NULL if there is no
+   such section.  */
+static unsigned char *
+find_debuglink_crc (DSO *dso, int *secp)
+{
+  Elf_Data *data;
+  size_t off;
+  int sec;
+
+  sec = find_section (dso, ".gnu_debuglink");
+  if (sec == 0)
+    return NULL;
+
+  data = elf_getdata (dso->scn[sec], NULL);
+  if (data == NULL || data->d_buf == NULL)
+    return NULL;
+  off = (strnlen (data->d_buf, data->d_size) + 4) & ~(size_t) 3;
+  if (off + 4 > data->d_size)
+    return NULL;
+  *secp = sec;
+  return (unsigned char *) data->d_buf + off;
+}
+
+/* When the .gnu.prelink_undo data of DSO is created, append the
+   original .gnu_debuglink CRC to it, so that undoing can restore it
+   after update_debuginfo changed it.  */
+int
+save_debuglink_crc (DSO *dso)
+{
+  unsigned char *crc, *buf;
+  int sec;
+
+  crc = find_debuglink_crc (dso, &sec);
+  if (crc == NULL)
+    return 0;
+
+  buf = realloc (dso->undo.d_buf, dso->undo.d_size + 4);
+  if (buf == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not create .gnu.prelink_undo section",
+	     dso->filename);
+      return 1;
+    }
+  memcpy (buf + dso->undo.d_size, crc, 4);
+  dso->undo.d_buf = buf;
+  dso->undo.d_size += 4;
+  return 0;
+}
+
+/* Copy the .gnu_debuglink CRC of DSO to CRC.  Return 1 if there is
+   one, 0 otherwise.  */
+int
+get_debuglink_crc (DSO *dso, unsigned char *crc)
+{
+  unsigned char *p;
+  int sec;
+
+  p = find_debuglink_crc (dso, &sec);
+  if (p == NULL)
+    return 0;
+  memcpy (crc, p, 4);
+  return 1;
+}
+
+/* Store CRC into the .gnu_debuglink section of DSO, if it has one.  */
+void
+set_debuglink_crc (DSO *dso, const unsigned char *crc)
+{
+  unsigned char *p;
+  int sec;
+
+  p = find_debuglink_crc (dso, &sec);
+  if (p == NULL)
+    return;
+  memcpy (p, crc, 4);
+  elf_flagscn (dso->scn[sec], ELF_C_SET, ELF_F_DIRTY);
+}
+
+/* Compute the .gnu_debuglink CRC of the file open as FD.  */
+static int
+file_crc (int fd, uint32_t *crcp)
+{
+  unsigned char buf[65536];
+  uint32_t crc = 0;
+  off_t off = 0;
+  ssize_t n;
+
+  while ((n = pread (fd, buf, sizeof buf, off)) > 0)
+    {
+      crc = crc32 (crc, buf, n);
+      off += n;
+    }
+  if (n < 0)
+    return 1;
+  *crcp = crc;
+  return 0;
+}
+
+/* Return the name of the separate debuginfo file of DSO, or NULL
+   if it does not have one.  */
+static char *
+find_debuginfo (DSO *dso)
+{
+  unsigned char *id;
+  size_t len, i;
+  char *name, *p, *dir, *canon;
+  const char *link;
+  Elf_Data *data;
+  uint32_t crc, filecrc;
+  int sec, n, fd;
+
+  id = find_build_id (dso, &len);
+  if (id != NULL)
+    {
+      name = malloc (strlen (debuginfo_dir) + sizeof "/.build-id//.debug"
+		     + 2 * len);
+      if (name == NULL)
+	goto nomem;
+      p = name + sprintf (name, "%s/.build-id/%02x/", debuginfo_dir, id[0]);
+      for (i = 1; i < len; ++i)
+	p += sprintf (p, "%02x", id[i]);
+      strcpy (p, ".debug");
+      if (access (name, F_OK) == 0)
+	return name;
+      free (name);
+    }
+
+  sec = find_section (dso, ".gnu_debuglink");
+  if (sec == 0)
+    return NULL;
+
+  data = elf_getdata (dso->scn[sec], NULL);
+  if (data == NULL || data->d_buf == NULL)
+    return NULL;
+  link = data->d_buf;
+  len = strnlen (link, data->d_size);
+  i = (len + 4) & ~(size_t) 3;
+  if (len == 0 || i + 4 > data->d_size)
+    {
+      error (0, 0, "%s: Corrupted .gnu_debuglink section", dso->filename);
+      return NULL;
+    }
+  crc = buf_read_une32 (dso, data->d_buf + i);
+
+  canon = prelink_canonicalize (dso->filename, NULL);
+  if (canon == NULL)
+    goto nomem;
+  dir = strdupa (canon);
+  free (canon);
+  p = strrchr (dir, '/');
+  if (p != NULL)
+    *p = '\0';
+
+  name = malloc (strlen (debuginfo_dir) + 2 * strlen (dir) + len
+		 + sizeof "/.debug/");
+  if (name == NULL)
+    goto nomem;
+  for (n = 0; n < 3; ++n)
+    {
+      switch (n)
+	{
+	case 0:
+	  sprintf (name, "%s/%s", dir, link);
+	  break;
+	case 1:
+	  sprintf (name, "%s/.debug/%s", dir, link);
+	  break;
+	case 2:
+	  sprintf (name, "%s%s/%s", debuginfo_dir, dir, link);
+	  break;
+	}
+      fd = open (name, O_RDONLY);
+      if (fd < 0)
+	continue;
+      if (file_crc (fd, &filecrc) == 0 && filecrc == crc)
+	{
+	  close (fd);
+	  return name;
+	}
+      close (fd);
+    }
+  free (name);
+  return NULL;
+
+nomem:
+  error (0, ENOMEM, "%s: Could not look for separate debuginfo",
+	 dso->filename);
+  return NULL;
+}
+
+/* Open the separate debuginfo file FD named NAME for updating, as
+   a DSO of the same kind as DSO.  */
+static DSO *
+open_debuginfo (DSO *dso, int fd, const char *name)
+{
+  Elf *elf;
+  GElf_Ehdr ehdr;
+  DSO *debug;
+  int i;
+
+  elf = elf_begin (fd, ELF_C_RDWR, NULL);
+  if (elf == NULL || elf_kind (elf) != ELF_K_ELF
+      || gelf_getehdr (elf, &ehdr) == NULL)
+    {
+      error (0, 0, "%s: cannot open ELF file: %s", name, elf_errmsg (-1));
+      goto error_out;
+    }
+
+  if (ehdr.e_ident[EI_CLASS] != dso->ehdr.e_ident[EI_CLASS]
+      || ehdr.e_ident[EI_DATA] != dso->ehdr.e_ident[EI_DATA]
+      || ehdr.e_machine != dso->ehdr.e_machine
+      || ehdr.e_shnum == 0)
+    {
+      error (0, 0, "%s: does not look like debuginfo for %s", name,
+	     dso->filename);
+      goto error_out;
+    }
+
+  debug = (DSO *)
+	  calloc (1, sizeof (DSO) + ehdr.e_shnum * sizeof (GElf_Shdr)
+		     + (ehdr.e_phnum + 1) * sizeof (GElf_Phdr)
+		     + ehdr.e_shnum * sizeof (Elf_Scn *));
+  if (debug == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not open debuginfo", name);
+      goto error_out;
+    }
+
+  elf_flagelf (elf, ELF_C_SET, ELF_F_LAYOUT | ELF_F_PERMISSIVE);
+  debug->elf = elf;
+  debug->ehdr = ehdr;
+  debug->phdr = (GElf_Phdr *) &debug->shdr[ehdr.e_shnum];
+  debug->scn = (Elf_Scn **) &debug->phdr[ehdr.e_phnum + 1];
+  debug->mask = dso->mask;
+  debug->arch = dso->arch;
+  debug->fd = fd;
+  debug->filename = name;
+  for (i = 0; i < ehdr.e_phnum; ++i)
+    gelf_getphdr (elf, i, debug->phdr + i);
+  for (i = 0; i < ehdr.e_shnum; ++i)
+    {
+      debug->scn[i] = elf_getscn (elf, i);
+      gelfx_getshdr (elf, debug->scn[i], debug->shdr + i);
+    }
+  return debug;
+
+error_out:
+  if (elf != NULL)
+    elf_end (elf);
+  return NULL;
+}
+
+/* Repeat the adjustments made to DSO on a temporary copy of its
+   separate debuginfo file, and update the .gnu_debuglink CRC of DSO to
+   match.  On success *NAMEP and *TEMPP are set to the names of the
+   debuginfo file and of the copy, which finish_debuginfo renames over
+   it once DSO itself has been written.  */
+int
+update_debuginfo (DSO *dso, char **namep, char **tempp)
+{
+  char *name, *temp_name = NULL;
+  DSO *debug = NULL;
+  GElf_Addr *ranges = NULL;
+  struct stat64 st;
+  uint32_t crc;
+  unsigned char *crcp, origcrc[4];
+  int fd = -1, fdin = -1, i, nranges, sec, undo, ret = 1;
+
+  name = find_debuginfo (dso);
+  if (name == NULL)
+    return 0;
+
+  /* Undoing a prelinked DSO must give back its original CRC, which
+     is only known if it was saved when it was prelinked first.  */
+  crcp = find_debuglink_crc (dso, &sec);
+  undo = find_section (dso, ".gnu.prelink_undo");
+  if (crcp != NULL && undo != 0
+      && undo_debuglink_crc (dso, undo, origcrc) != 1)
+    {
+      error (0, 0, "%s: first prelinked without --rebase-debuginfo, not updating %s",
+	     dso->filename, name);
+      goto out;
+    }
+
+  /* Build-id links are usually symlinks, update what they point to.  */
+  temp_name = prelink_canonicalize (name, NULL);
+  if (temp_name != NULL)
+    {
+      free (name);
+      name = temp_name;
+      temp_name = NULL;
+    }
+
+  fdin = open (name, O_RDONLY);
+  if (fdin < 0 || fstat64 (fdin, &st) < 0)
+    {
+      error (0, errno, "Could not open %s", name);
+      goto out;
+    }
+
+  temp_name = malloc (strlen (name) + sizeof ".#prelink#.XXXXXX");
+  if (temp_name == NULL)
+    {
+      error (0, ENOMEM, "Could not update %s", name);
+      goto out;
+    }
+  sprintf (temp_name, "%s.#prelink#.XXXXXX", name);
+  fd = mkstemp (temp_name);
+  if (fd < 0)
+    {
+      error (0, errno, "Could not create temporary file %s", temp_name);
+      free (temp_name);
+      temp_name = NULL;
+      goto out;
+    }
+  close (fd);
+  fd = -1;
+  i = copy_fd_to_file (fdin, temp_name, &st);
+  if (i)
+    {
+      error (0, i, "Could not copy %s", name);
+      goto out;
+    }
+
+  fd = open (temp_name, O_RDWR);
+  if (fd < 0)
+    {
+      error (0, errno, "Could not open %s", temp_name);
+      goto out;
+    }
+
+  debug = open_debuginfo (dso, fd, name);
+  if (debug == NULL)
+    goto out;
+
+  /* The debuginfo file must start where DSO did before the first
+     adjustment, otherwise it is stale already.  Section sizes may
+     differ, prelink grows some sections it converts.  */
+  nranges = debug_ranges (debug, &ranges);
+  if (nranges == -1)
+    goto out;
+  if (nranges == 0 || dso->debuginfo_steps[0].nranges == 0
+      || ranges[0] != dso->debuginfo_steps[0].ranges[0])
+    {
+      error (0, 0, "%s: does not match %s, not updating it", name,
+	     dso->filename);
+      goto out;
+    }
+
+  for (i = 1; i < debug->ehdr.e_shnum; ++i)
+    if (debug_section_p (debug, i)
+	&& (debug->shdr[i].sh_flags & SHF_COMPRESSED))
+      {
+	error (0, 0, "%s: Compressed debugging sections not supported",
+	       name);
+	goto out;
+      }
+
+  for (i = 0; i < dso->ndebuginfo_steps; ++i)
+    if (adjust_debuginfo (debug, dso->debuginfo_steps[i].start,
+			  dso->debuginfo_steps[i].adjust))
+      goto out;
+
+  if (elf_update (debug->elf, ELF_C_WRITE) == -1)
+    {
+      error (0, 0, "Could not write %s: %s", name, elf_errmsg (-1));
+      goto out;
+    }
+  elf_end (debug->elf);
+  free (debug);
+  debug = NULL;
+
+  if (file_crc (fd, &crc))
+    {
+      error (0, errno, "Could not read %s", temp_name);
+      goto out;
+    }
+
+  if (crcp != NULL)
+    {
+      buf_write_ne32 (dso, crcp, crc);
+      elf_flagscn (dso->scn[sec], ELF_C_SET, ELF_F_DIRTY);
+    }
+  *namep = name;
+  *tempp = temp_name;
+  name = NULL;
+  temp_name = NULL;
+  ret = 0;
+
+out:
+  if (debug != NULL)
+    {
+      elf_end (debug->elf);
+      free (debug);
+    }
+  if (fd >= 0)
+    close (fd);
+  if (fdin >= 0)
+    close (fdin);
+  if (temp_name != NULL)
+    {
+      unlink (temp_name);
+      free (temp_name);
+    }
+  free (ranges);
+  free (name);
+  return ret;
+}
+
+/* Rename the debuginfo copy TEMP_NAME written by update_debuginfo over
+   NAME if COMMIT, otherwise remove it, so that the debuginfo file only
+   changes together with its object.  */
+void
+finish_debuginfo (char *name, char *temp_name, int commit)
+{
+  if (temp_name == NULL)
+    return;
+  if (commit && rename (temp_name, name))
+    {
+      error (0, errno, "Could not rename temporary to %s", name);
+      commit = 0;
+    }
+  if (! commit)
+    unlink (temp_name);
+  free (temp_name);
+  free (name);
+}
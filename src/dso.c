@@ -22,6 +22,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
@@ -35,9 +36,6 @@
 
 #include <sys/xattr.h>
 
-#define RELOCATE_SCN(shf) \
-  ((shf) & (SHF_WRITE | SHF_ALLOC | SHF_EXECINSTR))
-
 #ifndef ELF_F_PERMISSIVE
 # define ELF_F_PERMISSIVE 0
 #endif
@@ -539,6 +537,9 @@ fdopen_dso (int fd, const char *name)
 	  }
       }
 
+  if (read_debug_delta (dso))
+    goto error_out;
+
   return dso;
 
 error_out:
@@ -748,6 +749,7 @@ reopen_dso (DSO *dso, struct section_move *move, const char *temp_base)
 		+ sizeof ("/dev/shm/.#prelink#.XXXXXX")];
   int adddel = 0;
   int free_move = 0;
+  int in_memory = 0;
   Elf *elf = NULL;
   GElf_Ehdr ehdr;
   char *e_ident;
@@ -767,7 +769,15 @@ reopen_dso (DSO *dso, struct section_move *move, const char *temp_base)
     temp_base = dso->filename;
   sprintf (filename, "%s.#prelink#.XXXXXX", temp_base);
 
-  fd = mkstemp (filename);
+  fd = -1;
+#ifdef __NR_memfd_create
+  /* Kernels before 3.17 fail this, then a temporary file is used.  */
+  if (dso->temp_in_memory)
+    fd = syscall (__NR_memfd_create, "prelink", 0);
+#endif
+  in_memory = fd != -1;
+  if (! in_memory)
+    fd = mkstemp (filename);
   if (fd == -1)
     {
       strcpy (filename, "/tmp/#prelink#.XXXXXX");
@@ -901,8 +911,8 @@ reopen_dso (DSO *dso, struct section_move *move, const char *temp_base)
     }
 
   ehdr.e_shnum = move->new_shnum;
-  dso->temp_filename = strdup (filename);
-  if (dso->temp_filename == NULL)
+  dso->temp_filename = in_memory ? NULL : strdup (filename);
+  if (! in_memory && dso->temp_filename == NULL)
     {
       error (0, ENOMEM, "%s: Could not save temporary filename", dso->filename);
       goto error_out;
@@ -1017,7 +1027,8 @@ error_out:
     elf_end (elf);
   if (fd != -1)
     {
-      unlink (filename);
+      if (! in_memory)
+	unlink (filename);
       close (fd);
     }
   return 1;
@@ -1190,26 +1201,54 @@ adjust_dynamic (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
   return 0;
 }
 
+/* Like addr_to_sec, but with the caller providing the section
+   to try first in *HINT.  Threads sharing one DSO use their own.  */
 int
-addr_to_sec (DSO *dso, GElf_Addr addr)
+addr_to_sec_hint (DSO *dso, GElf_Addr addr, int *hint)
 {
   GElf_Shdr *shdr;
   int i;
 
-  shdr = &dso->shdr[dso->lastscn];
+  shdr = &dso->shdr[*hint];
   for (i = -1; i < dso->ehdr.e_shnum; shdr = &dso->shdr[++i])
     if (RELOCATE_SCN (shdr->sh_flags)
 	&& shdr->sh_addr <= addr && shdr->sh_addr + shdr->sh_size > addr
 	&& (shdr->sh_type != SHT_NOBITS || (shdr->sh_flags & SHF_TLS) == 0))
       {
 	if (i != -1)
-	  dso->lastscn = i;
-	return dso->lastscn;
+	  *hint = i;
+	return *hint;
       }
 
   return -1;
 }
 
+int
+addr_to_sec (DSO *dso, GElf_Addr addr)
+{
+  return addr_to_sec_hint (dso, addr, &dso->lastscn);
+}
+
+/* Like addr_to_sec_hint, for addresses found in debugging sections.
+   When replaying a deferred adjustment, ADDR is looked up in the
+   sections as they were laid out back then and the result is only
+   good for comparing against -1.  */
+int
+debug_addr_to_sec (DSO *dso, GElf_Addr addr, int *hint)
+{
+  struct PLDebugStep *step = dso->debug_replay;
+  int i;
+
+  if (step == NULL)
+    return addr_to_sec_hint (dso, addr, hint);
+
+  for (i = 0; i < step->nranges; ++i)
+    if (step->ranges[2 * i] <= addr && step->ranges[2 * i + 1] > addr)
+      return i;
+
+  return -1;
+}
+
 static int
 adjust_rel (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
 {
@@ -1311,16 +1350,52 @@ adjust_dso_nonalloc (DSO *dso, int first, GElf_Addr start, GElf_Addr adjust)
   return adjust_nonalloc (dso, &dso->ehdr, dso->shdr, first, start, adjust);
 }
 
-/* Add ADJUST to all addresses above START.  */
+/* Return non-zero if section N is a debugging section with addresses
+   in it.  */
 int
-adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
+debug_section_p (DSO *dso, int n)
 {
-  int i;
+  const char *name;
 
-  if (dso->arch->arch_adjust
-      && dso->arch->arch_adjust (dso, start, adjust))
+  if ((dso->arch->machine == EM_ALPHA
+       && dso->shdr[n].sh_type == SHT_ALPHA_DEBUG)
+      || (dso->arch->machine == EM_MIPS
+	  && dso->shdr[n].sh_type == SHT_MIPS_DEBUG))
     return 1;
 
+  if (dso->shdr[n].sh_type != SHT_PROGBITS)
+    return 0;
+
+  name = strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[n].sh_name);
+  return strcmp (name, ".stab") == 0 || strcmp (name, ".debug_info") == 0;
+}
+
+/* Add ADJUST to all addresses above START in debugging section N,
+   if it is one.  */
+int
+adjust_debug_section (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
+{
+  const char *name;
+
+  if (! debug_section_p (dso, n))
+    return 0;
+
+  if (dso->shdr[n].sh_type != SHT_PROGBITS)
+    return adjust_mdebug (dso, n, start, adjust);
+
+  name = strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[n].sh_name);
+  if (strcmp (name, ".stab") == 0)
+    return adjust_stabs (dso, n, start, adjust);
+  return adjust_dwarf2 (dso, n, start, adjust);
+}
+
+/* Add ADJUST to the entry point and program header addresses above
+   START.  */
+static int
+adjust_headers (DSO *dso, GElf_Addr start, GElf_Addr adjust)
+{
+  int i;
+
   if (dso->ehdr.e_entry >= start)
     {
       dso->ehdr.e_entry += adjust;
@@ -1366,11 +1441,30 @@ adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
       gelf_update_phdr (dso->elf, i, dso->phdr + i);
     }
   elf_flagphdr (dso->elf, ELF_C_SET, ELF_F_DIRTY);
+  return 0;
+}
+
+/* Add ADJUST to all addresses above START.  */
+int
+adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
+{
+  int i;
+
+  if (dso->debug_deferred && record_debug_delta (dso, start, adjust))
+    return 1;
+
+  if (rebase_debuginfo && record_debuginfo_delta (dso, start, adjust))
+    return 1;
+
+  if (dso->arch->arch_adjust
+      && dso->arch->arch_adjust (dso, start, adjust))
+    return 1;
+
+  if (adjust_headers (dso, start, adjust))
+    return 1;
 
   for (i = 1; i < dso->ehdr.e_shnum; i++)
     {
-      const char *name;
-
       if (dso->arch->adjust_section)
 	{
 	  int ret = dso->arch->adjust_section (dso, i, start, adjust);
@@ -1382,15 +1476,6 @@ adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	}
       switch (dso->shdr[i].sh_type)
 	{
-	case SHT_PROGBITS:
-	  name = strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[i].sh_name);
-	  if (strcmp (name, ".stab") == 0
-	      && adjust_stabs (dso, i, start, adjust))
-	    return 1;
-	  if (strcmp (name, ".debug_info") == 0
-	      && adjust_dwarf2 (dso, i, start, adjust))
-	    return 1;
-	  break;
 	case SHT_HASH:
 	case SHT_GNU_HASH:
 	case SHT_NOBITS:
@@ -1414,12 +1499,9 @@ adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	    return 1;
 	  break;
 	}
-      if ((dso->arch->machine == EM_ALPHA
-	   && dso->shdr[i].sh_type == SHT_ALPHA_DEBUG)
-	  || (dso->arch->machine == EM_MIPS
-	      && dso->shdr[i].sh_type == SHT_MIPS_DEBUG))
-	if (adjust_mdebug (dso, i, start, adjust))
-	  return 1;
+      if (! dso->debug_deferred
+	  && adjust_debug_section (dso, i, start, adjust))
+	return 1;
     }
 
   for (i = 0; i < dso->ehdr.e_shnum; i++)
@@ -1471,6 +1553,39 @@ adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
   return start ? adjust_dso_nonalloc (dso, 0, 0, adjust) : 0;
 }
 
+/* Like adjust_dso, for a separate debuginfo file DSO.  Only its
+   symbol table and debugging sections have contents, and section
+   file offsets have nothing to do with addresses in it.  */
+int
+adjust_debuginfo (DSO *dso, GElf_Addr start, GElf_Addr adjust)
+{
+  int i;
+
+  if (adjust_headers (dso, start, adjust))
+    return 1;
+
+  for (i = 1; i < dso->ehdr.e_shnum; i++)
+    if (dso->shdr[i].sh_type == SHT_SYMTAB)
+      {
+	if (adjust_symtab (dso, i, start, adjust))
+	  return 1;
+      }
+    else if (dso->shdr[i].sh_type == SHT_PROGBITS
+	     && adjust_debug_section (dso, i, start, adjust))
+      return 1;
+
+  for (i = 1; i < dso->ehdr.e_shnum; i++)
+    if (RELOCATE_SCN (dso->shdr[i].sh_flags)
+	&& dso->shdr[i].sh_addr >= start)
+      {
+	dso->shdr[i].sh_addr += adjust;
+	gelfx_update_shdr (dso->elf, dso->scn[i], dso->shdr + i);
+	elf_flagshdr (dso->scn[i], ELF_C_SET, ELF_F_DIRTY);
+      }
+
+  return 0;
+}
+
 int
 recompute_nonalloc_offsets (DSO *dso)
 {
@@ -1645,6 +1760,7 @@ close_dso_1 (DSO *dso)
   free (dso->move);
   free (dso->adjust);
   free (dso->undo.d_buf);
+  free_debug_delta (dso);
   free (dso);
   return 0;
 }
@@ -1665,7 +1781,8 @@ prepare_write_dso (DSO *dso)
 {
   int i;
 
-  if (check_dso (dso)
+  if ((dso->debug_deferred && finalize_debug_delta (dso))
+      || check_dso (dso)
       || (dso->mdebug_orig_offset && finalize_mdebug (dso)))
     return 1;
 
@@ -1861,11 +1978,17 @@ update_dso (DSO *dso, const char *orig_name)
 
   if (rdwr)
     {
-      char *name1, *name2;
+      char *name1, *name2, *debug_name = NULL, *debug_temp = NULL;
       struct utimbuf u;
       struct stat64 st;
       int fdin;
 
+      /* A stale separate debuginfo file is no reason not to write
+	 DSO, so errors are only reported.  The updated debuginfo file
+	 only replaces the old one once DSO has been renamed.  */
+      if (orig_name == NULL && dso->ndebuginfo_steps)
+	update_debuginfo (dso, &debug_name, &debug_temp);
+
       switch (write_dso (dso))
 	{
 	case 2:
@@ -1874,6 +1997,7 @@ update_dso (DSO *dso, const char *orig_name)
 	  /* FALLTHROUGH */
 	case 1:
 	  close_dso (dso);
+	  finish_debuginfo (debug_name, debug_temp, 0);
 	  return 1;
 	case 0:
 	  break;
@@ -1885,6 +2009,7 @@ update_dso (DSO *dso, const char *orig_name)
 	{
 	  error (0, errno, "Could not stat %s", dso->filename);
 	  close_dso (dso);
+	  finish_debuginfo (debug_name, debug_temp, 0);
 	  return 1;
 	}
       if ((fchown (dso->fd, st.st_uid, st.st_gid) < 0
@@ -1893,6 +2018,7 @@ update_dso (DSO *dso, const char *orig_name)
 	{
 	  error (0, errno, "Could not set %s owner or mode", dso->filename);
 	  close_dso (dso);
+	  finish_debuginfo (debug_name, debug_temp, 0);
 	  return 1;
 	}
       if (orig_name != NULL)
@@ -1910,6 +2036,7 @@ update_dso (DSO *dso, const char *orig_name)
 	  if (fdin != -1)
 	    close (fdin);
 	  unlink (name2);
+	  finish_debuginfo (debug_name, debug_temp, 0);
 	  return 1;
 	}
 
@@ -1930,10 +2057,12 @@ update_dso (DSO *dso, const char *orig_name)
 	    }
 	  unlink (name2);
 	  error (0, errno, "Could not rename temporary to %s", name1);
+	  finish_debuginfo (debug_name, debug_temp, 0);
 	  return 1;
 	}
       if (fdin != -1)
 	close (fdin);
+      finish_debuginfo (debug_name, debug_temp, 1);
     }
   else
     close_dso_1 (dso);
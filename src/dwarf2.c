@@ -25,6 +25,10 @@
 #include <limits.h>
 #include <string.h>
 #include <sys/types.h>
+#include <unistd.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #include "dwarf2.h"
 #include "hashtab.h"
@@ -46,40 +50,38 @@
   ret;					\
 })
 
-static uint16_t (*do_read_16) (unsigned char *ptr);
-static uint32_t (*do_read_32) (unsigned char *ptr);
-static uint64_t (*do_read_32_64) (unsigned char *ptr);
-static uint64_t (*do_read_64) (unsigned char *ptr);
-static uint64_t (*do_read_ptr) (unsigned char *ptr);
-static void (*write_32) (unsigned char *ptr, GElf_Addr val);
-static void (*write_64) (unsigned char *ptr, GElf_Addr val);
-static void (*write_ptr) (unsigned char *ptr, GElf_Addr val);
-
-static int ptr_size;
-
 #define read_1(ptr) *ptr++
 
 #define read_16(ptr) ({			\
-  uint16_t ret = do_read_16 (ptr);	\
+  uint16_t ret = dw->do_read_16 (ptr);	\
   ptr += 2;				\
   ret;					\
 })
 
 #define read_32(ptr) ({			\
-  uint32_t ret = do_read_32 (ptr);	\
+  uint32_t ret = dw->do_read_32 (ptr);	\
   ptr += 4;				\
   ret;					\
 })
 
 #define read_64(ptr) ({			\
-  uint64_t ret = do_read_64 (ptr);	\
+  uint64_t ret = dw->do_read_64 (ptr);	\
   ptr += 8;				\
   ret;					\
 })
 
 #define read_ptr(ptr) ({		\
-  uint64_t ret = do_read_ptr (ptr);	\
-  ptr += ptr_size;			\
+  uint64_t ret = dw->do_read_ptr (ptr);	\
+  ptr += dw->ptr_size;			\
+  ret;					\
+})
+
+#define read_offset(ptr, size) ({	\
+  uint64_t ret;				\
+  if ((size) == 8)			\
+    ret = read_64 (ptr);		\
+  else					\
+    ret = read_32 (ptr);		\
   ret;					\
 })
 
@@ -143,13 +145,7 @@ dwarf2_write_be64 (unsigned char *p, GElf_Addr val)
   p[0] = val >> 56;
 }
 
-static struct
-  {
-    const char *name;
-    unsigned char *data;
-    size_t size;
-    int sec;
-  } debug_sections[] =
+static const char *debug_section_names[] =
   {
 #define DEBUG_INFO	0
 #define DEBUG_ABBREV	1
@@ -164,26 +160,48 @@ static struct
 #define DEBUG_RANGES	10
 #define DEBUG_TYPES	11
 #define DEBUG_MACRO	12
-    { ".debug_info", NULL, 0, 0 },
-    { ".debug_abbrev", NULL, 0, 0 },
-    { ".debug_line", NULL, 0, 0 },
-    { ".debug_aranges", NULL, 0, 0 },
-    { ".debug_pubnames", NULL, 0, 0 },
-    { ".debug_pubtypes", NULL, 0, 0 },
-    { ".debug_macinfo", NULL, 0, 0 },
-    { ".debug_loc", NULL, 0, 0 },
-    { ".debug_str", NULL, 0, 0 },
-    { ".debug_frame", NULL, 0, 0 },
-    { ".debug_ranges", NULL, 0, 0 },
-    { ".debug_types", NULL, 0, 0 },
-    { ".debug_macro", NULL, 0, 0 },
-    { NULL, NULL, 0 }
+#define DEBUG_ADDR	13
+#define DEBUG_RNGLISTS	14
+#define DEBUG_LOCLISTS	15
+#define DEBUG_LINE_STR	16
+#define DEBUG_STR_OFFSETS 17
+#define DEBUG_NAMES	18
+#define DEBUG_GNU_PUBNAMES 19
+#define DEBUG_GNU_PUBTYPES 20
+#define DEBUG_NSECTIONS	21
+    ".debug_info",
+    ".debug_abbrev",
+    ".debug_line",
+    ".debug_aranges",
+    ".debug_pubnames",
+    ".debug_pubtypes",
+    ".debug_macinfo",
+    ".debug_loc",
+    ".debug_str",
+    ".debug_frame",
+    ".debug_ranges",
+    ".debug_types",
+    ".debug_macro",
+    ".debug_addr",
+    ".debug_rnglists",
+    ".debug_loclists",
+    ".debug_line_str",
+    ".debug_str_offsets",
+    ".debug_names",
+    ".debug_gnu_pubnames",
+    ".debug_gnu_pubtypes",
+    NULL
   };
 
 struct abbrev_attr
   {
     unsigned int attr;
     unsigned int form;
+    /* If NSKIP is non-zero, this and the following NSKIP - 1
+       attributes need no adjustment and together take
+       SKIP + NOFFSETS * offset size bytes.  */
+    unsigned int skip;
+    unsigned short nskip, noffsets;
   };
 
 struct abbrev_tag
@@ -194,76 +212,288 @@ struct abbrev_tag
     struct abbrev_attr attr[0];
   };
 
+/* Decoded abbreviation table at .debug_abbrev offset OFFSET.  TAGS
+   are sorted by abbreviation code.  If the codes are dense enough,
+   INDEX maps each code below NINDEX directly to its tag.  */
+struct abbrev_table
+  {
+    GElf_Addr offset;
+    struct abbrev_tag **tags;
+    struct abbrev_tag **index;
+    unsigned int ntags, nindex;
+  };
+
 struct cu_data
   {
     GElf_Addr cu_entry_pc;
     GElf_Addr cu_low_pc;
     unsigned char cu_version;
+    unsigned char cu_offset_size;
+  };
+
+/* GCC emits location view lists into .debug_loclists right before
+   the location list they belong to, without any entry kind that
+   would allow skipping them.  Remember the [start, end) offsets
+   of each so that adjust_dwarf2_loclists can step over them.  */
+struct locview_range
+  {
+    GElf_Addr start, end;
+  };
+
+/* State for adjusting the debugging sections of one DSO.  When a
+   section is adjusted by several threads, each gets its own copy
+   and the locview ranges are merged afterwards.  */
+struct dwarf2_info
+  {
+    DSO *dso;
+    GElf_Addr start, adjust;
+    struct
+      {
+	unsigned char *data;
+	size_t size;
+	int sec;
+      } sections[DEBUG_NSECTIONS];
+    uint16_t (*do_read_16) (unsigned char *ptr);
+    uint32_t (*do_read_32) (unsigned char *ptr);
+    uint64_t (*do_read_32_64) (unsigned char *ptr);
+    uint64_t (*do_read_64) (unsigned char *ptr);
+    uint64_t (*do_read_ptr) (unsigned char *ptr);
+    void (*write_32) (unsigned char *ptr, GElf_Addr val);
+    void (*write_64) (unsigned char *ptr, GElf_Addr val);
+    void (*write_ptr) (unsigned char *ptr, GElf_Addr val);
+    int ptr_size;
+    int dwarf5_seen;
+    int lastscn;
+    struct locview_range *locviews;
+    size_t nlocviews, locviews_alloced;
+    htab_t abbrevs;
+    int abbrev_nocache;
   };
 
+/* Adjusts the units in [PTR, END) of debugging section SEC.  */
+typedef int (*dwarf2_unit_fn) (struct dwarf2_info *dw, int sec,
+			       unsigned char *ptr, unsigned char *end);
+
+/* Don't bother with threads for sections smaller than this
+   many bytes per thread.  */
+#define DWARF2_PARALLEL_CHUNK	(1024 * 1024)
+#define DWARF2_MAX_THREADS	16
+
+static int
+dwarf2_addr_to_sec (struct dwarf2_info *dw, GElf_Addr addr)
+{
+  return debug_addr_to_sec (dw->dso, addr, &dw->lastscn);
+}
+
+/* Read the initial length field of a unit at *PTRP, handling the
+   64-bit DWARF escape.  Store the unit's offset size (4 or 8) into
+   *OFFSET_SIZEP, advance *PTRP past the field and return the end of
+   the unit, or NULL if the unit does not fit before ENDSEC.  */
+static unsigned char *
+read_unit_length (struct dwarf2_info *dw, unsigned char **ptrp,
+		  unsigned char *endsec, int *offset_sizep)
+{
+  unsigned char *ptr = *ptrp;
+  uint64_t len;
+
+  if (endsec - ptr < 4)
+    return NULL;
+  len = read_32 (ptr);
+  *offset_sizep = 4;
+  if (len == 0xffffffff)
+    {
+      if (endsec - ptr < 8)
+	return NULL;
+      len = read_64 (ptr);
+      *offset_sizep = 8;
+    }
+  else if (len >= 0xfffffff0)
+    return NULL;
+  if (len > (uint64_t) (endsec - ptr))
+    return NULL;
+  *ptrp = ptr;
+  return ptr + len;
+}
+
 static hashval_t
-abbrev_hash (const void *p)
+abbrev_table_hash (const void *p)
+{
+  struct abbrev_table *a = (struct abbrev_table *)p;
+
+  return a->offset;
+}
+
+static int
+abbrev_table_eq (const void *p, const void *q)
+{
+  struct abbrev_table *a1 = (struct abbrev_table *)p;
+  struct abbrev_table *a2 = (struct abbrev_table *)q;
+
+  return a1->offset == a2->offset;
+}
+
+static void
+abbrev_table_del (void *p)
+{
+  struct abbrev_table *a = (struct abbrev_table *)p;
+  unsigned int i;
+
+  for (i = 0; i < a->ntags; ++i)
+    free (a->tags[i]);
+  free (a->tags);
+  free (a->index);
+  free (a);
+}
+
+static int
+abbrev_tag_cmp (const void *p, const void *q)
 {
-  struct abbrev_tag *t = (struct abbrev_tag *)p;
+  struct abbrev_tag *t1 = *(struct abbrev_tag **)p;
+  struct abbrev_tag *t2 = *(struct abbrev_tag **)q;
 
-  return t->entry;
+  if (t1->entry < t2->entry)
+    return -1;
+  if (t1->entry > t2->entry)
+    return 1;
+  return 0;
 }
 
+/* Return the size of an attribute ATTR with form FORM if
+   adjust_attributes doesn't need to look at it and it has fixed size,
+   otherwise -1.  Offset sized forms are counted in *NOFFSETS
+   instead.  */
 static int
-abbrev_eq (const void *p, const void *q)
+abbrev_attr_skip (unsigned int attr, unsigned int form,
+		  unsigned int *noffsets)
 {
-  struct abbrev_tag *t1 = (struct abbrev_tag *)p;
-  struct abbrev_tag *t2 = (struct abbrev_tag *)q;
+  switch (attr)
+    {
+    case DW_AT_data_member_location:
+    case DW_AT_location:
+    case DW_AT_string_length:
+    case DW_AT_return_addr:
+    case DW_AT_frame_base:
+    case DW_AT_segment:
+    case DW_AT_static_link:
+    case DW_AT_use_location:
+    case DW_AT_vtable_elem_location:
+    case DW_AT_ranges:
+    case DW_AT_GNU_locviews:
+      return -1;
+    }
 
-  return t1->entry == t2->entry;
+  switch (form)
+    {
+    case DW_FORM_flag_present:
+    case DW_FORM_implicit_const:
+      return 0;
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+    case DW_FORM_data1:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+      return 1;
+    case DW_FORM_ref2:
+    case DW_FORM_data2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+      return 2;
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+      return 3;
+    case DW_FORM_ref4:
+    case DW_FORM_data4:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+      return 4;
+    case DW_FORM_ref8:
+    case DW_FORM_data8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+      return 8;
+    case DW_FORM_data16:
+      return 16;
+    case DW_FORM_strp:
+    case DW_FORM_line_strp:
+    case DW_FORM_strp_sup:
+    case DW_FORM_sec_offset:
+    case DW_FORM_GNU_ref_alt:
+    case DW_FORM_GNU_strp_alt:
+      ++*noffsets;
+      return 0;
+    default:
+      return -1;
+    }
 }
 
+/* Compute the skip fields of all attributes of T.  */
 static void
-abbrev_del (void *p)
+abbrev_tag_skips (struct abbrev_tag *t)
 {
-  free (p);
+  unsigned int noffsets;
+  int i, size;
+
+  for (i = t->nattr - 1; i >= 0; --i)
+    {
+      noffsets = 0;
+      size = abbrev_attr_skip (t->attr[i].attr, t->attr[i].form, &noffsets);
+      if (size == -1)
+	{
+	  t->attr[i].nskip = 0;
+	  continue;
+	}
+      t->attr[i].skip = size;
+      t->attr[i].noffsets = noffsets;
+      t->attr[i].nskip = 1;
+      if (i + 1 < t->nattr && t->attr[i + 1].nskip
+	  && t->attr[i + 1].nskip < USHRT_MAX)
+	{
+	  t->attr[i].skip += t->attr[i + 1].skip;
+	  t->attr[i].noffsets += t->attr[i + 1].noffsets;
+	  t->attr[i].nskip += t->attr[i + 1].nskip;
+	}
+    }
 }
 
-static htab_t
+static struct abbrev_table *
 read_abbrev (DSO *dso, unsigned char *ptr)
 {
-  htab_t h = htab_try_create (50, abbrev_hash, abbrev_eq, abbrev_del);
-  unsigned int attr, form;
+  struct abbrev_table *a = calloc (1, sizeof (*a));
+  unsigned int attr, form, max_entry = 0, tags_alloced = 0, i;
   struct abbrev_tag *t;
   int size;
-  void **slot;
 
-  if (h == NULL)
+  if (a == NULL)
     {
 no_memory:
       error (0, ENOMEM, "%s: Could not read .debug_abbrev", dso->filename);
-      if (h)
-	htab_delete (h);
+      if (a)
+	abbrev_table_del (a);
       return NULL;
     }
 
   while ((attr = read_uleb128 (ptr)) != 0)
     {
+      if (a->ntags == tags_alloced)
+	{
+	  struct abbrev_tag **tags;
+
+	  tags_alloced = tags_alloced ? 2 * tags_alloced : 64;
+	  tags = realloc (a->tags, tags_alloced * sizeof (*tags));
+	  if (tags == NULL)
+	    goto no_memory;
+	  a->tags = tags;
+	}
       size = 10;
       t = malloc (sizeof (*t) + size * sizeof (struct abbrev_attr));
       if (t == NULL)
 	goto no_memory;
       t->entry = attr;
       t->nattr = 0;
-      slot = htab_find_slot (h, t, INSERT);
-      if (slot == NULL)
-	{
-	  free (t);
-	  goto no_memory;
-	}
-      if (*slot != NULL)
-	{
-	  error (0, 0, "%s: Duplicate DWARF abbreviation %d", dso->filename,
-		 t->entry);
-	  free (t);
-	  htab_delete (h);
-	  return NULL;
-	}
+      a->tags[a->ntags++] = t;
+      if (attr > max_entry)
+	max_entry = attr;
       t->tag = read_uleb128 (ptr);
       ++ptr; /* skip children flag.  */
       while ((attr = read_uleb128 (ptr)) != 0)
@@ -273,19 +503,26 @@ no_memory:
 	      size += 10;
 	      t = realloc (t, sizeof (*t) + size * sizeof (struct abbrev_attr));
 	      if (t == NULL)
-		goto no_memory;
+		{
+		  --a->ntags;
+		  goto no_memory;
+		}
+	      a->tags[a->ntags - 1] = t;
 	    }
 	  form = read_uleb128 (ptr);
 	  if (form == 2
-	      || (form > DW_FORM_flag_present
-		  && form != DW_FORM_ref_sig8
+	      || (form > DW_FORM_addrx4
+		  && form != DW_FORM_GNU_addr_index
+		  && form != DW_FORM_GNU_str_index
 		  && form != DW_FORM_GNU_ref_alt
 		  && form != DW_FORM_GNU_strp_alt))
 	    {
 	      error (0, 0, "%s: Unknown DWARF DW_FORM_%d", dso->filename, form);
-	      htab_delete (h);
+	      abbrev_table_del (a);
 	      return NULL;
 	    }
+	  if (form == DW_FORM_implicit_const)
+	    read_uleb128 (ptr); /* Skip the constant, it lives here.  */
 
 	  t->attr[t->nattr].attr = attr;
 	  t->attr[t->nattr++].form = form;
@@ -294,19 +531,128 @@ no_memory:
 	{
 	  error (0, 0, "%s: DWARF abbreviation does not end with 2 zeros",
 		 dso->filename);
-	  htab_delete (h);
+	  abbrev_table_del (a);
+	  return NULL;
+	}
+      abbrev_tag_skips (t);
+    }
+
+  /* Producers number abbreviations 1, 2, 3, ..., so a dense index
+     is normally not much bigger than the tags themselves.  */
+  if (max_entry / 4 <= a->ntags + 16)
+    {
+      a->nindex = max_entry + 1;
+      a->index = calloc (a->nindex, sizeof (struct abbrev_tag *));
+      if (a->index == NULL)
+	goto no_memory;
+    }
+
+  for (i = 1; i < a->ntags; ++i)
+    if (a->tags[i - 1]->entry >= a->tags[i]->entry)
+      break;
+  if (i < a->ntags)
+    qsort (a->tags, a->ntags, sizeof (struct abbrev_tag *), abbrev_tag_cmp);
+  for (i = 0; i < a->ntags; ++i)
+    {
+      if (i && a->tags[i - 1]->entry == a->tags[i]->entry)
+	{
+	  error (0, 0, "%s: Duplicate DWARF abbreviation %d", dso->filename,
+		 a->tags[i]->entry);
+	  abbrev_table_del (a);
+	  return NULL;
+	}
+      if (a->index)
+	a->index[a->tags[i]->entry] = a->tags[i];
+    }
+
+  return a;
+}
+
+/* Return the decoded abbreviation table at .debug_abbrev offset
+   OFFSET.  Tables are decoded only once and shared by all units
+   using them, unless DW->abbrev_nocache is set.  */
+static struct abbrev_table *
+find_abbrev_table (struct dwarf2_info *dw, GElf_Addr offset)
+{
+  struct abbrev_table a, *ret;
+  void **slot;
+
+  if (dw->abbrevs == NULL)
+    {
+      dw->abbrevs = htab_try_create (50, abbrev_table_hash, abbrev_table_eq,
+				     abbrev_table_del);
+      if (dw->abbrevs == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could not read .debug_abbrev",
+		 dw->dso->filename);
 	  return NULL;
 	}
-      *slot = t;
     }
 
-  return h;
+  a.offset = offset;
+  slot = htab_find_slot_with_hash (dw->abbrevs, &a, offset, INSERT);
+  if (slot == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not read .debug_abbrev",
+	     dw->dso->filename);
+      return NULL;
+    }
+  if (*slot != NULL)
+    {
+      if (! dw->abbrev_nocache)
+	return (struct abbrev_table *) *slot;
+      /* The previous unit is done with it.  */
+      abbrev_table_del (*slot);
+      *slot = NULL;
+    }
+
+  ret = read_abbrev (dw->dso, dw->sections[DEBUG_ABBREV].data + offset);
+  if (ret == NULL)
+    return NULL;
+  ret->offset = offset;
+  *slot = ret;
+  return ret;
+}
+
+static struct abbrev_tag *
+find_abbrev (struct abbrev_table *a, unsigned int entry)
+{
+  unsigned int l = 0, r = a->ntags, m;
+
+  if (a->index != NULL)
+    return entry < a->nindex ? a->index[entry] : NULL;
+
+  while (l < r)
+    {
+      m = (l + r) / 2;
+      if (a->tags[m]->entry < entry)
+	l = m + 1;
+      else if (a->tags[m]->entry > entry)
+	r = m;
+      else
+	return a->tags[m];
+    }
+  return NULL;
+}
+
+/* Like find_abbrev, but without the index or the binary search.
+   Only used to check those.  */
+static struct abbrev_tag *
+find_abbrev_linear (struct abbrev_table *a, unsigned int entry)
+{
+  unsigned int i;
+
+  for (i = 0; i < a->ntags; ++i)
+    if (a->tags[i]->entry == entry)
+      return a->tags[i];
+  return NULL;
 }
 
 static int
-adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
-		      size_t len, GElf_Addr start, GElf_Addr adjust)
+adjust_location_list (struct dwarf2_info *dw, struct cu_data *cu,
+		      unsigned char *ptr, size_t len, GElf_Addr start, GElf_Addr adjust)
 {
+  DSO *dso = dw->dso;
   unsigned char *end = ptr + len;
   unsigned char op;
   GElf_Addr addr;
@@ -318,8 +664,8 @@ adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 	{
 	case DW_OP_addr:
 	  addr = read_ptr (ptr);
-	  if (addr >= start && addr_to_sec (dso, addr) != -1)
-	    write_ptr (ptr - ptr_size, addr + adjust);
+	  if (addr >= start && dwarf2_addr_to_sec (dw, addr) != -1)
+	    dw->write_ptr (ptr - dw->ptr_size, addr + adjust);
 	  break;
 	case DW_OP_deref:
 	case DW_OP_dup:
@@ -386,9 +732,18 @@ adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 	      return 1;
 	    }
 	  if (cu->cu_version == 2)
-	    ptr += ptr_size;
+	    ptr += dw->ptr_size;
 	  else
-	    ptr += 4;
+	    ptr += cu->cu_offset_size;
+	  break;
+	case DW_OP_GNU_variable_value:
+	  if (cu == NULL)
+	    {
+	      error (0, 0, "%s: DWARF DW_OP_GNU_variable_value shouldn't"
+		     " appear in .debug_frame", dso->filename);
+	      return 1;
+	    }
+	  ptr += cu->cu_offset_size;
 	  break;
 	case DW_OP_const8u:
 	case DW_OP_const8s:
@@ -401,12 +756,19 @@ adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 	case DW_OP_consts:
 	case DW_OP_breg0 ... DW_OP_breg31:
 	case DW_OP_fbreg:
+	case DW_OP_addrx:
+	case DW_OP_constx:
+	case DW_OP_convert:
+	case DW_OP_reinterpret:
 	case DW_OP_GNU_convert:
 	case DW_OP_GNU_reinterpret:
+	case DW_OP_GNU_addr_index:
+	case DW_OP_GNU_const_index:
 	  read_uleb128 (ptr);
 	  break;
 	case DW_OP_bregx:
 	case DW_OP_bit_piece:
+	case DW_OP_regval_type:
 	case DW_OP_GNU_regval_type:
 	  read_uleb128 (ptr);
 	  read_uleb128 (ptr);
@@ -417,37 +779,42 @@ adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 	    ptr += leni;
 	  }
 	  break;
+	case DW_OP_implicit_pointer:
 	case DW_OP_GNU_implicit_pointer:
 	  if (cu == NULL)
 	    {
-	      error (0, 0, "%s: DWARF DW_OP_GNU_implicit_pointer shouldn't"
+	      error (0, 0, "%s: DWARF DW_OP_implicit_pointer shouldn't"
 		     " appear in .debug_frame", dso->filename);
 	      return 1;
 	    }
 	  if (cu->cu_version == 2)
-	    ptr += ptr_size;
+	    ptr += dw->ptr_size;
 	  else
-	    ptr += 4;
+	    ptr += cu->cu_offset_size;
 	  read_uleb128 (ptr);
 	  break;
+	case DW_OP_entry_value:
         case DW_OP_GNU_entry_value:
 	  {
 	    uint32_t leni = read_uleb128 (ptr);
 	    if ((end - ptr) < leni)
 	      {
-		error (0, 0, "%s: DWARF DW_OP_GNU_entry_value with too large"
+		error (0, 0, "%s: DWARF DW_OP_entry_value with too large"
 		       " length", dso->filename);
 		return 1;
 	      }
-	    if (adjust_location_list (dso, cu, ptr, leni, start, adjust))
+	    if (adjust_location_list (dw, cu, ptr, leni, start, adjust))
 	      return 1;
 	    ptr += leni;
 	  }
 	  break;
+	case DW_OP_const_type:
         case DW_OP_GNU_const_type:
 	  read_uleb128 (ptr);
 	  ptr += *ptr + 1;
 	  break;
+	case DW_OP_deref_type:
+	case DW_OP_xderef_type:
 	case DW_OP_GNU_deref_type:
 	  ++ptr;
 	  read_uleb128 (ptr);
@@ -461,30 +828,32 @@ adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 }
 
 static int
-adjust_dwarf2_ranges (DSO *dso, GElf_Addr offset, GElf_Addr base,
+adjust_dwarf2_ranges (struct dwarf2_info *dw, GElf_Addr offset, GElf_Addr base,
 		      GElf_Addr start, GElf_Addr adjust)
 {
+  DSO *dso = dw->dso;
   unsigned char *ptr, *endsec;
   GElf_Addr low, high;
   int adjusted_base;
 
-  ptr = debug_sections[DEBUG_RANGES].data;
+  ptr = dw->sections[DEBUG_RANGES].data;
   if (ptr == NULL)
     {
       error (0, 0, "%s: DW_AT_ranges attribute, yet no .debug_ranges section",
 	     dso->filename);
       return 1;
     }
-  if (offset >= debug_sections[DEBUG_RANGES].size)
+  if (offset >= dw->sections[DEBUG_RANGES].size)
     {
       error (0, 0,
 	     "%s: DW_AT_ranges offset %Ld outside of .debug_ranges section",
 	     dso->filename, (long long) offset);
       return 1;
     }
-  endsec = ptr + debug_sections[DEBUG_RANGES].size;
+  endsec = ptr + dw->sections[DEBUG_RANGES].size;
   ptr += offset;
-  adjusted_base = (base && base >= start && addr_to_sec (dso, base) != -1);
+  adjusted_base = (base && base >= start
+		   && dwarf2_addr_to_sec (dw, base) != -1);
   while (ptr < endsec)
     {
       low = read_ptr (ptr);
@@ -492,59 +861,59 @@ adjust_dwarf2_ranges (DSO *dso, GElf_Addr offset, GElf_Addr base,
       if (low == 0 && high == 0)
 	break;
 
-      if (low == ~ (GElf_Addr) 0 || (ptr_size == 4 && low == 0xffffffff))
+      if (low == ~ (GElf_Addr) 0 || (dw->ptr_size == 4 && low == 0xffffffff))
 	{
 	  base = high;
 	  adjusted_base = (base && base >= start
-			   && addr_to_sec (dso, base) != -1);
+			   && dwarf2_addr_to_sec (dw, base) != -1);
 	  if (adjusted_base)
-	    write_ptr (ptr - ptr_size, base + adjust);
+	    dw->write_ptr (ptr - dw->ptr_size, base + adjust);
 	}
       else if (! adjusted_base)
 	{
-	  if (base + low >= start && addr_to_sec (dso, base + low) != -1)
+	  if (base + low >= start && dwarf2_addr_to_sec (dw, base + low) != -1)
 	    {
-	      write_ptr (ptr - 2 * ptr_size, low + adjust);
+	      dw->write_ptr (ptr - 2 * dw->ptr_size, low + adjust);
 	      if (high == low)
-		write_ptr (ptr - ptr_size, high + adjust);
+		dw->write_ptr (ptr - dw->ptr_size, high + adjust);
 	    }
 	  if (low != high && base + high >= start
-	      && addr_to_sec (dso, base + high - 1) != -1)
-	    write_ptr (ptr - ptr_size, high + adjust);
+	      && dwarf2_addr_to_sec (dw, base + high - 1) != -1)
+	    dw->write_ptr (ptr - dw->ptr_size, high + adjust);
 	}
     }
 
-  elf_flagscn (dso->scn[debug_sections[DEBUG_RANGES].sec], ELF_C_SET,
-	       ELF_F_DIRTY);
   return 0;
 }
 
 static int
-adjust_dwarf2_loc (DSO *dso, struct cu_data *cu, GElf_Addr offset,
-		   GElf_Addr base, GElf_Addr start, GElf_Addr adjust)
+adjust_dwarf2_loc (struct dwarf2_info *dw, struct cu_data *cu,
+		   GElf_Addr offset, GElf_Addr base, GElf_Addr start, GElf_Addr adjust)
 {
+  DSO *dso = dw->dso;
   unsigned char *ptr, *endsec;
   GElf_Addr low, high;
   int adjusted_base;
   size_t len;
 
-  ptr = debug_sections[DEBUG_LOC].data;
+  ptr = dw->sections[DEBUG_LOC].data;
   if (ptr == NULL)
     {
       error (0, 0, "%s: loclistptr attribute, yet no .debug_loc section",
 	     dso->filename);
       return 1;
     }
-  if (offset >= debug_sections[DEBUG_LOC].size)
+  if (offset >= dw->sections[DEBUG_LOC].size)
     {
       error (0, 0,
 	     "%s: loclistptr offset %Ld outside of .debug_loc section",
 	     dso->filename, (long long) offset);
       return 1;
     }
-  endsec = ptr + debug_sections[DEBUG_LOC].size;
+  endsec = ptr + dw->sections[DEBUG_LOC].size;
   ptr += offset;
-  adjusted_base = (base && base >= start && addr_to_sec (dso, base) != -1);
+  adjusted_base = (base && base >= start
+		   && dwarf2_addr_to_sec (dw, base) != -1);
   while (ptr < endsec)
     {
       low = read_ptr (ptr);
@@ -552,42 +921,86 @@ adjust_dwarf2_loc (DSO *dso, struct cu_data *cu, GElf_Addr offset,
       if (low == 0 && high == 0)
 	break;
 
-      if (low == ~ (GElf_Addr) 0 || (ptr_size == 4 && low == 0xffffffff))
+      if (low == ~ (GElf_Addr) 0 || (dw->ptr_size == 4 && low == 0xffffffff))
 	{
 	  base = high;
 	  adjusted_base = (base && base >= start
-			   && addr_to_sec (dso, base) != -1);
+			   && dwarf2_addr_to_sec (dw, base) != -1);
 	  if (adjusted_base)
-	    write_ptr (ptr - ptr_size, base + adjust);
+	    dw->write_ptr (ptr - dw->ptr_size, base + adjust);
 	  continue;
 	}
       len = read_16 (ptr);
       assert (ptr + len <= endsec);
 
-      if (adjust_location_list (dso, cu, ptr, len, start, adjust))
+      if (adjust_location_list (dw, cu, ptr, len, start, adjust))
 	return 1;
 
       ptr += len;
     }
 
-  elf_flagscn (dso->scn[debug_sections[DEBUG_LOC].sec], ELF_C_SET,
-	       ELF_F_DIRTY);
+  return 0;
+}
+
+static int
+locview_range_cmp (const void *p, const void *q)
+{
+  const struct locview_range *a = (const struct locview_range *) p;
+  const struct locview_range *b = (const struct locview_range *) q;
+
+  if (a->start < b->start)
+    return -1;
+  if (a->start > b->start)
+    return 1;
+  return 0;
+}
+
+static int
+add_locview_range (struct dwarf2_info *dw, GElf_Addr start, GElf_Addr end)
+{
+  DSO *dso = dw->dso;
+  if (dw->nlocviews == dw->locviews_alloced)
+    {
+      struct locview_range *n;
+      size_t alloced = dw->locviews_alloced ? 2 * dw->locviews_alloced : 64;
+
+      n = realloc (dw->locviews, alloced * sizeof (struct locview_range));
+      if (n == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could not record DWARF location views",
+		 dso->filename);
+	  return 1;
+	}
+      dw->locviews = n;
+      dw->locviews_alloced = alloced;
+    }
+  dw->locviews[dw->nlocviews].start = start;
+  dw->locviews[dw->nlocviews++].end = end;
   return 0;
 }
 
 static unsigned char *
-adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
-		   struct cu_data *cu,
+adjust_attributes (struct dwarf2_info *dw, unsigned char *ptr,
+		   struct abbrev_tag *t, struct cu_data *cu,
 		   GElf_Addr start, GElf_Addr adjust)
 {
+  DSO *dso = dw->dso;
   int i;
   GElf_Addr addr;
+  GElf_Addr locview = ~ (GElf_Addr) 0, loclist = ~ (GElf_Addr) 0;
 
   for (i = 0; i < t->nattr; ++i)
     {
       uint32_t form = t->attr[i].form;
       uint32_t len = 0;
 
+      if (t->attr[i].nskip)
+	{
+	  ptr += t->attr[i].skip + t->attr[i].noffsets * cu->cu_offset_size;
+	  i += t->attr[i].nskip - 1;
+	  continue;
+	}
+
       while (1)
 	{
 	  switch (t->attr[i].attr)
@@ -608,9 +1021,20 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 	    case DW_AT_use_location:
 	    case DW_AT_vtable_elem_location:
 	    case DW_AT_ranges:
-	      if (form == DW_FORM_data4 || form == DW_FORM_sec_offset)
+	      /* DWARF5 .debug_loclists and .debug_rnglists are
+		 adjusted as a whole, not through references.  */
+	      if (cu->cu_version >= 5)
+		{
+		  if (form == DW_FORM_sec_offset
+		      && t->attr[i].attr != DW_AT_ranges)
+		    loclist = cu->cu_offset_size == 8
+			      ? dw->do_read_64 (ptr) : dw->do_read_32 (ptr);
+		  break;
+		}
+	      if (form == DW_FORM_data4
+		  || (form == DW_FORM_sec_offset && cu->cu_offset_size == 4))
 		addr = read_32 (ptr), ptr -= 4;
-	      else if (form == DW_FORM_data8)
+	      else if (form == DW_FORM_data8 || form == DW_FORM_sec_offset)
 		addr = read_64 (ptr), ptr -= 8;
 	      else
 		break;
@@ -625,16 +1049,21 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 		  base = 0;
 		if (t->attr[i].attr == DW_AT_ranges)
 		  {
-		    if (adjust_dwarf2_ranges (dso, addr, base, start, adjust))
+		    if (adjust_dwarf2_ranges (dw, addr, base, start, adjust))
 		      return NULL;
 		  }
 		else
 		  {
-		    if (adjust_dwarf2_loc (dso, cu, addr, base, start, adjust))
+		    if (adjust_dwarf2_loc (dw, cu, addr, base, start, adjust))
 		      return NULL;
 		  }
 	      }
 	      break;
+	    case DW_AT_GNU_locviews:
+	      if (cu->cu_version >= 5 && form == DW_FORM_sec_offset)
+		locview = cu->cu_offset_size == 8
+			  ? dw->do_read_64 (ptr) : dw->do_read_32 (ptr);
+	      break;
 	    }
 	  switch (form)
 	    {
@@ -650,45 +1079,69 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 		  if (addr == 0)
 		    break;
 		}
-	      if (addr >= start && addr_to_sec (dso, addr) != -1)
-		write_ptr (ptr - ptr_size, addr + adjust);
+	      if (addr >= start && dwarf2_addr_to_sec (dw, addr) != -1)
+		dw->write_ptr (ptr - dw->ptr_size, addr + adjust);
 	      break;
 	    case DW_FORM_flag_present:
+	    case DW_FORM_implicit_const:
 	      break;
 	    case DW_FORM_ref1:
 	    case DW_FORM_flag:
 	    case DW_FORM_data1:
+	    case DW_FORM_strx1:
+	    case DW_FORM_addrx1:
 	      ++ptr;
 	      break;
 	    case DW_FORM_ref2:
 	    case DW_FORM_data2:
+	    case DW_FORM_strx2:
+	    case DW_FORM_addrx2:
 	      ptr += 2;
 	      break;
+	    case DW_FORM_strx3:
+	    case DW_FORM_addrx3:
+	      ptr += 3;
+	      break;
 	    case DW_FORM_ref4:
-	    case DW_FORM_GNU_ref_alt:
 	    case DW_FORM_data4:
-	    case DW_FORM_sec_offset:
+	    case DW_FORM_ref_sup4:
+	    case DW_FORM_strx4:
+	    case DW_FORM_addrx4:
 	      ptr += 4;
 	      break;
 	    case DW_FORM_ref8:
 	    case DW_FORM_data8:
 	    case DW_FORM_ref_sig8:
+	    case DW_FORM_ref_sup8:
 	      ptr += 8;
 	      break;
+	    case DW_FORM_data16:
+	      ptr += 16;
+	      break;
 	    case DW_FORM_sdata:
 	    case DW_FORM_ref_udata:
 	    case DW_FORM_udata:
+	    case DW_FORM_strx:
+	    case DW_FORM_addrx:
+	    case DW_FORM_loclistx:
+	    case DW_FORM_rnglistx:
+	    case DW_FORM_GNU_addr_index:
+	    case DW_FORM_GNU_str_index:
 	      read_uleb128 (ptr);
 	      break;
 	    case DW_FORM_ref_addr:
 	      if (cu->cu_version == 2)
-		ptr += ptr_size;
+		ptr += dw->ptr_size;
 	      else
-		ptr += 4;
+		ptr += cu->cu_offset_size;
 	      break;
 	    case DW_FORM_strp:
+	    case DW_FORM_line_strp:
+	    case DW_FORM_strp_sup:
+	    case DW_FORM_sec_offset:
+	    case DW_FORM_GNU_ref_alt:
 	    case DW_FORM_GNU_strp_alt:
-	      ptr += 4;
+	      ptr += cu->cu_offset_size;
 	      break;
 	    case DW_FORM_string:
 	      ptr = strchr (ptr, '\0') + 1;
@@ -750,11 +1203,16 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 		case DW_AT_GNU_call_site_data_value:
 		case DW_AT_GNU_call_site_target:
 		case DW_AT_GNU_call_site_target_clobbered:
-		  if (adjust_location_list (dso, cu, ptr, len, start, adjust))
+		case DW_AT_call_value:
+		case DW_AT_call_data_value:
+		case DW_AT_call_data_location:
+		case DW_AT_call_target:
+		case DW_AT_call_target_clobbered:
+		  if (adjust_location_list (dw, cu, ptr, len, start, adjust))
 		    return NULL;
 		  break;
 		default:
-		  if (t->attr[i].attr <= DW_AT_linkage_name
+		  if (t->attr[i].attr <= DW_AT_loclists_base
 		      || (t->attr[i].attr >= DW_AT_MIPS_fde
 			  && t->attr[i].attr <= DW_AT_MIPS_has_inlines)
 		      || (t->attr[i].attr >= DW_AT_sf_names
@@ -768,7 +1226,7 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 	    }
 	  else if (form == DW_FORM_exprloc)
 	    {
-	      if (adjust_location_list (dso, cu, ptr, len, start, adjust))
+	      if (adjust_location_list (dw, cu, ptr, len, start, adjust))
 		return NULL;
 	      ptr += len;
 	    }
@@ -777,31 +1235,30 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 	}
     }
 
+  if (locview < loclist && loclist != ~ (GElf_Addr) 0
+      && add_locview_range (dw, locview, loclist))
+    return NULL;
+
   return ptr;
 }
 
 static int
-adjust_dwarf2_line (DSO *dso, GElf_Addr start, GElf_Addr adjust)
+adjust_dwarf2_line (struct dwarf2_info *dw, int sec, unsigned char *ptr,
+		    unsigned char *endsec)
 {
-  unsigned char *ptr = debug_sections[DEBUG_LINE].data;
-  unsigned char *endsec = ptr + debug_sections[DEBUG_LINE].size;
+  DSO *dso = dw->dso;
+  GElf_Addr start = dw->start, adjust = dw->adjust;
   unsigned char *endcu, *endprol;
   unsigned char opcode_base, *opcode_lengths, op;
   uint32_t value;
+  uint64_t len;
   GElf_Addr addr;
-  int i;
+  int i, offset_size;
 
   while (ptr < endsec)
     {
-      endcu = ptr + 4;
-      endcu += read_32 (ptr);
-      if (endcu == ptr + 0xffffffff)
-	{
-	  error (0, 0, "%s: 64-bit DWARF not supported", dso->filename);
-	  return 1;
-	}
-
-      if (endcu > endsec)
+      endcu = read_unit_length (dw, &ptr, endsec, &offset_size);
+      if (endcu == NULL)
 	{
 	  error (0, 0, "%s: .debug_line CU does not fit into section",
 		 dso->filename);
@@ -809,16 +1266,27 @@ adjust_dwarf2_line (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	}
 
       value = read_16 (ptr);
-      if (value != 2 && value != 3 && value != 4)
+      if (value < 2 || value > 5)
 	{
 	  error (0, 0, "%s: DWARF version %d unhandled", dso->filename,
 		 value);
 	  return 1;
 	}
 
-      endprol = ptr + 4;
-      endprol += read_32 (ptr);
-      if (endprol > endcu)
+      if (value >= 5)
+	{
+	  if (ptr[0] != dw->ptr_size || ptr[1])
+	    {
+	      error (0, 0, "%s: Unsupported .debug_line address size %d or segment selector size %d",
+		     dso->filename, ptr[0], ptr[1]);
+	      return 1;
+	    }
+	  ptr += 2;
+	}
+
+      len = read_offset (ptr, offset_size);
+      endprol = ptr + len;
+      if (len > (uint64_t) (endcu - ptr))
 	{
 	  error (0, 0, "%s: .debug_line CU prologue does not fit into CU",
 		 dso->filename);
@@ -844,8 +1312,8 @@ adjust_dwarf2_line (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 		{
 		case DW_LNE_set_address:
 		  addr = read_ptr (ptr);
-		  if (addr >= start && addr_to_sec (dso, addr) != -1)
-		    write_ptr (ptr - ptr_size, addr + adjust);
+		  if (addr >= start && dwarf2_addr_to_sec (dw, addr) != -1)
+		    dw->write_ptr (ptr - dw->ptr_size, addr + adjust);
 		  break;
 		case DW_LNE_end_sequence:
 		case DW_LNE_define_file:
@@ -863,33 +1331,27 @@ adjust_dwarf2_line (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	}
     }
 
-  elf_flagscn (dso->scn[debug_sections[DEBUG_LINE].sec], ELF_C_SET,
-	       ELF_F_DIRTY);
   return 0;
 }
 
 static int
-adjust_dwarf2_aranges (DSO *dso, GElf_Addr start, GElf_Addr adjust)
+adjust_dwarf2_aranges (struct dwarf2_info *dw, int sec, unsigned char *ptr,
+		       unsigned char *endsec)
 {
-  unsigned char *ptr = debug_sections[DEBUG_ARANGES].data;
-  unsigned char *endsec = ptr + debug_sections[DEBUG_ARANGES].size;
-  unsigned char *endcu;
+  DSO *dso = dw->dso;
+  GElf_Addr start = dw->start, adjust = dw->adjust;
+  unsigned char *unit, *endcu;
   GElf_Addr addr, len;
   uint32_t value;
+  int offset_size;
 
   while (ptr < endsec)
     {
-      endcu = ptr + 4;
-      endcu += read_32 (ptr);
-      if (endcu == ptr + 0xffffffff)
-	{
-	  error (0, 0, "%s: 64-bit DWARF not supported", dso->filename);
-	  return 1;
-	}
-
-      if (endcu > endsec)
+      unit = ptr;
+      endcu = read_unit_length (dw, &ptr, endsec, &offset_size);
+      if (endcu == NULL)
 	{
-	  error (0, 0, "%s: .debug_line CU does not fit into section",
+	  error (0, 0, "%s: .debug_aranges CU does not fit into section",
 		 dso->filename);
 	  return 1;
 	}
@@ -902,60 +1364,55 @@ adjust_dwarf2_aranges (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	  return 1;
 	}
 
-      ptr += 4;
-      if (ptr[0] != ptr_size || ptr[1])
+      ptr += offset_size;
+      if (ptr[0] != dw->ptr_size || ptr[1])
 	{
 	  error (0, 0, "%s: Unsupported .debug_aranges address size %d or segment size %d",
 		 dso->filename, ptr[0], ptr[1]);
 	  return 1;
 	}
 
-      ptr += 6;
+      /* The tuples are aligned to twice the address size.  */
+      ptr += 2;
+      ptr += -(ptr - unit) & (2 * dw->ptr_size - 1);
       while (ptr < endcu)
 	{
 	  addr = read_ptr (ptr);
 	  len = read_ptr (ptr);
 	  if (addr == 0 && len == 0)
 	    break;
-	  if (addr >= start && addr_to_sec (dso, addr) != -1)
-	    write_ptr (ptr - 2 * ptr_size, addr + adjust);
+	  if (addr >= start && dwarf2_addr_to_sec (dw, addr) != -1)
+	    dw->write_ptr (ptr - 2 * dw->ptr_size, addr + adjust);
 	}
       assert (ptr == endcu);
     }
 
-  elf_flagscn (dso->scn[debug_sections[DEBUG_LINE].sec], ELF_C_SET,
-	       ELF_F_DIRTY);
   return 0;
 }
 
 static int
-adjust_dwarf2_frame (DSO *dso, GElf_Addr start, GElf_Addr adjust)
+adjust_dwarf2_frame (struct dwarf2_info *dw, int sec, unsigned char *ptr,
+		     unsigned char *endsec)
 {
-  unsigned char *ptr = debug_sections[DEBUG_FRAME].data;
-  unsigned char *endsec = ptr + debug_sections[DEBUG_FRAME].size;
+  DSO *dso = dw->dso;
+  GElf_Addr start = dw->start, adjust = dw->adjust;
   unsigned char *endie;
   GElf_Addr addr, len;
-  uint32_t value;
+  uint64_t value;
+  int offset_size;
 
   while (ptr < endsec)
     {
-      endie = ptr + 4;
-      endie += read_32 (ptr);
-      if (endie == ptr + 0xffffffff)
-	{
-	  error (0, 0, "%s: 64-bit DWARF not supported", dso->filename);
-	  return 1;
-	}
-
-      if (endie > endsec)
+      endie = read_unit_length (dw, &ptr, endsec, &offset_size);
+      if (endie == NULL)
 	{
 	  error (0, 0, "%s: .debug_frame CIE/FDE does not fit into section",
 		 dso->filename);
 	  return 1;
 	}
 
-      value = read_32 (ptr);
-      if (value == 0xffffffff)
+      value = read_offset (ptr, offset_size);
+      if (value == (offset_size == 8 ? ~ (uint64_t) 0 : 0xffffffff))
 	{
 	  /* CIE.  */
 	  uint32_t version = *ptr++;
@@ -974,7 +1431,7 @@ adjust_dwarf2_frame (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	  ptr++;  /* Skip augmentation.  */
 	  if (version >= 4)
 	    {
-	      if (ptr[0] != ptr_size)
+	      if (ptr[0] != dw->ptr_size)
 		{
 		  error (0, 0, "%s: .debug_frame unhandled pointer size %d",
 			  dso->filename, ptr[0]);
@@ -998,8 +1455,8 @@ adjust_dwarf2_frame (DSO *dso, GElf_Addr start, GElf_Addr adjust)
       else
 	{
 	  addr = read_ptr (ptr);
-	  if (addr >= start && addr_to_sec (dso, addr) != -1)
-	    write_ptr (ptr - ptr_size, addr + adjust);
+	  if (addr >= start && dwarf2_addr_to_sec (dw, addr) != -1)
+	    dw->write_ptr (ptr - dw->ptr_size, addr + adjust);
 	  read_ptr (ptr);  /* Skip address range.  */
 	}
 
@@ -1043,8 +1500,8 @@ adjust_dwarf2_frame (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	      break;
 	    case DW_CFA_set_loc:
 	      addr = read_ptr (ptr);
-	      if (addr >= start && addr_to_sec (dso, addr) != -1)
-		write_ptr (ptr - ptr_size, addr + adjust);
+	      if (addr >= start && dwarf2_addr_to_sec (dw, addr) != -1)
+		dw->write_ptr (ptr - dw->ptr_size, addr + adjust);
 	      break;
 	    case DW_CFA_advance_loc1:
 	      ptr++;
@@ -1061,7 +1518,7 @@ adjust_dwarf2_frame (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	      /* FALLTHROUGH */
 	    case DW_CFA_def_cfa_expression:
 	      len = read_uleb128 (ptr);
-	      if (adjust_location_list (dso, NULL, ptr, len, start, adjust))
+	      if (adjust_location_list (dw, NULL, ptr, len, start, adjust))
 		return 1;
 	      ptr += len;
 	      break;
@@ -1073,57 +1530,381 @@ adjust_dwarf2_frame (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	}
     }
 
-  elf_flagscn (dso->scn[debug_sections[DEBUG_FRAME].sec], ELF_C_SET,
-	       ELF_F_DIRTY);
   return 0;
 }
 
-static int
-adjust_dwarf2_info (DSO *dso, GElf_Addr start, GElf_Addr adjust, int type)
+/* Read the header shared by DWARF5 .debug_addr, .debug_rnglists and
+   .debug_loclists units.  Return the end of the unit, or NULL on
+   error.  */
+static unsigned char *
+read_dwarf5_list_header (struct dwarf2_info *dw, int sec, unsigned char **ptrp,
+			 unsigned char *endsec, int *offset_sizep)
 {
-  unsigned char *ptr, *endcu, *endsec;
+  DSO *dso = dw->dso;
+  unsigned char *ptr = *ptrp, *endcu;
   uint32_t value;
-  htab_t abbrev;
-  struct abbrev_tag tag, *t;
+
+  endcu = read_unit_length (dw, &ptr, endsec, offset_sizep);
+  if (endcu == NULL || endcu - ptr < 4)
+    {
+      error (0, 0, "%s: %s unit does not fit into section",
+	     dso->filename, debug_section_names[sec]);
+      return NULL;
+    }
+
+  value = read_16 (ptr);
+  if (value != 5)
+    {
+      error (0, 0, "%s: %s version %d unhandled", dso->filename,
+	     debug_section_names[sec], value);
+      return NULL;
+    }
+
+  if (ptr[0] != dw->ptr_size || ptr[1])
+    {
+      error (0, 0, "%s: Unsupported %s address size %d or segment selector size %d",
+	     dso->filename, debug_section_names[sec], ptr[0], ptr[1]);
+      return NULL;
+    }
+
+  *ptrp = ptr + 2;
+  return endcu;
+}
+
+/* Skip the offset table after a .debug_rnglists or .debug_loclists
+   unit header.  */
+static unsigned char *
+skip_dwarf5_offset_table (struct dwarf2_info *dw, int sec, unsigned char *ptr,
+			  unsigned char *endcu, int offset_size)
+{
+  DSO *dso = dw->dso;
+  uint32_t count;
+
+  if (endcu - ptr < 4)
+    count = UINT_MAX;
+  else
+    count = read_32 (ptr);
+  if (count > (endcu - ptr) / offset_size)
+    {
+      error (0, 0, "%s: %s offset table does not fit into unit",
+	     dso->filename, debug_section_names[sec]);
+      return NULL;
+    }
+  return ptr + count * offset_size;
+}
+
+static int
+adjust_dwarf2_addr (struct dwarf2_info *dw, int sec, unsigned char *ptr,
+		    unsigned char *endsec)
+{
+  GElf_Addr start = dw->start, adjust = dw->adjust;
+  unsigned char *endcu;
+  GElf_Addr addr;
+  int offset_size;
+
+  while (ptr < endsec)
+    {
+      /* The pre-DWARF5 GNU split DWARF .debug_addr is just an array
+	 of addresses without any unit headers.  */
+      if (! dw->dwarf5_seen)
+	endcu = endsec;
+      else
+	{
+	  endcu = read_dwarf5_list_header (dw, DEBUG_ADDR, &ptr, endsec,
+					   &offset_size);
+	  if (endcu == NULL)
+	    return 1;
+	}
+
+      while (endcu - ptr >= dw->ptr_size)
+	{
+	  addr = read_ptr (ptr);
+	  if (addr >= start && dwarf2_addr_to_sec (dw, addr) != -1)
+	    dw->write_ptr (ptr - dw->ptr_size, addr + adjust);
+	}
+      ptr = endcu;
+    }
+
+  return 0;
+}
+
+static int
+adjust_dwarf2_rnglists (struct dwarf2_info *dw, int sec, unsigned char *ptr,
+			unsigned char *endsec)
+{
+  DSO *dso = dw->dso;
+  GElf_Addr start = dw->start, adjust = dw->adjust;
+  unsigned char *endcu, op;
+  GElf_Addr low, high;
+  int offset_size;
+
+  while (ptr < endsec)
+    {
+      endcu = read_dwarf5_list_header (dw, DEBUG_RNGLISTS, &ptr, endsec,
+				       &offset_size);
+      if (endcu == NULL)
+	return 1;
+      ptr = skip_dwarf5_offset_table (dw, DEBUG_RNGLISTS, ptr, endcu,
+				      offset_size);
+      if (ptr == NULL)
+	return 1;
+
+      /* Walk all range list entries in the unit.  Only the ones with
+	 absolute addresses need adjusting, DW_RLE_offset_pair is
+	 relative to the base address and the *x forms index into
+	 .debug_addr.  */
+      while (ptr < endcu)
+	{
+	  op = *ptr++;
+	  switch (op)
+	    {
+	    case DW_RLE_end_of_list:
+	      break;
+	    case DW_RLE_base_addressx:
+	      read_uleb128 (ptr);
+	      break;
+	    case DW_RLE_startx_endx:
+	    case DW_RLE_startx_length:
+	    case DW_RLE_offset_pair:
+	      read_uleb128 (ptr);
+	      read_uleb128 (ptr);
+	      break;
+	    case DW_RLE_base_address:
+	      low = read_ptr (ptr);
+	      if (low >= start && dwarf2_addr_to_sec (dw, low) != -1)
+		dw->write_ptr (ptr - dw->ptr_size, low + adjust);
+	      break;
+	    case DW_RLE_start_end:
+	      low = read_ptr (ptr);
+	      high = read_ptr (ptr);
+	      if (low >= start && dwarf2_addr_to_sec (dw, low) != -1)
+		{
+		  dw->write_ptr (ptr - 2 * dw->ptr_size, low + adjust);
+		  if (high == low)
+		    dw->write_ptr (ptr - dw->ptr_size, high + adjust);
+		}
+	      if (low != high && high >= start
+		  && dwarf2_addr_to_sec (dw, high - 1) != -1)
+		dw->write_ptr (ptr - dw->ptr_size, high + adjust);
+	      break;
+	    case DW_RLE_start_length:
+	      low = read_ptr (ptr);
+	      if (low >= start && dwarf2_addr_to_sec (dw, low) != -1)
+		dw->write_ptr (ptr - dw->ptr_size, low + adjust);
+	      read_uleb128 (ptr);
+	      break;
+	    default:
+	      error (0, 0, "%s: Unknown DWARF DW_RLE_%d", dso->filename, op);
+	      return 1;
+	    }
+	}
+      if (ptr != endcu)
+	{
+	  error (0, 0, "%s: .debug_rnglists entry does not fit into unit",
+		 dso->filename);
+	  return 1;
+	}
+    }
+
+  return 0;
+}
+
+static int
+adjust_dwarf2_loclists (struct dwarf2_info *dw, int sec, unsigned char *ptr,
+			unsigned char *endsec)
+{
+  DSO *dso = dw->dso;
+  GElf_Addr start = dw->start, adjust = dw->adjust;
+  unsigned char *data = dw->sections[DEBUG_LOCLISTS].data;
+  unsigned char *endcu, op;
+  GElf_Addr low, high;
+  int offset_size;
+  uint32_t len;
+  size_t view = 0;
   struct cu_data cu;
 
-  memset (&cu, 0, sizeof(cu));
-  ptr = debug_sections[type].data;
-  endsec = ptr + debug_sections[type].size;
+  memset (&cu, 0, sizeof (cu));
+  cu.cu_version = 5;
   while (ptr < endsec)
     {
-      if (ptr + 11 > endsec)
+      endcu = read_dwarf5_list_header (dw, DEBUG_LOCLISTS, &ptr, endsec,
+				       &offset_size);
+      if (endcu == NULL)
+	return 1;
+      ptr = skip_dwarf5_offset_table (dw, DEBUG_LOCLISTS, ptr, endcu,
+				      offset_size);
+      if (ptr == NULL)
+	return 1;
+      cu.cu_offset_size = offset_size;
+
+      while (ptr < endcu)
 	{
-	  error (0, 0, "%s: .debug_info CU header too small", dso->filename);
+	  while (view < dw->nlocviews && dw->locviews[view].start < ptr - data)
+	    ++view;
+	  if (view < dw->nlocviews && dw->locviews[view].start == ptr - data)
+	    {
+	      if (dw->locviews[view].end > endcu - data)
+		{
+		  error (0, 0, "%s: .debug_loclists location view list does not fit into unit",
+			 dso->filename);
+		  return 1;
+		}
+	      ptr = data + dw->locviews[view].end;
+	      continue;
+	    }
+
+	  op = *ptr++;
+	  switch (op)
+	    {
+	    case DW_LLE_end_of_list:
+	      continue;
+	    case DW_LLE_base_addressx:
+	      read_uleb128 (ptr);
+	      continue;
+	    case DW_LLE_GNU_view_pair:
+	      read_uleb128 (ptr);
+	      read_uleb128 (ptr);
+	      continue;
+	    case DW_LLE_base_address:
+	      low = read_ptr (ptr);
+	      if (low >= start && dwarf2_addr_to_sec (dw, low) != -1)
+		dw->write_ptr (ptr - dw->ptr_size, low + adjust);
+	      continue;
+	    case DW_LLE_startx_endx:
+	    case DW_LLE_startx_length:
+	    case DW_LLE_offset_pair:
+	      read_uleb128 (ptr);
+	      read_uleb128 (ptr);
+	      break;
+	    case DW_LLE_default_location:
+	      break;
+	    case DW_LLE_start_end:
+	      low = read_ptr (ptr);
+	      high = read_ptr (ptr);
+	      if (low >= start && dwarf2_addr_to_sec (dw, low) != -1)
+		{
+		  dw->write_ptr (ptr - 2 * dw->ptr_size, low + adjust);
+		  if (high == low)
+		    dw->write_ptr (ptr - dw->ptr_size, high + adjust);
+		}
+	      if (low != high && high >= start
+		  && dwarf2_addr_to_sec (dw, high - 1) != -1)
+		dw->write_ptr (ptr - dw->ptr_size, high + adjust);
+	      break;
+	    case DW_LLE_start_length:
+	      low = read_ptr (ptr);
+	      if (low >= start && dwarf2_addr_to_sec (dw, low) != -1)
+		dw->write_ptr (ptr - dw->ptr_size, low + adjust);
+	      read_uleb128 (ptr);
+	      break;
+	    default:
+	      error (0, 0, "%s: Unknown DWARF DW_LLE_%d", dso->filename, op);
+	      return 1;
+	    }
+
+	  /* Counted location description.  */
+	  len = read_uleb128 (ptr);
+	  if (ptr > endcu || len > endcu - ptr)
+	    {
+	      error (0, 0, "%s: .debug_loclists entry does not fit into unit",
+		     dso->filename);
+	      return 1;
+	    }
+	  if (adjust_location_list (dw, &cu, ptr, len, start, adjust))
+	    return 1;
+	  ptr += len;
+	}
+      if (ptr != endcu)
+	{
+	  error (0, 0, "%s: .debug_loclists entry does not fit into unit",
+		 dso->filename);
 	  return 1;
 	}
+    }
+
+  return 0;
+}
+
+static int
+set_ptr_size (struct dwarf2_info *dw, int ptr_size)
+{
+  dw->ptr_size = ptr_size;
+  if (ptr_size == 4)
+    {
+      dw->do_read_ptr = dw->do_read_32_64;
+      dw->write_ptr = dw->write_32;
+    }
+  else if (ptr_size == 8)
+    {
+      dw->do_read_ptr = dw->do_read_64;
+      dw->write_ptr = dw->write_64;
+    }
+  else
+    {
+      error (0, 0, "%s: Invalid DWARF pointer size %d",
+	     dw->dso->filename, ptr_size);
+      return 1;
+    }
+  return 0;
+}
+
+static int
+adjust_dwarf2_info (struct dwarf2_info *dw, int type, unsigned char *ptr,
+		    unsigned char *endsec)
+{
+  DSO *dso = dw->dso;
+  GElf_Addr start = dw->start, adjust = dw->adjust;
+  unsigned char *endcu;
+  unsigned char unit_type;
+  uint32_t value;
+  uint64_t abbrev_offset;
+  int addr_size, offset_size;
+  unsigned int entry;
+  struct abbrev_table *abbrev;
+  struct abbrev_tag *t;
+  struct cu_data cu;
 
-      endcu = ptr + 4;
-      endcu += read_32 (ptr);
-      if (endcu == ptr + 0xffffffff)
+  memset (&cu, 0, sizeof(cu));
+  while (ptr < endsec)
+    {
+      if (ptr + 11 > endsec)
 	{
-	  error (0, 0, "%s: 64-bit DWARF not supported", dso->filename);
+	  error (0, 0, "%s: .debug_info CU header too small", dso->filename);
 	  return 1;
 	}
 
-      if (endcu > endsec)
+      endcu = read_unit_length (dw, &ptr, endsec, &offset_size);
+      if (endcu == NULL)
 	{
 	  error (0, 0, "%s: .debug_info too small", dso->filename);
 	  return 1;
 	}
 
       value = read_16 (ptr);
-      if (value != 2 && value != 3 && value != 4)
+      if (value < 2 || value > 5 || (value >= 5 && type == DEBUG_TYPES))
 	{
 	  error (0, 0, "%s: DWARF version %d unhandled", dso->filename, value);
 	  return 1;
 	}
       cu.cu_version = value;
+      cu.cu_offset_size = offset_size;
+      if (value >= 5)
+	dw->dwarf5_seen = 1;
+
+      if (value >= 5)
+	{
+	  unit_type = read_1 (ptr);
+	  addr_size = read_1 (ptr);
+	}
+      else
+	unit_type = type == DEBUG_TYPES ? DW_UT_type : DW_UT_compile;
+      abbrev_offset = read_offset (ptr, offset_size);
+      if (value < 5)
+	addr_size = read_1 (ptr);
 
-      value = read_32 (ptr);
-      if (value >= debug_sections[DEBUG_ABBREV].size)
+      if (abbrev_offset >= dw->sections[DEBUG_ABBREV].size)
 	{
-	  if (debug_sections[DEBUG_ABBREV].data == NULL)
+	  if (dw->sections[DEBUG_ABBREV].data == NULL)
 	    error (0, 0, "%s: .debug_abbrev not present", dso->filename);
 	  else
 	    error (0, 0, "%s: DWARF CU abbrev offset too large",
@@ -1131,87 +1912,308 @@ adjust_dwarf2_info (DSO *dso, GElf_Addr start, GElf_Addr adjust, int type)
 	  return 1;
 	}
 
-      if (ptr_size == 0)
+      if (dw->ptr_size == 0)
 	{
-	  ptr_size = read_1 (ptr);
-	  if (ptr_size == 4)
-	    {
-	      do_read_ptr = do_read_32_64;
-	      write_ptr = write_32;
-	    }
-	  else if (ptr_size == 8)
-	    {
-	      do_read_ptr = do_read_64;
-	      write_ptr = write_64;
-	    }
-	  else
-	    {
-	      error (0, 0, "%s: Invalid DWARF pointer size %d",
-		     dso->filename, ptr_size);
-	      return 1;
-	    }
+	  if (set_ptr_size (dw, addr_size))
+	    return 1;
 	}
-      else if (read_1 (ptr) != ptr_size)
+      else if (addr_size != dw->ptr_size)
 	{
 	  error (0, 0, "%s: DWARF pointer size differs between CUs",
 		 dso->filename);
 	  return 1;
 	}
 
-      abbrev = read_abbrev (dso, debug_sections[DEBUG_ABBREV].data + value);
+      switch (unit_type)
+	{
+	case DW_UT_compile:
+	case DW_UT_partial:
+	  break;
+	case DW_UT_skeleton:
+	case DW_UT_split_compile:
+	  ptr += 8; /* Skip dwo_id.  */
+	  break;
+	case DW_UT_type:
+	case DW_UT_split_type:
+	  ptr += 8; /* Skip type_signature.  */
+	  ptr += offset_size; /* Skip type_offset.  */
+	  break;
+	default:
+	  error (0, 0, "%s: Unknown DWARF unit type %d", dso->filename,
+		 unit_type);
+	  return 1;
+	}
+
+      abbrev = find_abbrev_table (dw, abbrev_offset);
       if (abbrev == NULL)
 	return 1;
 
       cu.cu_entry_pc = ~ (GElf_Addr) 0;
       cu.cu_low_pc = ~ (GElf_Addr) 0;
 
-      if (type == DEBUG_TYPES)
-	{
-	  ptr += 8; /* Skip type_signature.  */
-	  ptr += 4; /* Skip type_offset.  */
-	}
-
       while (ptr < endcu)
 	{
-	  tag.entry = read_uleb128 (ptr);
-	  if (tag.entry == 0)
+	  entry = read_uleb128 (ptr);
+	  if (entry == 0)
 	    continue;
-	  t = htab_find_with_hash (abbrev, &tag, tag.entry);
+	  if (dw->abbrev_nocache)
+	    t = find_abbrev_linear (abbrev, entry);
+	  else
+	    t = find_abbrev (abbrev, entry);
 	  if (t == NULL)
 	    {
 	      error (0, 0, "%s: Could not find DWARF abbreviation %d",
-		     dso->filename, tag.entry);
-	      htab_delete (abbrev);
+		     dso->filename, entry);
 	      return 1;
 	    }
 
-	  ptr = adjust_attributes (dso, ptr, t, &cu, start, adjust);
+	  ptr = adjust_attributes (dw, ptr, t, &cu, start, adjust);
 	  if (ptr == NULL)
-	    {
-	      htab_delete (abbrev);
-	      return 1;
-	    }
+	    return 1;
+	}
+    }
+  return 0;
+}
+
+#ifdef HAVE_LIBPTHREAD
+struct dwarf2_worker
+  {
+    struct dwarf2_info dw;
+    dwarf2_unit_fn fn;
+    int sec;
+    unsigned char *ptr, *end;
+    pthread_t thread;
+    int started, ret;
+  };
+
+static void *
+dwarf2_worker (void *arg)
+{
+  struct dwarf2_worker *w = (struct dwarf2_worker *) arg;
+
+  w->ret = w->fn (&w->dw, w->sec, w->ptr, w->end);
+  return NULL;
+}
+
+/* Adjust the units in [PTR, END) of section SEC with up to NTHREADS
+   threads, each handling a contiguous run of whole units.  Units
+   never share bytes, so the in-place writes don't overlap and the
+   result is the same as from a single FN (DW, SEC, PTR, END) call.
+   Only the .debug_info and .debug_types passes collect locview
+   ranges; the other passes just read the ones already collected.  */
+static int
+adjust_dwarf2_parallel (struct dwarf2_info *dw, int sec, dwarf2_unit_fn fn,
+			unsigned char *ptr, unsigned char *end, int nthreads)
+{
+  struct dwarf2_worker *workers;
+  unsigned char *chunk_end, *next;
+  size_t chunk = (end - ptr + nthreads - 1) / nthreads;
+  size_t j;
+  int i, n, offset_size, ret = 0;
+  int collect_locviews = fn == adjust_dwarf2_info;
+
+  workers = calloc (nthreads, sizeof (struct dwarf2_worker));
+  if (workers == NULL)
+    return fn (dw, sec, ptr, end);
+
+  for (n = 0; n < nthreads && ptr < end; ++n)
+    {
+      chunk_end = ptr;
+      if (n == nthreads - 1)
+	chunk_end = end;
+      while (chunk_end < end && (size_t) (chunk_end - ptr) < chunk)
+	{
+	  next = chunk_end;
+	  chunk_end = read_unit_length (dw, &next, end, &offset_size);
+	  if (chunk_end == NULL)
+	    /* Let the worker complain about it.  */
+	    chunk_end = end;
+	}
+      workers[n].dw = *dw;
+      if (collect_locviews)
+	{
+	  workers[n].dw.locviews = NULL;
+	  workers[n].dw.nlocviews = 0;
+	  workers[n].dw.locviews_alloced = 0;
+	}
+      workers[n].dw.abbrevs = NULL;
+      workers[n].fn = fn;
+      workers[n].sec = sec;
+      workers[n].ptr = ptr;
+      workers[n].end = chunk_end;
+      ptr = chunk_end;
+    }
+
+  for (i = 1; i < n; ++i)
+    workers[i].started = pthread_create (&workers[i].thread, NULL,
+					 dwarf2_worker, &workers[i]) == 0;
+  dwarf2_worker (&workers[0]);
+  for (i = 1; i < n; ++i)
+    if (workers[i].started)
+      pthread_join (workers[i].thread, NULL);
+    else
+      dwarf2_worker (&workers[i]);
+
+  for (i = 0; i < n; ++i)
+    {
+      ret |= workers[i].ret;
+      dw->dwarf5_seen |= workers[i].dw.dwarf5_seen;
+      if (collect_locviews)
+	{
+	  for (j = 0; j < workers[i].dw.nlocviews && ! ret; ++j)
+	    ret = add_locview_range (dw, workers[i].dw.locviews[j].start,
+				     workers[i].dw.locviews[j].end);
+	  free (workers[i].dw.locviews);
+	}
+      if (workers[i].dw.abbrevs)
+	htab_delete (workers[i].dw.abbrevs);
+    }
+  free (workers);
+  return ret;
+}
+#endif
+
+/* Adjust debugging section SEC unit by unit with FN.  The first unit
+   is always done here, as it determines dw->ptr_size for the others.
+   The remaining ones are split among threads if there are enough
+   of them.  For testing, PRELINK_DWARF2_CHUNK in the environment
+   overrides DWARF2_PARALLEL_CHUNK, and then threads are used even
+   on a single CPU.  */
+static int
+adjust_dwarf2_section (struct dwarf2_info *dw, int sec, dwarf2_unit_fn fn)
+{
+  unsigned char *ptr = dw->sections[sec].data;
+  unsigned char *end = ptr + dw->sections[sec].size;
+  unsigned char *next = ptr;
+  int offset_size;
+#ifdef HAVE_LIBPTHREAD
+  long nthreads, chunk = DWARF2_PARALLEL_CHUNK;
+  const char *env;
+#endif
+
+  next = read_unit_length (dw, &next, end, &offset_size);
+  if (next == NULL)
+    return fn (dw, sec, ptr, end);
+  if (fn (dw, sec, ptr, next))
+    return 1;
+  ptr = next;
+
+#ifdef HAVE_LIBPTHREAD
+  nthreads = sysconf (_SC_NPROCESSORS_ONLN);
+  env = getenv ("PRELINK_DWARF2_CHUNK");
+  if (env != NULL)
+    {
+      chunk = strtol (env, NULL, 0);
+      if (chunk < 1)
+	chunk = 1;
+      nthreads = DWARF2_MAX_THREADS;
+    }
+  if (nthreads > DWARF2_MAX_THREADS)
+    nthreads = DWARF2_MAX_THREADS;
+  if (nthreads > (end - ptr) / chunk)
+    nthreads = (end - ptr) / chunk;
+  if (nthreads > 1)
+    return adjust_dwarf2_parallel (dw, sec, fn, ptr, end, nthreads);
+#endif
+
+  return fn (dw, sec, ptr, end);
+}
+
+static int
+adjust_dwarf2_sections (struct dwarf2_info *dw)
+{
+  DSO *dso = dw->dso;
+
+  if (dw->sections[DEBUG_INFO].data != NULL
+      && adjust_dwarf2_section (dw, DEBUG_INFO, adjust_dwarf2_info))
+    return 1;
+
+  if (dw->sections[DEBUG_TYPES].data != NULL
+      && adjust_dwarf2_section (dw, DEBUG_TYPES, adjust_dwarf2_info))
+    return 1;
+
+  if (dw->ptr_size == 0
+      /* Should not happen.  */
+      && set_ptr_size (dw, dso->ehdr.e_ident[EI_CLASS] == ELFCLASS64
+			   ? 8 : 4))
+    return 1;
+
+  if (dw->sections[DEBUG_LINE].data != NULL
+      && adjust_dwarf2_section (dw, DEBUG_LINE, adjust_dwarf2_line))
+    return 1;
+
+  if (dw->sections[DEBUG_ARANGES].data != NULL
+      && adjust_dwarf2_section (dw, DEBUG_ARANGES, adjust_dwarf2_aranges))
+    return 1;
+
+  if (dw->sections[DEBUG_FRAME].data != NULL
+      && adjust_dwarf2_section (dw, DEBUG_FRAME, adjust_dwarf2_frame))
+    return 1;
+
+  if (dw->sections[DEBUG_ADDR].data != NULL)
+    {
+      /* The pre-DWARF5 GNU split DWARF .debug_addr is just an array
+	 of addresses without any unit headers.  */
+      if (! dw->dwarf5_seen)
+	{
+	  unsigned char *addr = dw->sections[DEBUG_ADDR].data;
+
+	  if (adjust_dwarf2_addr (dw, DEBUG_ADDR, addr,
+				  addr + dw->sections[DEBUG_ADDR].size))
+	    return 1;
 	}
+      else if (adjust_dwarf2_section (dw, DEBUG_ADDR, adjust_dwarf2_addr))
+	return 1;
+    }
 
-      htab_delete (abbrev);
+  if (dw->sections[DEBUG_RNGLISTS].data != NULL
+      && adjust_dwarf2_section (dw, DEBUG_RNGLISTS, adjust_dwarf2_rnglists))
+    return 1;
+
+  if (dw->sections[DEBUG_LOCLISTS].data != NULL)
+    {
+      qsort (dw->locviews, dw->nlocviews, sizeof (struct locview_range),
+	     locview_range_cmp);
+      if (adjust_dwarf2_section (dw, DEBUG_LOCLISTS, adjust_dwarf2_loclists))
+	return 1;
     }
+
+  /* .debug_abbrev requires no adjustement.  */
+  /* .debug_pubnames requires no adjustement.  */
+  /* .debug_pubtypes requires no adjustement.  */
+  /* .debug_gnu_pubnames requires no adjustement.  */
+  /* .debug_gnu_pubtypes requires no adjustement.  */
+  /* .debug_macinfo requires no adjustement.  */
+  /* .debug_str requires no adjustement.  */
+  /* .debug_line_str requires no adjustement.  */
+  /* .debug_str_offsets requires no adjustement.  */
+  /* .debug_names requires no adjustement.  */
+  /* .debug_ranges adjusted for each DW_AT_ranges pointing into it.  */
+  /* .debug_loc adjusted for each loclistptr pointing into it.  */
   return 0;
 }
 
 int
 adjust_dwarf2 (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
 {
+  static const int adjusted[] =
+    {
+      DEBUG_INFO, DEBUG_TYPES, DEBUG_LINE, DEBUG_ARANGES, DEBUG_FRAME,
+      DEBUG_RANGES, DEBUG_LOC, DEBUG_ADDR, DEBUG_RNGLISTS, DEBUG_LOCLISTS
+    };
+  struct dwarf2_info info, *dw = &info;
   Elf_Data *data;
   Elf_Scn *scn;
-  int i, j;
+  int i, j, ret;
 
-  for (i = 0; debug_sections[i].name; ++i)
-    {
-      debug_sections[i].data = NULL;
-      debug_sections[i].size = 0;
-      debug_sections[i].sec = 0;
-    }
-  ptr_size = 0;
+  memset (&info, 0, sizeof (info));
+  info.dso = dso;
+  info.start = start;
+  info.adjust = adjust;
+  info.lastscn = dso->lastscn;
+  /* For testing, decode abbreviation tables for every unit again
+     and look codes up the slow way.  */
+  info.abbrev_nocache = getenv ("PRELINK_DWARF2_NO_ABBREV_CACHE") != NULL;
 
   for (i = 1; i < dso->ehdr.e_shnum; ++i)
     if (! (dso->shdr[i].sh_flags & (SHF_ALLOC | SHF_WRITE | SHF_EXECINSTR))
@@ -1222,10 +2224,10 @@ adjust_dwarf2 (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
 
 	if (strncmp (name, ".debug_", sizeof (".debug_") - 1) == 0)
 	  {
-	    for (j = 0; debug_sections[j].name; ++j)
-	      if (strcmp (name, debug_sections[j].name) == 0)
+	    for (j = 0; debug_section_names[j]; ++j)
+	      if (strcmp (name, debug_section_names[j]) == 0)
 	 	{
-		  if (debug_sections[j].data)
+		  if (dw->sections[j].data)
 		    {
 		      error (0, 0, "%s: Found two copies of %s section",
 			     dso->filename, name);
@@ -1238,13 +2240,13 @@ adjust_dwarf2 (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
 		  assert (elf_getdata (scn, data) == NULL);
 		  assert (data->d_off == 0);
 		  assert (data->d_size == dso->shdr[i].sh_size);
-		  debug_sections[j].data = data->d_buf;
-		  debug_sections[j].size = data->d_size;
-		  debug_sections[j].sec = i;
+		  dw->sections[j].data = data->d_buf;
+		  dw->sections[j].size = data->d_size;
+		  dw->sections[j].sec = i;
 		  break;
 		}
 
-	    if (debug_sections[j].name == NULL)
+	    if (debug_section_names[j] == NULL)
 	      {
 		error (0, 0, "%s: Unknown debugging section %s",
 		       dso->filename, name);
@@ -1255,21 +2257,21 @@ adjust_dwarf2 (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
 
   if (dso->ehdr.e_ident[EI_DATA] == ELFDATA2LSB)
     {
-      do_read_16 = buf_read_ule16;
-      do_read_32 = buf_read_ule32;
-      do_read_32_64 = buf_read_ule32_64;
-      do_read_64 = buf_read_ule64;
-      write_32 = dwarf2_write_le32;
-      write_64 = dwarf2_write_le64;
+      dw->do_read_16 = buf_read_ule16;
+      dw->do_read_32 = buf_read_ule32;
+      dw->do_read_32_64 = buf_read_ule32_64;
+      dw->do_read_64 = buf_read_ule64;
+      dw->write_32 = dwarf2_write_le32;
+      dw->write_64 = dwarf2_write_le64;
     }
   else if (dso->ehdr.e_ident[EI_DATA] == ELFDATA2MSB)
     {
-      do_read_16 = buf_read_ube16;
-      do_read_32 = buf_read_ube32;
-      do_read_32_64 = buf_read_ube32_64;
-      do_read_64 = buf_read_ube64;
-      write_32 = dwarf2_write_be32;
-      write_64 = dwarf2_write_be64;
+      dw->do_read_16 = buf_read_ube16;
+      dw->do_read_32 = buf_read_ube32;
+      dw->do_read_32_64 = buf_read_ube32_64;
+      dw->do_read_64 = buf_read_ube64;
+      dw->write_32 = dwarf2_write_be32;
+      dw->write_64 = dwarf2_write_be64;
     }
   else
     {
@@ -1277,38 +2279,17 @@ adjust_dwarf2 (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
       return 1;
     }
 
-  if (debug_sections[DEBUG_INFO].data != NULL
-      && adjust_dwarf2_info (dso, start, adjust, DEBUG_INFO))
-    return 1;
-
-  if (debug_sections[DEBUG_TYPES].data != NULL
-      && adjust_dwarf2_info (dso, start, adjust, DEBUG_TYPES))
-    return 1;
-
-  if (ptr_size == 0)
-    /* Should not happen.  */
-    ptr_size = dso->ehdr.e_ident[EI_CLASS] == ELFCLASS64 ? 8 : 4;
-
-  if (debug_sections[DEBUG_LINE].data != NULL
-      && adjust_dwarf2_line (dso, start, adjust))
-    return 1;
-
-  if (debug_sections[DEBUG_ARANGES].data != NULL
-      && adjust_dwarf2_aranges (dso, start, adjust))
+  ret = adjust_dwarf2_sections (dw);
+  free (info.locviews);
+  if (info.abbrevs)
+    htab_delete (info.abbrevs);
+  if (ret)
     return 1;
 
-  if (debug_sections[DEBUG_FRAME].data != NULL
-      && adjust_dwarf2_frame (dso, start, adjust))
-    return 1;
-
-  /* .debug_abbrev requires no adjustement.  */
-  /* .debug_pubnames requires no adjustement.  */
-  /* .debug_pubtypes requires no adjustement.  */
-  /* .debug_macinfo requires no adjustement.  */
-  /* .debug_str requires no adjustement.  */
-  /* .debug_ranges adjusted for each DW_AT_ranges pointing into it.  */
-  /* .debug_loc adjusted for each loclistptr pointing into it.  */
-
+  for (i = 0; i < (int) (sizeof (adjusted) / sizeof (adjusted[0])); ++i)
+    if (info.sections[adjusted[i]].data != NULL)
+      elf_flagscn (dso->scn[info.sections[adjusted[i]].sec], ELF_C_SET,
+		   ELF_F_DIRTY);
   elf_flagscn (dso->scn[n], ELF_C_SET, ELF_F_DIRTY);
   return 0;
 }
@@ -454,12 +454,38 @@ prelink_conflict_add_rela (struct prelink_info *info)
   abort ();
 }
 
+struct prelink_conflict *
+prelink_conflict_iter (struct prelink_conflicts *conflicts, GElf_Addr symoff,
+		       size_t *pos)
+{
+  abort ();
+}
+
+struct prelink_conflict *
+prelink_conflict_find (struct prelink_conflicts *conflicts, GElf_Addr symoff,
+		       int reloc_class)
+{
+  abort ();
+}
+
 ssize_t
 send_file (int outfd, int infd, off_t *poff, size_t count)
 {
   abort ();
 }
 
+int
+update_debuginfo (DSO *dso, char **namep, char **tempp)
+{
+  abort ();
+}
+
+void
+finish_debuginfo (char *name, char *temp_name, int commit)
+{
+}
+
 GElf_Addr mmap_reg_start;
 GElf_Addr mmap_reg_end;
 int exec_shield;
+int rebase_debuginfo;
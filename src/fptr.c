@@ -147,25 +147,21 @@ opd_init (struct prelink_info *info)
       struct prelink_entry *ent;
       struct prelink_conflict *conflict;
       struct opd_lib *ol;
-      size_t maxidx = 1;
 
       ent = info->ent->depends[i];
       ol = ent->opd;
-      if (info->conflicts[i + 1].hash != &info->conflicts[i + 1].first)
-	maxidx = 251;
       for (j = 0; j < ol->nrefs; ++j)
 	{
 	  GElf_Addr symoff = ol->u.refs[j].symoff;
+	  size_t pos = 0;
+
 	  refent.val = ol->u.refs[j].ent->val;
 	  refent.gp = ol->u.refs[j].ent->gp;
-	  for (conflict = info->conflicts[i + 1].hash[symoff % maxidx]; conflict;
-	       conflict = conflict->next)
-	    {
-	      if (conflict->symoff == symoff
-		  && conflict->reloc_class != RTYPE_CLASS_COPY
-		  && conflict->reloc_class != RTYPE_CLASS_TLS)
-		break;
-	    }
+	  while ((conflict = prelink_conflict_iter (&info->conflicts[i + 1],
+						    symoff, &pos)) != NULL)
+	    if (conflict->reloc_class != RTYPE_CLASS_COPY
+		&& conflict->reloc_class != RTYPE_CLASS_TLS)
+	      break;
 
 	  if (conflict)
 	    {
@@ -187,7 +183,6 @@ opd_init (struct prelink_info *info)
 	      struct opd_ent_plt *entp
 		= (struct opd_ent_plt *) ol->u.refs[j].ent;
 	      int k;
-	      size_t idx = 0;
 
 	      for (k = 0; k < info->ent->ndepends; ++k)
 		if (info->ent->depends[k] == entp->lib)
@@ -195,15 +190,8 @@ opd_init (struct prelink_info *info)
 
 	      assert (k < info->ent->ndepends);
 
-	      if (info->conflicts[k + 1].hash != &info->conflicts[k + 1].first)
-		idx = entp->symoff % 251;
-	      for (conflict = info->conflicts[k + 1].hash[idx]; conflict;
-		   conflict = conflict->next)
-		{
-		  if (conflict->symoff == entp->symoff
-		      && conflict->reloc_class == RTYPE_CLASS_PLT)
-		    break;
-		}
+	      conflict = prelink_conflict_find (&info->conflicts[k + 1],
+						entp->symoff, RTYPE_CLASS_PLT);
 
 	      if (conflict)
 		{
@@ -40,27 +40,6 @@ is_ldso_soname (const char *soname)
   return 0;
 }
 
-static void
-conflict_hash_init (struct prelink_conflicts *conflicts)
-{
-  struct prelink_conflict **hash
-    = calloc (sizeof (struct prelink_conflict *), 251);
-  struct prelink_conflict *conflict, *next;
-  size_t idx;
-
-  if (hash == NULL)
-    return;
-
-  for (conflict = conflicts->first; conflict; conflict = next)
-    {
-      next = conflict->next;
-      idx = conflict->symoff % 251;
-      conflict->next = hash[idx];
-      hash[idx] = conflict;
-    }
-  conflicts->hash = hash;
-}
-
 static int
 prelink_record_relocations (struct prelink_info *info, FILE *f,
 			    const char *ent_filename)
@@ -237,8 +216,6 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 	  error (0, ENOMEM, "%s: Can't build list of conflicts", info->ent->filename);
 	  goto error_out;
 	}
-      for (i = 0; i < ndeps; i++)
-	info->conflicts[i].hash = &info->conflicts[i].first;
     }
   do
     {
@@ -339,38 +316,32 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 		  && reloc_class != RTYPE_CLASS_TLS)
 		value[0] = adjust_old_to_new (info->dso, value[0]);
 
-	      s = &info->symbols[(symoff - info->symtab_start)
-				  / info->symtab_entsize];
-	      if (s->reloc_class)
+	      s = info->symbols[reloc_class & RTYPE_CLASS_MASK];
+	      if (s == NULL)
 		{
-		  while (s->reloc_class != reloc_class && s->next != NULL)
-		    s = s->next;
-		  if (s->reloc_class == reloc_class)
+		  s = calloc (sizeof (struct prelink_symbol),
+			      info->symbol_count);
+		  if (s == NULL)
 		    {
-		      if ((reloc_class != RTYPE_CLASS_TLS && s->u.ent != ent)
-			  || (reloc_class == RTYPE_CLASS_TLS
-			      && s->u.tls != tls)
-			  || s->value != value[0])
-			{
-			  error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
-				 info->ent->filename, symname);
-			  goto error_out;
-			}
-		      s = NULL;
+		      error (0, ENOMEM, "Cannot build symbol lookup map");
+		      goto error_out;
 		    }
-		  else
+		  info->symbols[reloc_class & RTYPE_CLASS_MASK] = s;
+		}
+	      s += (symoff - info->symtab_start) / info->symtab_entsize;
+	      if (s->reloc_class)
+		{
+		  if (s->reloc_class != reloc_class
+		      || (reloc_class != RTYPE_CLASS_TLS && s->u.ent != ent)
+		      || (reloc_class == RTYPE_CLASS_TLS && s->u.tls != tls)
+		      || s->value != value[0])
 		    {
-		      s->next = (struct prelink_symbol *)
-				malloc (sizeof (struct prelink_symbol));
-		      if (s->next == NULL)
-			{
-			  error (0, ENOMEM, "Cannot build symbol lookup map");
-			  goto error_out;
-			}
-		      s = s->next;
+		      error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
+			     info->ent->filename, symname);
+		      goto error_out;
 		    }
 		}
-	      if (s)
+	      else
 		{
 		  if (reloc_class == RTYPE_CLASS_TLS)
 		    s->u.tls = tls;
@@ -378,7 +349,6 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 		    s->u.ent = ent;
 		  s->value = value[0];
 		  s->reloc_class = reloc_class;
-		  s->next = NULL;
 		}
 	    }
 	  else if ((reloc_class == RTYPE_CLASS_TLS || ifunc)
@@ -386,7 +356,6 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 	    {
 	      struct prelink_conflict *conflict;
 	      int symowner;
-	      size_t idx;
 
 	      for (symowner = 0; symowner < ndeps; symowner++)
 		if (deps[symowner].start == symstart)
@@ -398,41 +367,35 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 		  goto error_out;
 		}
 
-              idx = 0;
-	      if (info->conflicts[symowner].hash != &info->conflicts[symowner].first)
-		idx = symoff % 251;
-	      for (conflict = info->conflicts[symowner].hash[idx]; conflict;
-		   conflict = conflict->next)
-		if (conflict->symoff == symoff
-		    && conflict->reloc_class == reloc_class)
-		  {
-		    if ((reloc_class != RTYPE_CLASS_TLS
-			 && (conflict->lookup.ent != ent
-			     || conflict->conflict.ent != ent))
-			|| (reloc_class == RTYPE_CLASS_TLS
-			    && (conflict->lookup.tls != tls
-				|| conflict->conflict.tls != tls))
-			|| conflict->lookupval != value[0]
-			|| conflict->conflictval != value[0])
-		      {
-			error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
-			       info->ent->filename, symname);
-			goto error_out;
-		      }
-		    break;
-		  }
-	      if (conflict == NULL)
+	      conflict = prelink_conflict_find (&info->conflicts[symowner],
+						symoff, reloc_class);
+	      if (conflict != NULL)
 		{
-		  conflict = malloc (sizeof (struct prelink_conflict));
+		  if ((reloc_class != RTYPE_CLASS_TLS
+		       && (conflict->lookup.ent != ent
+			   || conflict->conflict.ent != ent))
+		      || (reloc_class == RTYPE_CLASS_TLS
+			  && (conflict->lookup.tls != tls
+			      || conflict->conflict.tls != tls))
+		      || conflict->lookupval != value[0]
+		      || conflict->conflictval != value[0])
+		    {
+		      error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
+			     info->ent->filename, symname);
+		      goto error_out;
+		    }
+		}
+	      else
+		{
+		  conflict
+		    = prelink_conflict_new (&info->conflicts[symowner],
+					    symoff, reloc_class);
 		  if (conflict == NULL)
 		    {
 		      error (0, ENOMEM, "Cannot build list of conflicts");
 		      goto error_out;
 		    }
 
-		  conflict->next = info->conflicts[symowner].hash[idx];
-		  conflict->next2 = NULL;
-		  info->conflicts[symowner].hash[idx] = conflict;
 		  if (reloc_class != RTYPE_CLASS_TLS)
 		    {
 		      conflict->lookup.ent = ent;
@@ -445,12 +408,7 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 		    }
 		  conflict->lookupval = value[0];
 		  conflict->conflictval = value[0];
-		  conflict->symoff = symoff;
-		  conflict->reloc_class = reloc_class;
-		  conflict->used = 0;
 		  conflict->ifunc = ifunc;
-		  if (++info->conflicts[symowner].count == 16)
-		    conflict_hash_init (&info->conflicts[symowner]);
 		}
 	    }
 	}
@@ -508,7 +466,6 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 	      struct prelink_tls *tlss[2];
 	      struct prelink_conflict *conflict;
 	      int symowner, j;
-	      size_t idx;
 
 	      for (symowner = 1; symowner < ndeps; symowner++)
 		if (deps[symowner].start == symstart)
@@ -550,42 +507,35 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 		    }
 		}
 
-	      idx = 0;
-	      if (info->conflicts[symowner].hash
-		  != &info->conflicts[symowner].first)
-		idx = symoff % 251;
-	      for (conflict = info->conflicts[symowner].hash[idx]; conflict;
-		   conflict = conflict->next)
-		if (conflict->symoff == symoff
-		    && conflict->reloc_class == reloc_class)
-		  {
-		    if ((reloc_class != RTYPE_CLASS_TLS
-			 && (conflict->lookup.ent != ents[0]
-			     || conflict->conflict.ent != ents[1]))
-			|| (reloc_class == RTYPE_CLASS_TLS
-			    && (conflict->lookup.tls != tlss[0]
-				|| conflict->conflict.tls != tlss[1]))
-			|| conflict->lookupval != value[0]
-			|| conflict->conflictval != value[1])
-		      {
-			error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
-			       info->ent->filename, symname);
-			goto error_out;
-		      }
-		    break;
-		  }
-	      if (conflict == NULL)
+	      conflict = prelink_conflict_find (&info->conflicts[symowner],
+						symoff, reloc_class);
+	      if (conflict != NULL)
+		{
+		  if ((reloc_class != RTYPE_CLASS_TLS
+		       && (conflict->lookup.ent != ents[0]
+			   || conflict->conflict.ent != ents[1]))
+		      || (reloc_class == RTYPE_CLASS_TLS
+			  && (conflict->lookup.tls != tlss[0]
+			      || conflict->conflict.tls != tlss[1]))
+		      || conflict->lookupval != value[0]
+		      || conflict->conflictval != value[1])
+		    {
+		      error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
+			     info->ent->filename, symname);
+		      goto error_out;
+		    }
+		}
+	      else
 		{
-		  conflict = malloc (sizeof (struct prelink_conflict));
+		  conflict
+		    = prelink_conflict_new (&info->conflicts[symowner],
+					    symoff, reloc_class);
 		  if (conflict == NULL)
 		    {
 		      error (0, ENOMEM, "Cannot build list of conflicts");
 		      goto error_out;
 		    }
 
-		  conflict->next = info->conflicts[symowner].hash[idx];
-		  conflict->next2 = NULL;
-		  info->conflicts[symowner].hash[idx] = conflict;
 		  if (reloc_class != RTYPE_CLASS_TLS)
 		    {
 		      conflict->lookup.ent = ents[0];
@@ -598,12 +548,7 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 		    }
 		  conflict->lookupval = value[0];
 		  conflict->conflictval = value[1];
-		  conflict->symoff = symoff;
-		  conflict->reloc_class = reloc_class;
-		  conflict->used = 0;
 		  conflict->ifunc = ifunc;
-		  if (++info->conflicts[symowner].count == 16)
-		    conflict_hash_init (&info->conflicts[symowner]);
 		}
 	    }
 	}
@@ -667,7 +612,6 @@ prelink_get_relocations (struct prelink_info *info)
 
   info->symbol_count = (info->symtab_end - info->symtab_start)
 		       / info->symtab_entsize;
-  info->symbols = calloc (sizeof (struct prelink_symbol), info->symbol_count);
 
   i = 0;
   argv[i++] = dl;
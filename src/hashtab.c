@@ -18,6 +18,7 @@ License along with libiberty; see the file COPYING.LIB.  If
 not, write to the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
 Boston, MA 02111-1307, USA.  */
 
+
 /* This package implements basic hash table functionality.  It is possible
    to search for an entry, create an entry and destroy an entry.
 
@@ -26,10 +27,14 @@ Boston, MA 02111-1307, USA.  */
    The size of the table is not fixed; if the occupancy of the table
    grows too high the hash table will be expanded.
 
-   The abstract data implementation is based on generalized Algorithm D
-   from Knuth's book "The art of computer programming".  Hash table is
-   expanded by creation of new hash table and transferring elements from
-   the old table to the new table. */
+   The table is open addressed with linear probing, and its size is
+   always a power of two.  The hash value of each element is stored in
+   a separate array next to the elements, so that probing only has to
+   call the comparison function (and dereference the element) when the
+   hash values match, and expanding the table does not call the hash
+   function at all.  Hash table is expanded by creation of new hash
+   table and transferring elements from the old table to the new
+   table.  */
 
 #include <config.h>
 #include <sys/types.h>
@@ -47,11 +52,15 @@ Boston, MA 02111-1307, USA.  */
 
 #define DELETED_ENTRY  ((void *) 1)
 
-static unsigned long higher_prime_number (unsigned long);
+/* Smallest table size.  */
+
+#define MIN_SIZE	16
+
 static hashval_t hash_pointer (const void *);
 static int eq_pointer (const void *, const void *);
-static int htab_expand (htab_t);
-static void **find_empty_slot_for_expand  (htab_t, hashval_t);
+static int htab_alloc (htab_t, size_t);
+static int htab_expand (htab_t, size_t);
+static size_t find_empty_slot_for_expand  (htab_t, hashval_t);
 
 /* At some point, we could make these be NULL, and modify the
    hash-table routines to handle NULL specially; that would avoid
@@ -59,70 +68,40 @@ static void **find_empty_slot_for_expand  (htab_t, hashval_t);
 htab_hash htab_hash_pointer = hash_pointer;
 htab_eq htab_eq_pointer = eq_pointer;
 
-/* The following function returns a nearest prime number which is
-   greater than N, and near a power of two. */
+/* Return the smallest power of two table size which can hold N
+   elements with at most half of the entries used.  */
 
-static unsigned long
-higher_prime_number (n)
-     unsigned long n;
+static size_t
+size_for_elements (n)
+     size_t n;
 {
-  /* These are primes that are near, but slightly smaller than, a
-     power of two.  */
-  static unsigned long primes[] = {
-    (unsigned long) 2,
-    (unsigned long) 7,
-    (unsigned long) 13,
-    (unsigned long) 31,
-    (unsigned long) 61,
-    (unsigned long) 127,
-    (unsigned long) 251,
-    (unsigned long) 509,
-    (unsigned long) 1021,
-    (unsigned long) 2039,
-    (unsigned long) 4093,
-    (unsigned long) 8191,
-    (unsigned long) 16381,
-    (unsigned long) 32749,
-    (unsigned long) 65521,
-    (unsigned long) 131071,
-    (unsigned long) 262139,
-    (unsigned long) 524287,
-    (unsigned long) 1048573,
-    (unsigned long) 2097143,
-    (unsigned long) 4194301,
-    (unsigned long) 8388593,
-    (unsigned long) 16777213,
-    (unsigned long) 33554393,
-    (unsigned long) 67108859,
-    (unsigned long) 134217689,
-    (unsigned long) 268435399,
-    (unsigned long) 536870909,
-    (unsigned long) 1073741789,
-    (unsigned long) 2147483647,
-					/* 4294967291L */
-    ((unsigned long) 2147483647) + ((unsigned long) 2147483644),
-  };
-
-  unsigned long* low = &primes[0];
-  unsigned long* high = &primes[sizeof(primes) / sizeof(primes[0])];
-
-  while (low != high)
-    {
-      unsigned long* mid = low + (high - low) / 2;
-      if (n > *mid)
-	low = mid + 1;
-      else
-	high = mid;
-    }
+  size_t size = MIN_SIZE;
 
-  /* If we've run out of primes, abort.  */
-  if (n > *low)
+  while (size / 2 < n)
     {
-      fprintf (stderr, "Cannot find prime bigger than %lu\n", n);
-      abort ();
+      if (size >= ((size_t) 1 << 31))
+	{
+	  fprintf (stderr, "Cannot create hash table for %lu elements\n",
+		   (unsigned long) n);
+	  abort ();
+	}
+      size *= 2;
     }
+  return size;
+}
+
+/* Return the first entry to probe for HASH.  The hash value is
+   multiplied by 2^32 divided by the golden ratio and the top bits of
+   the product are used, which spreads out hash values that differ only
+   in their upper bits, or that are multiples of a power of two, as
+   pointer and offset hash values tend to be.  */
 
-  return *low;
+static inline size_t
+home_index (htab, hash)
+     htab_t htab;
+     hashval_t hash;
+{
+  return ((hash * 0x9e3779b9U) & 0xffffffffU) >> htab->shift;
 }
 
 /* Returns a hash code for P.  */
@@ -144,6 +123,31 @@ eq_pointer (p1, p2)
   return p1 == p2;
 }
 
+/* Allocate empty entries and hash values for a table of SIZE entries,
+   which must be a power of two.  Return zero if memory allocation
+   fails.  */
+
+static int
+htab_alloc (htab, size)
+     htab_t htab;
+     size_t size;
+{
+  void **entries;
+  unsigned int shift = 32;
+
+  entries = (void **) calloc (size, sizeof (void *) + sizeof (hashval_t));
+  if (entries == NULL)
+    return 0;
+
+  while (((size_t) 1 << (32 - shift)) < size)
+    shift--;
+  htab->entries = entries;
+  htab->hashes = (hashval_t *) (entries + size);
+  htab->size = size;
+  htab->shift = shift;
+  return 1;
+}
+
 /* This function creates table with length slightly longer than given
    source length.  The created hash table is initiated as empty (all the
    hash table entries are EMPTY_ENTRY).  The function returns the created
@@ -158,19 +162,16 @@ htab_try_create (size, hash_f, eq_f, del_f)
 {
   htab_t result;
 
-  size = higher_prime_number (size);
   result = (htab_t) calloc (1, sizeof (struct htab));
   if (result == NULL)
     return NULL;
 
-  result->entries = (void **) calloc (size, sizeof (void *));
-  if (result->entries == NULL)
+  if (! htab_alloc (result, size_for_elements (size / 2)))
     {
       free (result);
       return NULL;
     }
 
-  result->size = size;
   result->hash_f = hash_f;
   result->eq_f = eq_f;
   result->del_f = del_f;
@@ -185,10 +186,10 @@ void
 htab_delete (htab)
      htab_t htab;
 {
-  int i;
+  size_t i;
 
   if (htab->del_f)
-    for (i = htab->size - 1; i >= 0; i--)
+    for (i = 0; i < htab->size; i++)
       if (htab->entries[i] != EMPTY_ENTRY
 	  && htab->entries[i] != DELETED_ENTRY)
 	(*htab->del_f) (htab->entries[i]);
@@ -203,15 +204,18 @@ void
 htab_empty (htab)
      htab_t htab;
 {
-  int i;
+  size_t i;
 
   if (htab->del_f)
-    for (i = htab->size - 1; i >= 0; i--)
+    for (i = 0; i < htab->size; i++)
       if (htab->entries[i] != EMPTY_ENTRY
 	  && htab->entries[i] != DELETED_ENTRY)
 	(*htab->del_f) (htab->entries[i]);
 
-  memset (htab->entries, 0, htab->size * sizeof (void *));
+  memset (htab->entries, 0,
+	  htab->size * (sizeof (void *) + sizeof (hashval_t)));
+  htab->n_elements = 0;
+  htab->n_deleted = 0;
 }
 
 /* Similar to htab_find_slot, but without several unwanted side effects:
@@ -219,84 +223,83 @@ htab_empty (htab)
     - Does not change the count of elements/searches/collisions in the
       hash table.
    This function also assumes there are no deleted entries in the table.
-   HASH is the hash value for the element to be inserted.  */
+   HASH is the hash value for the element to be inserted.  Returns the
+   index of the empty entry.  */
 
-static void **
+static size_t
 find_empty_slot_for_expand (htab, hash)
      htab_t htab;
      hashval_t hash;
 {
-  size_t size = htab->size;
-  hashval_t hash2 = 1 + hash % (size - 2);
-  unsigned int index = hash % size;
-
-  for (;;)
-    {
-      void **slot = htab->entries + index;
+  size_t mask = htab->size - 1;
+  size_t index = home_index (htab, hash);
 
-      if (*slot == EMPTY_ENTRY)
-	return slot;
-      else if (*slot == DELETED_ENTRY)
-	abort ();
-
-      index += hash2;
-      if (index >= size)
-	index -= size;
-    }
+  while (htab->entries[index] != EMPTY_ENTRY)
+    index = (index + 1) & mask;
+  return index;
 }
 
 /* The following function changes size of memory allocated for the
-   entries and repeatedly inserts the table elements.  The occupancy
-   of the table after the call will be about 50%.  Naturally the hash
-   table must already exist.  Remember also that the place of the
-   table entries is changed.  If memory allocation failures are allowed,
-   this function will return zero, indicating that the table could not be
-   expanded.  If all goes well, it will return a non-zero value.  */
+   entries to SIZE entries and reinserts the table elements, using
+   their saved hash values.  Deleted entries are dropped.  Naturally
+   the hash table must already exist.  Remember also that the place of
+   the table entries is changed.  If memory allocation failures are
+   allowed, this function will return zero, indicating that the table
+   could not be expanded.  If all goes well, it will return a non-zero
+   value.  */
 
 static int
-htab_expand (htab)
+htab_expand (htab, size)
      htab_t htab;
+     size_t size;
 {
-  void **oentries;
-  void **olimit;
-  void **p;
-
-  oentries = htab->entries;
-  olimit = oentries + htab->size;
+  void **oentries = htab->entries;
+  hashval_t *ohashes = htab->hashes;
+  size_t osize = htab->size, i;
 
-  htab->size = higher_prime_number (htab->size * 2);
-
-  if (htab->return_allocation_failure)
+  if (! htab_alloc (htab, size))
     {
-      void **nentries = (void **) calloc (htab->size, sizeof (void **));
-      if (nentries == NULL)
+      if (htab->return_allocation_failure)
 	return 0;
-      htab->entries = nentries;
+      abort ();
     }
 
   htab->n_elements -= htab->n_deleted;
   htab->n_deleted = 0;
 
-  p = oentries;
-  do
+  for (i = 0; i < osize; i++)
     {
-      void * x = *p;
+      void * x = oentries[i];
 
       if (x != EMPTY_ENTRY && x != DELETED_ENTRY)
 	{
-	  void **q = find_empty_slot_for_expand (htab, (*htab->hash_f) (x));
+	  size_t index = find_empty_slot_for_expand (htab, ohashes[i]);
 
-	  *q = x;
+	  htab->entries[index] = x;
+	  htab->hashes[index] = ohashes[i];
 	}
-
-      p++;
     }
-  while (p < olimit);
 
   free (oentries);
   return 1;
 }
 
+/* Make room for N more elements, so that inserting them does not
+   expand the table again and again.  Returns zero if memory allocation
+   fails.  */
+
+int
+htab_reserve (htab, n)
+     htab_t htab;
+     size_t n;
+{
+  size_t size = size_for_elements (htab->n_elements - htab->n_deleted + n);
+
+  if (size <= htab->size)
+    return 1;
+  return htab_expand (htab, size);
+}
+
 /* This function searches for a hash table entry equal to the given
    element.  It cannot be used to insert or delete an element.  */
 
@@ -306,33 +309,22 @@ htab_find_with_hash (htab, element, hash)
      const void * element;
      hashval_t hash;
 {
-  unsigned int index;
-  hashval_t hash2;
-  size_t size;
-  void * entry;
+  size_t mask = htab->size - 1;
+  size_t index = home_index (htab, hash);
 
   htab->searches++;
-  size = htab->size;
-  index = hash % size;
-
-  entry = htab->entries[index];
-  if (entry == EMPTY_ENTRY
-      || (entry != DELETED_ENTRY && (*htab->eq_f) (entry, element)))
-    return entry;
-
-  hash2 = 1 + hash % (size - 2);
 
   for (;;)
     {
-      htab->collisions++;
-      index += hash2;
-      if (index >= size)
-	index -= size;
+      void * entry = htab->entries[index];
 
-      entry = htab->entries[index];
       if (entry == EMPTY_ENTRY
-	  || (entry != DELETED_ENTRY && (*htab->eq_f) (entry, element)))
+	  || (entry != DELETED_ENTRY && htab->hashes[index] == hash
+	      && (*htab->eq_f) (entry, element)))
 	return entry;
+
+      htab->collisions++;
+      index = (index + 1) & mask;
     }
 }
 
@@ -362,21 +354,26 @@ htab_find_slot_with_hash (htab, element, hash, insert)
      hashval_t hash;
      enum insert_option insert;
 {
-  void **first_deleted_slot;
-  unsigned int index;
-  hashval_t hash2;
-  size_t size;
+  size_t first_deleted, mask, index;
 
-  if (insert == INSERT && htab->size * 3 <= htab->n_elements * 4
-      && htab_expand (htab) == 0)
-    return NULL;
+  if (insert == INSERT && htab->size * 3 <= htab->n_elements * 4)
+    {
+      /* If the table is mostly deleted entries, rehashing it at the
+	 same size is enough.  */
+      size_t size = size_for_elements (htab->n_elements
+				       - htab->n_deleted + 1);
+
+      if (size < htab->size)
+	size = htab->size;
+      if (htab_expand (htab, size) == 0)
+	return NULL;
+    }
 
-  size = htab->size;
-  hash2 = 1 + hash % (size - 2);
-  index = hash % size;
+  mask = htab->size - 1;
+  index = home_index (htab, hash);
 
   htab->searches++;
-  first_deleted_slot = NULL;
+  first_deleted = htab->size;
 
   for (;;)
     {
@@ -388,27 +385,29 @@ htab_find_slot_with_hash (htab, element, hash, insert)
 
 	  htab->n_elements++;
 
-	  if (first_deleted_slot)
+	  if (first_deleted != htab->size)
 	    {
-	      *first_deleted_slot = EMPTY_ENTRY;
-	      return first_deleted_slot;
+	      index = first_deleted;
+	      htab->entries[index] = EMPTY_ENTRY;
+	      htab->n_deleted--;
+	      htab->n_elements--;
 	    }
 
+	  htab->hashes[index] = hash;
 	  return &htab->entries[index];
 	}
 
       if (entry == DELETED_ENTRY)
 	{
-	  if (!first_deleted_slot)
-	    first_deleted_slot = &htab->entries[index];
+	  if (first_deleted == htab->size)
+	    first_deleted = index;
 	}
-      else  if ((*htab->eq_f) (entry, element))
+      else if (htab->hashes[index] == hash
+	       && (*htab->eq_f) (entry, element))
 	return &htab->entries[index];
 
       htab->collisions++;
-      index += hash2;
-      if (index >= size)
-	index -= size;
+      index = (index + 1) & mask;
     }
 }
 
@@ -437,7 +436,7 @@ htab_remove_elt (htab, element)
   void **slot;
 
   slot = htab_find_slot (htab, element, NO_INSERT);
-  if (*slot == EMPTY_ENTRY)
+  if (slot == NULL)
     return;
 
   if (htab->del_f)
@@ -559,6 +558,10 @@ htab_dump (htab, name, dumpfn)
   fclose (f);
 }
 
+/* Restore a table written by htab_dump, putting the elements back
+   where they were, as users refer to them by their index.  The hash
+   values are not dumped, so they are computed again.  */
+
 void
 htab_restore (htab, name, restorefn)
      htab_t htab;
@@ -574,12 +577,12 @@ htab_restore (htab, name, restorefn)
   if (fscanf (f, "size %zd n_elements %zd n_deleted %zd\n",
 	      &size, &n_elements, &n_deleted) != 3)
     abort ();
+  if (size < MIN_SIZE || (size & (size - 1)) != 0)
+    abort ();
   htab_empty (htab);
   free (htab->entries);
-  htab->entries = (void **) calloc (size, sizeof (void *));
-  if (htab->entries == NULL)
+  if (! htab_alloc (htab, size))
     abort ();
-  htab->size = size;
   htab->n_elements = n_elements;
   htab->n_deleted = n_deleted;
   for (i = 0; i < htab->size; ++i)
@@ -599,6 +602,7 @@ htab_restore (htab, name, restorefn)
 	  break;
 	case 'V':
 	  htab->entries [i] = (*restorefn) (f);
+	  htab->hashes [i] = (*htab->hash_f) (htab->entries [i]);
 	  break;
 	default:
 	  abort ();
@@ -24,14 +24,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
    The size of the table is not fixed; if the occupancy of the table
    grows too high the hash table will be expanded.
 
-   The abstract data implementation is based on generalized Algorithm D
-   from Knuth's book "The art of computer programming".  Hash table is
-   expanded by creation of new hash table and transferring elements from
-   the old table to the new table.  */
+   The table is open addressed with linear probing and keeps the hash
+   value of each element, see hashtab.c.  Hash table is expanded by
+   creation of new hash table and transferring elements from the old
+   table to the new table.  */
 
 #ifndef __HASHTAB_H__
 #define __HASHTAB_H__
 
+#include <sys/types.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -80,9 +82,16 @@ struct htab
   /* Table itself.  */
   void **entries;
 
-  /* Current size (in entries) of the hash table */
+  /* Hash values of the entries, stored in the same allocation after
+     them.  */
+  hashval_t *hashes;
+
+  /* Current size (in entries) of the hash table, a power of two.  */
   size_t size;
 
+  /* Shift which turns a 32-bit product into an index into the table.  */
+  unsigned int shift;
+
   /* Current number of elements including also deleted elements */
   size_t n_elements;
 
@@ -124,6 +133,8 @@ extern void    **htab_find_slot_with_hash (htab_t, const void *, hashval_t,
 extern void	htab_clear_slot	(htab_t, void **);
 extern void	htab_remove_elt	(htab_t, void *);
 
+extern int	htab_reserve	(htab_t, size_t);
+
 extern void	htab_traverse	(htab_t, htab_trav, void *);
 
 extern size_t	htab_size	(htab_t);
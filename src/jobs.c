@@ -0,0 +1,227 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <errno.h>
+#include <error.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "prelink.h"
+
+/* Seconds between progress reports with --verbose.  */
+#define JOBS_PROGRESS_INTERVAL	5
+
+struct jobs_result
+{
+  size_t item;
+  char failed;
+};
+
+static double
+jobs_time (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+jobs_report (const char *what, size_t done, size_t nitems, double start,
+	     int final)
+{
+  double elapsed = jobs_time () - start;
+
+  if (! final)
+    printf ("%s: %zu of %zu objects done\n", what, done, nitems);
+  else if (elapsed > 0)
+    printf ("%s: %zu objects in %.2f seconds, %.1f objects per second\n",
+	    what, nitems, elapsed, nitems / elapsed);
+  else
+    printf ("%s: %zu objects\n", what, nitems);
+  fflush (stdout);
+}
+
+static int
+jobs_count (size_t nitems)
+{
+  long n = jobs;
+
+  if (n <= 0)
+    n = sysconf (_SC_NPROCESSORS_ONLN);
+  if (n > (long) nitems)
+    n = nitems;
+  return n < 1 ? 1 : n;
+}
+
+/* Call FN on items 0 to NITEMS - 1 with DATA and return the number
+   of calls which failed.  If DONE is not NULL, it is called in the
+   parent process with each item and whether it failed, as soon as
+   the item is finished.  The items have no dependencies on each other,
+   so with --jobs they are handed out to forked worker processes one at
+   a time through a counter in shared memory.  Workers are processes
+   rather than threads, as neither prelink's own global state nor
+   libelf are safe to use from multiple threads.  Each worker reports
+   every finished item through a pipe, which lets the parent count
+   failures and print progress, and also notice items lost to a worker
+   which died.  Anything FN changes in memory is lost
+   in the parallel case.  */
+
+int
+run_jobs (size_t nitems, int (*fn) (size_t, void *),
+	  void (*done_fn) (size_t, int, void *), void *data, const char *what)
+{
+  size_t *next, done = 0, i;
+  int nworkers = jobs_count (nitems), failures = 0, pipefd[2], n;
+  double start = jobs_time (), last = start;
+  struct jobs_result buf[64];
+  ssize_t len;
+  pid_t pid;
+
+  if (nworkers == 1)
+    {
+      for (i = 0; i < nitems; ++i)
+	{
+	  int failed = fn (i, data) != 0;
+
+	  failures += failed;
+	  if (done_fn)
+	    done_fn (i, failed, data);
+	  if (verbose && jobs_time () - last >= JOBS_PROGRESS_INTERVAL)
+	    {
+	      jobs_report (what, i + 1, nitems, start, 0);
+	      last = jobs_time ();
+	    }
+	}
+      if (verbose)
+	jobs_report (what, nitems, nitems, start, 1);
+      return failures;
+    }
+
+  next = mmap (NULL, sizeof (size_t), PROT_READ | PROT_WRITE,
+	       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (next == MAP_FAILED)
+    {
+      error (0, errno, "Could not create shared memory for %s workers",
+	     what);
+      return nitems;
+    }
+  *next = 0;
+
+  if (pipe (pipefd) < 0)
+    {
+      error (0, errno, "Could not create pipe for %s workers", what);
+      munmap (next, sizeof (size_t));
+      return nitems;
+    }
+
+  /* Don't let the workers output what is still buffered.  */
+  fflush (stdout);
+  fflush (stderr);
+
+  for (n = 0; n < nworkers; ++n)
+    {
+      pid = fork ();
+      if (pid < 0)
+	{
+	  error (0, errno, "Could not start %s worker", what);
+	  break;
+	}
+      if (pid == 0)
+	{
+	  close (pipefd[0]);
+	  while ((i = __sync_fetch_and_add (next, 1)) < nitems)
+	    {
+	      struct jobs_result r;
+
+	      memset (&r, 0, sizeof (r));
+	      r.item = i;
+	      r.failed = fn (i, data) != 0;
+	      fflush (stdout);
+	      fflush (stderr);
+	      /* Writes this small are atomic, so the results of different
+		 workers can't get mixed up.  */
+	      if (write (pipefd[1], &r, sizeof (r)) != sizeof (r))
+		_exit (1);
+	    }
+	  _exit (0);
+	}
+    }
+  close (pipefd[1]);
+
+  /* If not even one worker could be started, nobody will take
+     the items and the read below sees end of file right away.  */
+  while ((len = read (pipefd[0], buf, sizeof (buf))) != 0)
+    {
+      if (len < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  error (0, errno, "Could not read from %s workers", what);
+	  break;
+	}
+      if (len % sizeof (buf[0]))
+	{
+	  error (0, 0, "Short read from %s workers", what);
+	  break;
+	}
+      for (i = 0; i < len / sizeof (buf[0]); ++i)
+	{
+	  failures += buf[i].failed;
+	  if (done_fn)
+	    done_fn (buf[i].item, buf[i].failed, data);
+	}
+      done += len / sizeof (buf[0]);
+      if (verbose && jobs_time () - last >= JOBS_PROGRESS_INTERVAL)
+	{
+	  jobs_report (what, done, nitems, start, 0);
+	  last = jobs_time ();
+	}
+    }
+  close (pipefd[0]);
+
+  while (n > 0)
+    {
+      int status;
+
+      pid = wait (&status);
+      if (pid < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  break;
+	}
+      if (! WIFEXITED (status) || WEXITSTATUS (status))
+	error (0, 0, "%s worker %d terminated abnormally", what, (int) pid);
+      --n;
+    }
+  munmap (next, sizeof (size_t));
+
+  if (done < nitems)
+    {
+      error (0, 0, "%s: %zu objects were not processed", what,
+	     nitems - done);
+      failures += nitems - done;
+    }
+  if (verbose)
+    jobs_report (what, nitems, nitems, start, 1);
+  return failures;
+}
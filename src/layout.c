@@ -30,6 +30,9 @@
 # define DEBUG_LAYOUT
 #endif
 
+/* Alignment of hot libraries.  */
+#define HUGE_PAGE_SIZE	0x200000
+
 #ifdef DEBUG_LAYOUT
 void
 print_ent (struct prelink_entry *e)
@@ -204,6 +207,680 @@ int deps_cmp (const void *A, const void *B)
   return 0;
 }
 
+/* Insert ENT into the address sorted double linked list *PLIST.
+   E is the first entry with base above ENT's base if known,
+   otherwise NULL.  */
+static void
+list_insert (struct prelink_entry **plist, struct prelink_entry *ent,
+	     struct prelink_entry *e)
+{
+  struct prelink_entry *list = *plist;
+
+  if (list == NULL)
+    {
+      ent->next = NULL;
+      ent->prev = ent;
+      *plist = ent;
+      return;
+    }
+
+  if (e == NULL)
+    e = list->prev;
+  else
+    e = e->prev;
+  while (e != list && e->base > ent->base)
+    e = e->prev;
+  if (e->base > ent->base)
+    {
+      ent->next = list;
+      ent->prev = list->prev;
+      list->prev = ent;
+      *plist = ent;
+    }
+  else
+    {
+      ent->next = e->next;
+      ent->prev = e;
+      if (e->next)
+	e->next->prev = ent;
+      else
+	list->prev = ent;
+      e->next = ent;
+    }
+}
+
+/* Index of the occupied VA slots, kept alongside the address sorted
+   double linked list.  It is a treap ordered by base address, where
+   each node caches the lowest base, highest layend and the largest
+   hole between consecutive slots in its subtree, so that the first
+   slot big enough for a library can be found without walking
+   the whole list.  It is not used with -m, where the holes a library
+   can use depend on which libraries it appears together with, and
+   the list is walked instead.  */
+struct layout_node
+{
+  struct prelink_entry *ent;
+  GElf_Addr min_base, max_layend, max_gap;
+  unsigned int prio;
+  int left, right;
+};
+
+struct layout_tree
+{
+  struct layout_node *nodes;
+  int root, nnodes, alloced;
+  unsigned int seed;
+};
+
+static void
+layout_tree_update (struct layout_tree *t, int n)
+{
+  struct layout_node *x = &t->nodes[n], *y;
+  GElf_Addr end = x->ent->layend;
+
+  x->min_base = x->ent->base;
+  x->max_gap = 0;
+  if (x->left != -1)
+    {
+      y = &t->nodes[x->left];
+      x->min_base = y->min_base;
+      x->max_gap = y->max_gap;
+      if (x->ent->base > y->max_layend
+	  && x->ent->base - y->max_layend > x->max_gap)
+	x->max_gap = x->ent->base - y->max_layend;
+      if (y->max_layend > end)
+	end = y->max_layend;
+    }
+  if (x->right != -1)
+    {
+      y = &t->nodes[x->right];
+      if (y->max_gap > x->max_gap)
+	x->max_gap = y->max_gap;
+      if (y->min_base > end && y->min_base - end > x->max_gap)
+	x->max_gap = y->min_base - end;
+      if (y->max_layend > end)
+	end = y->max_layend;
+    }
+  x->max_layend = end;
+}
+
+static int
+layout_tree_insert_1 (struct layout_tree *t, int root, int n)
+{
+  struct layout_node *x, *y;
+  int child;
+
+  if (root == -1)
+    return n;
+
+  x = &t->nodes[root];
+  if (t->nodes[n].ent->base < x->ent->base)
+    {
+      child = layout_tree_insert_1 (t, x->left, n);
+      x->left = child;
+      y = &t->nodes[child];
+      if (y->prio > x->prio)
+	{
+	  /* Rotate right.  */
+	  x->left = y->right;
+	  y->right = root;
+	  layout_tree_update (t, root);
+	  root = child;
+	}
+    }
+  else
+    {
+      child = layout_tree_insert_1 (t, x->right, n);
+      x->right = child;
+      y = &t->nodes[child];
+      if (y->prio > x->prio)
+	{
+	  /* Rotate left.  */
+	  x->right = y->left;
+	  y->left = root;
+	  layout_tree_update (t, root);
+	  root = child;
+	}
+    }
+  layout_tree_update (t, root);
+  return root;
+}
+
+static void
+layout_tree_insert (struct layout_tree *t, struct prelink_entry *e)
+{
+  struct layout_node *x;
+
+  if (t->nnodes == t->alloced)
+    {
+      t->alloced = t->alloced ? 2 * t->alloced : 64;
+      t->nodes = realloc (t->nodes, t->alloced * sizeof (struct layout_node));
+      if (t->nodes == NULL)
+	error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+    }
+
+  /* Deterministic xorshift priorities, so that the layout does
+     not depend on anything but the input.  */
+  t->seed ^= t->seed << 13;
+  t->seed ^= t->seed >> 17;
+  t->seed ^= t->seed << 5;
+  x = &t->nodes[t->nnodes];
+  x->ent = e;
+  x->prio = t->seed;
+  x->left = -1;
+  x->right = -1;
+  layout_tree_update (t, t->nnodes);
+  t->root = layout_tree_insert_1 (t, t->root, t->nnodes);
+  t->nnodes++;
+}
+
+/* Return non-zero if any slot in the subtree N overlaps
+   <LO, HI).  */
+static int
+layout_tree_overlaps (struct layout_tree *t, int n, GElf_Addr lo,
+		      GElf_Addr hi)
+{
+  struct layout_node *x;
+
+  if (n == -1)
+    return 0;
+
+  x = &t->nodes[n];
+  if (x->min_base >= hi || x->max_layend <= lo)
+    return 0;
+  if (x->ent->base < hi && x->ent->layend > lo)
+    return 1;
+  return layout_tree_overlaps (t, x->left, lo, hi)
+	 || layout_tree_overlaps (t, x->right, lo, hi);
+}
+
+/* Find the first slot in address order for which a library of SIZE
+   bytes fits below its base, when starting the search at *CUR.
+   This gives the same answer as walking the address sorted list
+   from the start.  On return *CUR is the lowest address where
+   the library could be placed.  */
+static struct prelink_entry *
+layout_tree_first_fit (struct layout_tree *t, int n, GElf_Addr size,
+		       GElf_Addr *cur)
+{
+  struct layout_node *x;
+  struct prelink_entry *e;
+
+  if (n == -1)
+    return NULL;
+
+  x = &t->nodes[n];
+  if (*cur + size > x->min_base && x->max_gap < size)
+    {
+      /* No hole in this subtree is big enough.  */
+      if (x->max_layend > *cur)
+	*cur = x->max_layend;
+      return NULL;
+    }
+
+  e = layout_tree_first_fit (t, x->left, size, cur);
+  if (e != NULL)
+    return e;
+
+  if (*cur + size <= x->ent->base)
+    return x->ent;
+
+  if (*cur < x->ent->layend)
+    *cur = x->ent->layend;
+
+  return layout_tree_first_fit (t, x->right, size, cur);
+}
+
+/* Decide which of the already prelinked libraries that overlap
+   in some binary have to be moved, one overlapping pair at a time,
+   keeping the more widely used library.  */
+static void
+evict_overlaps (struct layout_libs *l, struct prelink_entry **deps)
+{
+  int i, j, k;
+
+  for (i = 0; i < l->nbinlibs; ++i)
+    {
+      for (j = 0, k = 0; j < l->binlibs[i]->ndepends; ++j)
+	if (l->binlibs[i]->depends[j]->type == ET_DYN
+	    && l->binlibs[i]->depends[j]->done)
+	  deps[k++] = l->binlibs[i]->depends[j];
+      if (k)
+	{
+	  qsort (deps, k, sizeof (struct prelink_entry *), deps_cmp);
+	  for (j = 1; j < k; ++j)
+	    if (deps[j]->base < deps[j - 1]->end
+		&& (deps[j]->type == ET_DYN
+		    || deps[j - 1]->type == ET_DYN))
+	      {
+		if (deps[j - 1]->refs < deps[j]->refs)
+		  --j;
+		deps[j]->done = 0;
+		--k;
+		memmove (deps + j, deps + j + 1, (k - j) * sizeof (*deps));
+		if (j > 0)
+		  --j;
+	      }
+	}
+    }
+}
+
+/* For --stable-layout, decide which of the already prelinked libraries
+   that overlap in some binary have to be moved.  Instead of resolving
+   each overlapping pair on its own, repeatedly move the library
+   involved in most of the remaining overlaps, and among those the one
+   with fewest dependents, which gives close to the smallest set
+   of libraries whose base changes.  */
+static void
+stable_evict (struct layout_libs *l, struct prelink_entry **deps)
+{
+  struct prelink_entry **pairs = NULL, *e;
+  size_t npairs = 0, apairs = 0, n, left;
+  int i, j, k, p;
+
+  for (i = 0; i < l->nbinlibs; ++i)
+    {
+      for (j = 0, k = 0; j < l->binlibs[i]->ndepends; ++j)
+	if (l->binlibs[i]->depends[j]->type == ET_DYN
+	    && l->binlibs[i]->depends[j]->done)
+	  deps[k++] = l->binlibs[i]->depends[j];
+      if (k < 2)
+	continue;
+      qsort (deps, k, sizeof (struct prelink_entry *), deps_cmp);
+      for (j = 1; j < k; ++j)
+	for (p = 0; p < j; ++p)
+	  if (deps[j]->base < deps[p]->end)
+	    {
+	      if (npairs == apairs)
+		{
+		  apairs = apairs ? 2 * apairs : 64;
+		  pairs = (struct prelink_entry **)
+			  realloc (pairs, 2 * apairs * sizeof (*pairs));
+		  if (pairs == NULL)
+		    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+		}
+	      pairs[2 * npairs] = deps[p];
+	      pairs[2 * npairs + 1] = deps[j];
+	      ++npairs;
+	    }
+    }
+
+  for (left = npairs; left; )
+    {
+      for (n = 0; n < npairs; ++n)
+	{
+	  pairs[2 * n]->u.tmp = 0;
+	  pairs[2 * n + 1]->u.tmp = 0;
+	}
+      for (n = 0; n < npairs; ++n)
+	if (pairs[2 * n]->done && pairs[2 * n + 1]->done)
+	  {
+	    ++pairs[2 * n]->u.tmp;
+	    ++pairs[2 * n + 1]->u.tmp;
+	  }
+      e = NULL;
+      for (n = 0; n < 2 * npairs; ++n)
+	if (pairs[n]->done
+	    && (e == NULL
+		|| pairs[n]->u.tmp > e->u.tmp
+		|| (pairs[n]->u.tmp == e->u.tmp && pairs[n]->refs < e->refs)))
+	  e = pairs[n];
+      if (e == NULL || e->u.tmp == 0)
+	break;
+      e->done = 0;
+      left -= e->u.tmp;
+    }
+
+  for (n = 0; n < 2 * npairs; ++n)
+    pairs[n]->u.tmp = -1;
+  free (pairs);
+}
+
+/* Record for each library in L->libs which binaries depend on it,
+   so that finding libraries which ever appear together with it
+   doesn't need to scan all dependencies of all binaries.
+   Binaries depending on L->libs[i] are
+   L->binlibs[(*PUSERS)[(*PNUSERS)[i] ... (*PNUSERS)[i + 1] - 1]].  */
+static void
+find_users (struct layout_libs *l, int **pusers, int **pnusers)
+{
+  int i, j, k, *users, *nusers;
+
+  nusers = (int *) calloc (l->nlibs + 1, sizeof (int));
+  if (nusers == NULL)
+    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+  for (j = 0; j < l->nbinlibs; ++j)
+    for (k = 0; k < l->binlibs[j]->ndepends; ++k)
+      l->binlibs[j]->depends[k]->u.tmp = -1;
+  for (i = 0; i < l->nlibs; ++i)
+    l->libs[i]->u.tmp = i;
+  for (j = 0; j < l->nbinlibs; ++j)
+    for (k = 0; k < l->binlibs[j]->ndepends; ++k)
+      if (l->binlibs[j]->depends[k]->u.tmp != -1)
+	++nusers[l->binlibs[j]->depends[k]->u.tmp + 1];
+  for (i = 0; i < l->nlibs; ++i)
+    nusers[i + 1] += nusers[i];
+  users = (int *) malloc ((nusers[l->nlibs] + 1) * sizeof (int));
+  if (users == NULL)
+    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+  for (j = 0; j < l->nbinlibs; ++j)
+    for (k = 0; k < l->binlibs[j]->ndepends; ++k)
+      if (l->binlibs[j]->depends[k]->u.tmp != -1)
+	users[nusers[l->binlibs[j]->depends[k]->u.tmp]++] = j;
+  for (i = l->nlibs; i > 0; --i)
+    nusers[i] = nusers[i - 1];
+  nusers[0] = 0;
+  for (i = 0; i < l->nlibs; ++i)
+    l->libs[i]->u.tmp = -1;
+  *pusers = users;
+  *pnusers = nusers;
+}
+
+struct coloring_weight
+{
+  struct prelink_entry *ent;
+  GElf_Addr weight;
+  int idx;
+};
+
+static int
+coloring_cmp (const void *A, const void *B)
+{
+  const struct coloring_weight *a = (const struct coloring_weight *) A;
+  const struct coloring_weight *b = (const struct coloring_weight *) B;
+
+  /* Dynamic linkers first.  */
+  if (! a->ent->ndepends && b->ent->ndepends)
+    return -1;
+  if (a->ent->ndepends && ! b->ent->ndepends)
+    return 1;
+  /* Libraries in the most crowded address spaces first.  */
+  if (a->weight > b->weight)
+    return -1;
+  if (a->weight < b->weight)
+    return 1;
+  return a->idx - b->idx;
+}
+
+/* Order libraries for -m --layout-coloring.  Two libraries interfere
+   if some binary depends on both of them, and each library needs
+   an address range disjoint from all libraries it interferes with.
+   Color the libraries in decreasing order of the total size of
+   the libraries they interfere with (including themselves), which
+   is a lower bound of the address space needed for them, so that
+   the most constrained ones are packed first.  */
+static void
+coloring_order (struct layout_libs *l, int *users, int *nusers)
+{
+  struct coloring_weight *w;
+  struct prelink_entry *d;
+  int i, j, k, stamp;
+
+  w = (struct coloring_weight *)
+      malloc (l->nlibs * sizeof (struct coloring_weight));
+  if (w == NULL)
+    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+
+  for (i = 0; i < l->nlibs; ++i)
+    {
+      w[i].ent = l->libs[i];
+      w[i].idx = i;
+      w[i].weight = l->libs[i]->layend - l->libs[i]->base;
+      /* Use stamps which can't collide with library indexes used
+	 as u.tmp marks during placement.  */
+      stamp = l->nlibs + i;
+      l->libs[i]->u.tmp = stamp;
+      for (j = nusers[i]; j < nusers[i + 1]; ++j)
+	for (k = 0; k < l->binlibs[users[j]]->ndepends; ++k)
+	  {
+	    d = l->binlibs[users[j]]->depends[k];
+	    if (d->u.tmp == stamp)
+	      continue;
+	    d->u.tmp = stamp;
+	    if (d->type == ET_DYN || d->type == ET_CACHE_DYN)
+	      w[i].weight += d->layend - d->base;
+	  }
+    }
+
+  qsort (w, l->nlibs, sizeof (struct coloring_weight), coloring_cmp);
+  for (i = 0; i < l->nlibs; ++i)
+    l->libs[i] = w[i].ent;
+  free (w);
+}
+
+/* Order libraries for --layout-cluster, so that libraries which are
+   used together end up next to each other.  Greedily build a linear
+   arrangement, always appending the library used together with the
+   last appended one by most binaries, then the one used together
+   with the libraries arranged so far by most binaries.  If no
+   remaining library is used together with any of them, continue with
+   the next one in the original order.  */
+static void
+cluster_order (struct layout_libs *l, int *users, int *nusers)
+{
+  struct prelink_entry **order, *d;
+  int *last, *aff, *frontier;
+  char *placed;
+  int i, j, k, n, x, best, nfrontier = 0, next = 0;
+
+  order = (struct prelink_entry **)
+	  malloc (l->nlibs * sizeof (struct prelink_entry *));
+  last = (int *) calloc (l->nlibs, sizeof (int));
+  aff = (int *) calloc (l->nlibs, sizeof (int));
+  frontier = (int *) malloc (l->nlibs * sizeof (int));
+  placed = (char *) calloc (l->nlibs, 1);
+  if (order == NULL || last == NULL || aff == NULL || frontier == NULL
+      || placed == NULL)
+    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+
+  for (j = 0; j < l->nbinlibs; ++j)
+    for (k = 0; k < l->binlibs[j]->ndepends; ++k)
+      l->binlibs[j]->depends[k]->u.tmp = -1;
+  for (i = 0; i < l->nlibs; ++i)
+    l->libs[i]->u.tmp = i;
+
+  for (n = 0; n < l->nlibs; ++n)
+    {
+      /* Pick the next library.  */
+      best = -1;
+      for (i = 0; i < nfrontier; ++i)
+	{
+	  x = frontier[i];
+	  if (best == -1
+	      || last[x] > last[best]
+	      || (last[x] == last[best]
+		  && (aff[x] > aff[best]
+		      || (aff[x] == aff[best] && x < best))))
+	    best = x;
+	}
+      if (best == -1)
+	{
+	  while (placed[next])
+	    ++next;
+	  best = next;
+	}
+      else
+	for (i = 0; i < nfrontier; ++i)
+	  if (frontier[i] == best)
+	    {
+	      frontier[i] = frontier[--nfrontier];
+	      break;
+	    }
+      placed[best] = 1;
+      order[n] = l->libs[best];
+
+      /* Recompute co-usage with the last arranged library.  */
+      for (i = 0; i < nfrontier; ++i)
+	last[frontier[i]] = 0;
+      for (j = nusers[best]; j < nusers[best + 1]; ++j)
+	for (k = 0; k < l->binlibs[users[j]]->ndepends; ++k)
+	  {
+	    d = l->binlibs[users[j]]->depends[k];
+	    x = d->u.tmp;
+	    if (x == -1 || placed[x])
+	      continue;
+	    if (aff[x]++ == 0)
+	      frontier[nfrontier++] = x;
+	    ++last[x];
+	  }
+    }
+
+  memcpy (l->libs, order, l->nlibs * sizeof (struct prelink_entry *));
+  for (i = 0; i < l->nlibs; ++i)
+    l->libs[i]->u.tmp = -1;
+  free (order);
+  free (last);
+  free (aff);
+  free (frontier);
+  free (placed);
+}
+
+/* Names of libraries listed in the --hot-libs file.  */
+static char **hot_names;
+static int hot_nnames = -1;
+
+static void
+read_hot_libs (void)
+{
+  FILE *file;
+  char *line = NULL, *p;
+  size_t len = 0;
+  ssize_t n;
+  int alloced = 0;
+
+  hot_nnames = 0;
+  if (hot_libs == NULL)
+    return;
+
+  file = fopen (hot_libs, "r");
+  if (file == NULL)
+    error (EXIT_FAILURE, errno, "Can't open hot libraries list %s",
+	   hot_libs);
+
+  while ((n = getline (&line, &len, file)) >= 0)
+    {
+      if (n && line[n - 1] == '\n')
+	line[n - 1] = '\0';
+      p = strchr (line, '#');
+      if (p != NULL)
+	*p = '\0';
+      p = line + strspn (line, " \t");
+      p[strcspn (p, " \t")] = '\0';
+      if (*p == '\0')
+	continue;
+      if (hot_nnames == alloced)
+	{
+	  alloced = alloced ? 2 * alloced : 64;
+	  hot_names = (char **) realloc (hot_names, alloced * sizeof (char *));
+	  if (hot_names == NULL)
+	    error (EXIT_FAILURE, ENOMEM, "Cannot read hot libraries list");
+	}
+      hot_names[hot_nnames] = strdup (p);
+      if (hot_names[hot_nnames] == NULL)
+	error (EXIT_FAILURE, ENOMEM, "Cannot read hot libraries list");
+      ++hot_nnames;
+    }
+
+  free (line);
+  fclose (file);
+}
+
+struct hot_key
+{
+  struct prelink_entry *ent;
+  int key, idx;
+};
+
+static int
+hot_cmp (const void *A, const void *B)
+{
+  const struct hot_key *a = (const struct hot_key *) A;
+  const struct hot_key *b = (const struct hot_key *) B;
+
+  if (a->key != b->key)
+    return a->key - b->key;
+  return a->idx - b->idx;
+}
+
+/* Move libraries which should be laid out on huge page boundaries,
+   i.e. those listed in --hot-libs file and the --hot-libs-count
+   most widely used ones, to the start of L->libs and set HOT
+   for them.  Hot libraries from the list are kept in the list order,
+   the others in the order in which they are loaded, i.e. by their
+   earliest position in the dependency lists of binaries.
+   Return the number of hot libraries.  */
+static int
+hot_order (struct layout_libs *l, char *hot)
+{
+  struct hot_key *h;
+  struct prelink_entry *e, **tmp;
+  int i, j, k, nhot = 0;
+
+  if (hot_nnames == -1)
+    read_hot_libs ();
+
+  h = (struct hot_key *) malloc (l->nlibs * sizeof (struct hot_key));
+  tmp = (struct prelink_entry **)
+	malloc (l->nlibs * sizeof (struct prelink_entry *));
+  if (h == NULL || tmp == NULL)
+    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+
+  for (i = 0; i < l->nlibs; ++i)
+    l->libs[i]->u.tmp = -1;
+  if (hot_libs_count)
+    {
+      memcpy (tmp, l->libs, l->nlibs * sizeof (struct prelink_entry *));
+      qsort (tmp, l->nlibs, sizeof (struct prelink_entry *), refs_cmp);
+      for (i = 0; i < l->nlibs && i < hot_libs_count; ++i)
+	tmp[i]->u.tmp = hot_nnames + l->nlibs;
+    }
+  free (tmp);
+
+  for (i = 0; i < l->nlibs; ++i)
+    {
+      e = l->libs[i];
+      for (j = 0; j < hot_nnames; ++j)
+	if (strcmp (hot_names[j], e->filename) == 0
+	    || strcmp (hot_names[j], e->canon_filename) == 0
+	    || (e->soname && strcmp (hot_names[j], e->soname) == 0))
+	  {
+	    e->u.tmp = j;
+	    break;
+	  }
+    }
+
+  for (i = 0; i < l->nbinlibs; ++i)
+    for (k = 0; k < l->binlibs[i]->ndepends; ++k)
+      {
+	e = l->binlibs[i]->depends[k];
+	if (e->u.tmp > hot_nnames + k)
+	  e->u.tmp = hot_nnames + k;
+      }
+
+  for (i = 0; i < l->nlibs; ++i)
+    if (l->libs[i]->u.tmp != -1)
+      {
+	h[nhot].ent = l->libs[i];
+	h[nhot].key = l->libs[i]->u.tmp;
+	h[nhot].idx = i;
+	++nhot;
+      }
+  qsort (h, nhot, sizeof (struct hot_key), hot_cmp);
+
+  for (i = 0, j = nhot; i < l->nlibs; ++i)
+    if (l->libs[i]->u.tmp == -1)
+      h[j++].ent = l->libs[i];
+  for (i = 0; i < l->nlibs; ++i)
+    {
+      l->libs[i] = h[i].ent;
+      l->libs[i]->u.tmp = -1;
+      hot[i] = i < nhot;
+    }
+
+  free (h);
+  return nhot;
+}
+
 int
 layout_libs (void)
 {
@@ -230,10 +907,13 @@ layout_libs (void)
       extern struct PLArch __start_pl_arch[], __stop_pl_arch[];
       int i, j, k, m, done, class;
       GElf_Addr mmap_start, mmap_base, mmap_end, mmap_fin, max_page_size;
-      GElf_Addr base, size;
-      struct prelink_entry *list, *e, *fake, **deps;
+      GElf_Addr base, size, bestbase = 0, bestgap = 0, *oldbase;
+      char *hot;
+      int nhot;
+      struct prelink_entry *list, *e, *fake, **deps, *best;
       struct prelink_entry fakeent;
-      int fakecnt;
+      struct layout_tree tree;
+      int fakecnt, *users, *nusers;
       int (*layout_libs_pre) (struct layout_libs *l);
       int (*layout_libs_post) (struct layout_libs *l);
 
@@ -294,33 +974,14 @@ layout_libs (void)
 
       deps = (struct prelink_entry **)
 	     alloca (l.nlibs * sizeof (struct prelink_entry *));
+      oldbase = (GElf_Addr *) alloca (l.nlibs * sizeof (GElf_Addr));
 
       /* Now see which already prelinked libraries have to be
 	 re-prelinked to avoid overlaps.  */
-      for (i = 0; i < l.nbinlibs; ++i)
-	{
-	  for (j = 0, k = 0; j < l.binlibs[i]->ndepends; ++j)
-	    if (l.binlibs[i]->depends[j]->type == ET_DYN
-		&& l.binlibs[i]->depends[j]->done)
-	      deps[k++] = l.binlibs[i]->depends[j];
-	  if (k)
-	    {
-	      qsort (deps, k, sizeof (struct prelink_entry *), deps_cmp);
-	      for (j = 1; j < k; ++j)
-		if (deps[j]->base < deps[j - 1]->end
-		    && (deps[j]->type == ET_DYN
-			|| deps[j - 1]->type == ET_DYN))
-		  {
-		    if (deps[j - 1]->refs < deps[j]->refs)
-		      --j;
-		    deps[j]->done = 0;
-		    --k;
-		    memmove (deps + j, deps + j + 1, (k - j) * sizeof (*deps));
-		    if (j > 0)
-		      --j;
-		  }
-	    }
-	}
+      if (stable_layout)
+	stable_evict (&l, deps);
+      else
+	evict_overlaps (&l, deps);
 
       /* If layout_libs_init or the for cycle above cleared
 	 done flags for some libraries, make sure all libraries
@@ -488,44 +1149,166 @@ layout_libs (void)
 	  mmap_fin = mmap_end + (mmap_start - mmap_base);
 	}
 
+      users = NULL;
+      nusers = NULL;
+      memset (&tree, 0, sizeof (tree));
+      tree.root = -1;
+      tree.seed = 0x9e3779b9;
+      if (conserve_memory && layout_coloring)
+	{
+	  find_users (&l, &users, &nusers);
+	  coloring_order (&l, users, nusers);
+	  free (users);
+	  free (nusers);
+	}
+      else if (layout_cluster)
+	{
+	  find_users (&l, &users, &nusers);
+	  cluster_order (&l, users, nusers);
+	  free (users);
+	  free (nusers);
+	  users = NULL;
+	  nusers = NULL;
+	}
+
+      /* Huge page alignment of hot libraries would be lost if
+	 the VA space is remapped.  */
+      hot = (char *) alloca (l.nlibs);
+      memset (hot, 0, l.nlibs);
+      nhot = 0;
+      if ((hot_libs || hot_libs_count) && fakecnt == 0
+	  && max_page_size <= HUGE_PAGE_SIZE)
+	{
+	  nhot = hot_order (&l, hot);
+	  if (verbose && nhot)
+	    printf ("Laying out %d hot libraries on 0x%x boundaries\n",
+		    nhot, HUGE_PAGE_SIZE);
+	}
+
+      if (conserve_memory)
+	find_users (&l, &users, &nusers);
+      else
+	for (e = list; e; e = e->next)
+	  layout_tree_insert (&tree, e);
+
       for (i = 0; i < l.nlibs; ++i)
-	l.libs[i]->u.tmp = -1;
+	{
+	  l.libs[i]->u.tmp = -1;
+	  oldbase[i] = l.libs[i]->base;
+	}
       m = -1;
 
+      /* With --stable-layout, first let libraries which need to be
+	 re-prelinked keep their current slot if it is still free.
+	 This is not possible if the VA space has been remapped.  */
+      if (stable_layout && fakecnt == 0 && mmap_start == mmap_base)
+	for (i = 0; i < l.nlibs; ++i)
+	  if (! l.libs[i]->done)
+	    {
+	      base = l.libs[i]->base;
+	      size = l.libs[i]->layend - base;
+	      if (base == 0 || base < mmap_base || base + size > mmap_end
+		  || (hot[i] && (base & (HUGE_PAGE_SIZE - 1))))
+		continue;
+	      if (conserve_memory)
+		{
+		  m = i;
+		  for (j = nusers[i]; j < nusers[i + 1]; ++j)
+		    for (k = 0; k < l.binlibs[users[j]]->ndepends; ++k)
+		      l.binlibs[users[j]]->depends[k]->u.tmp = m;
+		  for (e = list; e; e = e->next)
+		    if (e->u.tmp == m && e->base < base + size
+			&& e->layend > base)
+		      break;
+		  if (e != NULL)
+		    continue;
+		}
+	      else if (layout_tree_overlaps (&tree, tree.root, base,
+					     base + size))
+		continue;
+	      l.libs[i]->done = 1;
+	      list_insert (&list, l.libs[i], NULL);
+	      if (! conserve_memory)
+		layout_tree_insert (&tree, l.libs[i]);
+	    }
+
       for (i = 0; i < l.nlibs; ++i)
 	if (! l.libs[i]->done)
 	  {
-	    if (conserve_memory)
+	    size = l.libs[i]->layend - l.libs[i]->base;
+	    base = mmap_start;
+	    if (hot[i])
+	      {
+		/* Put hot libraries on huge page boundaries, so that
+		   their text can be backed by transparent huge pages.
+		   Pad them to whole huge pages, so that consecutive
+		   hot libraries are packed together.  */
+		size = (size + HUGE_PAGE_SIZE - 1) & ~(GElf_Addr) (HUGE_PAGE_SIZE - 1);
+		if (conserve_memory)
+		  {
+		    m = i;
+		    for (j = nusers[i]; j < nusers[i + 1]; ++j)
+		      for (k = 0; k < l.binlibs[users[j]]->ndepends; ++k)
+			l.binlibs[users[j]]->depends[k]->u.tmp = m;
+		  }
+		base = (base + HUGE_PAGE_SIZE - 1) & ~(GElf_Addr) (HUGE_PAGE_SIZE - 1);
+		for (e = list; e; e = e->next)
+		  if (e->u.tmp == m)
+		    {
+		      if (base + size <= e->base)
+			goto found;
+
+		      if (base < e->layend)
+			base = (e->layend + HUGE_PAGE_SIZE - 1)
+			       & ~(GElf_Addr) (HUGE_PAGE_SIZE - 1);
+		    }
+	      }
+	    else if (conserve_memory)
 	      {
 		/* If conserving virtual address space, only consider libraries
 		   which ever appear together with this one.  Otherwise consider
 		   all libraries.  */
 		m = i;
-		for (j = 0; j < l.nbinlibs; ++j)
-		  {
-		    for (k = 0; k < l.binlibs[j]->ndepends; ++k)
-		      if (l.binlibs[j]->depends[k] == l.libs[i])
-			{
-			  for (k = 0; k < l.binlibs[j]->ndepends; ++k)
-			    l.binlibs[j]->depends[k]->u.tmp = m;
-			  break;
-			}
-		  }
+		for (j = nusers[i]; j < nusers[i + 1]; ++j)
+		  for (k = 0; k < l.binlibs[users[j]]->ndepends; ++k)
+		    l.binlibs[users[j]]->depends[k]->u.tmp = m;
 		for (j = 0; j < fakecnt; ++j)
 		  fake[j].u.tmp = m;
-	      }
 
-	    size = l.libs[i]->layend - l.libs[i]->base;
-	    base = mmap_start;
-	    for (e = list; e; e = e->next)
-	      if (e->u.tmp == m)
-		{
-		  if (base + size <= e->base)
-		    goto found;
+		best = NULL;
+		for (e = list; e; e = e->next)
+		  if (e->u.tmp == m)
+		    {
+		      if (base + size <= e->base)
+			{
+			  if (! layout_coloring)
+			    goto found;
+			  /* Prefer the tightest hole, so that big holes
+			     are left for big libraries.  */
+			  if (best == NULL || e->base - base < bestgap)
+			    {
+			      best = e;
+			      bestbase = base;
+			      bestgap = e->base - base;
+			    }
+			}
 
-		  if (base < e->layend)
-		    base = e->layend;
-		}
+		      if (base < e->layend)
+			base = e->layend;
+		    }
+		if (best != NULL)
+		  {
+		    e = best;
+		    base = bestbase;
+		    goto found;
+		  }
+	      }
+	    else
+	      {
+		e = layout_tree_first_fit (&tree, tree.root, size, &base);
+		if (e != NULL)
+		  goto found;
+	      }
 
 	    if (base + size > mmap_fin)
 	      goto not_found;
@@ -537,37 +1320,9 @@ found:
 	      l.libs[i]->done = done;
 	    else
 	      l.libs[i]->done = 1;
-	    if (list == NULL)
-	      {
-		list = l.libs[i];
-		list->prev = list;
-	      }
-	    else
-	      {
-		if (e == NULL)
-		  e = list->prev;
-		else
-		  e = e->prev;
-		while (e != list && e->base > base)
-		  e = e->prev;
-		if (e->base > base)
-		  {
-		    l.libs[i]->next = list;
-		    l.libs[i]->prev = list->prev;
-		    list->prev = l.libs[i];
-		    list = l.libs[i];
-		  }
-		else
-		  {
-		    l.libs[i]->next = e->next;
-		    l.libs[i]->prev = e;
-		    if (e->next)
-		      e->next->prev = l.libs[i];
-		    else
-		      list->prev = l.libs[i];
-		    e->next = l.libs[i];
-		  }
-	      }
+	    list_insert (&list, l.libs[i], e);
+	    if (! conserve_memory)
+	      layout_tree_insert (&tree, l.libs[i]);
 #ifdef DEBUG_LAYOUT
 	    {
 	      struct prelink_entry *last = list;
@@ -592,6 +1347,10 @@ not_found:
 		   l.libs[i]->filename);
 	  }
 
+      free (tree.nodes);
+      free (users);
+      free (nusers);
+
       if (layout_libs_post)
 	{
 	  l.list = list;
@@ -608,6 +1367,40 @@ not_found:
 	      e->layend -= mmap_base - mmap_base;
 	    }
 
+      if (verbose)
+	{
+	  int moved = 0, nlibs = 0, nbins = 0;
+
+	  for (i = 0; i < l.nlibs; ++i)
+	    if (l.libs[i]->done == 1)
+	      {
+		++nlibs;
+		if (l.libs[i]->base != oldbase[i])
+		  ++moved;
+	      }
+	  /* Binaries which are up to date get prelinked again as well
+	     if any of their libraries is.  */
+	  if (! libs_only)
+	    for (i = 0; i < l.nbinlibs; ++i)
+	      if (l.binlibs[i]->type == ET_EXEC)
+		{
+		  struct prelink_entry *b = l.binlibs[i];
+		  int j;
+
+		  if (b->done == 0)
+		    ++nbins;
+		  else if (b->done == 2)
+		    for (j = 0; j < b->ndepends; ++j)
+		      if (b->depends[j]->done == 1)
+			{
+			  ++nbins;
+			  break;
+			}
+		}
+	  printf ("Predicted %d libraries to be relocated, %d libraries and %d binaries to be prelinked\n",
+		  moved, nlibs, nbins);
+	}
+
       if (verbose)
 	{
 	  if (narches == 1)
@@ -621,6 +1414,23 @@ not_found:
 	      printf ("%-60s %0*llx-%0*llx\n", l.libs[i]->filename,
 		      class == ELFCLASS32 ? 8 : 16, (long long) l.libs[i]->base,
 		      class == ELFCLASS32 ? 8 : 16, (long long) l.libs[i]->end);
+
+	  if (layout_coloring)
+	    {
+	      GElf_Addr lo = ~(GElf_Addr) 0, hi = 0;
+
+	      for (i = 0; i < l.nlibs; ++i)
+		if (l.libs[i]->done >= 1)
+		  {
+		    if (l.libs[i]->base < lo)
+		      lo = l.libs[i]->base;
+		    if (l.libs[i]->layend > hi)
+		      hi = l.libs[i]->layend;
+		  }
+	      if (lo < hi)
+		printf ("Libraries use 0x%llx bytes of virtual address space\n",
+			(long long) (hi - lo));
+	    }
 	}
 
 #ifdef DEBUG_LAYOUT
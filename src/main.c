@@ -40,6 +40,12 @@ GElf_Addr reloc_base;
 int no_update;
 int random_base;
 int conserve_memory;
+int layout_coloring;
+int layout_cluster;
+int explain_conflicts;
+int stable_layout;
+const char *hot_libs;
+int hot_libs_count;
 int libs_only;
 int dry_run;
 int dereference;
@@ -47,6 +53,13 @@ int one_file_system;
 int enable_cxx_optimizations = 1;
 int exec_shield;
 int undo, verify;
+int jobs = 1;
+int defer_debug;
+int compress_undo;
+int fast_verify;
+int apply_debug;
+int rebase_debuginfo;
+const char *debuginfo_dir = "/usr/lib/debug";
 enum verify_method_t verify_method;
 int quick;
 int compute_checksum;
@@ -59,6 +72,10 @@ const char *ld_library_path;
 const char *prelink_conf = PRELINK_CONF;
 const char *prelink_cache = PRELINK_CACHE;
 const char *undo_output;
+static const char *files_from;
+static int digest_benchmark;
+static int hashtab_benchmark;
+static int conflict_benchmark;
 
 const char *argp_program_version = "prelink 1.0";
 
@@ -79,6 +96,24 @@ static char argp_doc[] = "prelink -- program to relocate and prelink ELF shared
 #define OPT_SHA			0x8a
 #define OPT_COMPUTE_CHECKSUM	0x8b
 #define OPT_LAYOUT_PAGE_SIZE	0x8c
+#define OPT_LAYOUT_COLORING	0x8d
+#define OPT_STABLE_LAYOUT	0x8e
+#define OPT_HOT_LIBS		0x8f
+#define OPT_HOT_LIBS_COUNT	0x90
+#define OPT_LAYOUT_CLUSTER	0x91
+#define OPT_EXPLAIN_CONFLICTS	0x92
+#define OPT_DEFER_DEBUG		0x93
+#define OPT_APPLY_DEBUG		0x94
+#define OPT_REBASE_DEBUGINFO	0x95
+#define OPT_DEBUGINFO_DIR	0x96
+#define OPT_COMPRESS_UNDO	0x97
+#define OPT_FILES_FROM		0x98
+#define OPT_SHA256		0x99
+#define OPT_BLAKE3		0x9a
+#define OPT_DIGEST_BENCHMARK	0x9b
+#define OPT_FAST_VERIFY		0x9c
+#define OPT_HASHTAB_BENCHMARK	0x9d
+#define OPT_CONFLICT_BENCHMARK	0x9e
 
 static struct argp_option options[] = {
   {"all",		'a', 0, 0,  "Prelink all binaries" },
@@ -97,10 +132,15 @@ static struct argp_option options[] = {
   {"random",		'R', 0, 0,  "Choose random base for libraries" },
   {"reloc-only",	'r', "BASE_ADDRESS", 0,  "Relocate library to given address, don't prelink" },
   {"undo",		'u', 0, 0,  "Undo prelink" },
+  {"jobs",		'j', "COUNT", 0, "With -u -a or -y, work in COUNT processes, 0 means one per CPU" },
   {"verbose",		'v', 0, 0,  "Produce verbose output" },
   {"verify",		'y', 0, 0,  "Verify file consistency by undoing and redoing prelink and printing original to standard output" },
   {"md5",		OPT_MD5, 0, 0, "For verify print MD5 sum of original to standard output instead of content" },
   {"sha",		OPT_SHA, 0, 0, "For verify print SHA sum of original to standard output instead of content" },
+  {"sha256",		OPT_SHA256, 0, 0, "For verify print SHA-256 sum of original to standard output instead of content" },
+  {"blake3",		OPT_BLAKE3, 0, 0, "For verify print BLAKE3 sum of original to standard output instead of content" },
+  {"fast-verify",	OPT_FAST_VERIFY, 0, 0, "For verify trust DT_CHECKSUM of files whose dependencies did not change instead of prelinking them again" },
+  {"files-from",	OPT_FILES_FROM, "FILE", 0, "For verify read names of libraries and binaries from FILE, one per line" },
   {"dynamic-linker",	OPT_DYNAMIC_LINKER, "DYNAMIC_LINKER",
 				0,  "Special dynamic linker path" },
   {"exec-shield",	OPT_EXEC_SHIELD, 0, 0, "Lay out libraries for exec-shield on IA-32" },
@@ -109,11 +149,25 @@ static struct argp_option options[] = {
 				0,  "What LD_LIBRARY_PATH should be used" },
   {"libs-only",		OPT_LIBS_ONLY, 0, 0, "Prelink only libraries, no binaries" },
   {"layout-page-size",	OPT_LAYOUT_PAGE_SIZE, "SIZE", 0, "Layout start of libraries at given boundary" },
+  {"layout-coloring",	OPT_LAYOUT_COLORING, 0, 0, "With -m, pack libraries to minimize used virtual address space" },
+  {"layout-cluster",	OPT_LAYOUT_CLUSTER, 0, 0, "Lay out libraries used together next to each other" },
+  {"stable-layout",	OPT_STABLE_LAYOUT, 0, 0, "Move as few already prelinked libraries as possible" },
+  {"hot-libs",		OPT_HOT_LIBS, "FILE", 0, "Lay out libraries listed in FILE on huge page boundaries" },
+  {"hot-libs-count",	OPT_HOT_LIBS_COUNT, "COUNT", 0, "Lay out COUNT most widely used libraries on huge page boundaries" },
+  {"explain-conflicts",	OPT_EXPLAIN_CONFLICTS, 0, 0, "Print which symbols cause conflicts in prelinked binaries" },
+  {"defer-debug",	OPT_DEFER_DEBUG, 0, 0, "Record debugging section adjustments in libraries instead of doing them" },
+  {"apply-debug",	OPT_APPLY_DEBUG, 0, 0, "Apply recorded debugging section adjustments" },
+  {"compress-undo",	OPT_COMPRESS_UNDO, 0, 0, "Store .gnu.prelink_undo sections in compressed form" },
+  {"rebase-debuginfo",	OPT_REBASE_DEBUGINFO, 0, 0, "Adjust separate debuginfo files together with their objects" },
+  {"debuginfo-dir",	OPT_DEBUGINFO_DIR, "DIR", 0, "Look for separate debuginfo files in DIR instead of /usr/lib/debug" },
   {"disable-c++-optimizations", OPT_CXX_DISABLE, 0, OPTION_HIDDEN, "" },
   {"mmap-region-start",	OPT_MMAP_REG_START, "BASE_ADDRESS", OPTION_HIDDEN, "" },
   {"mmap-region-end",	OPT_MMAP_REG_END, "BASE_ADDRESS", OPTION_HIDDEN, "" },
   {"seed",		OPT_SEED, "SEED", OPTION_HIDDEN, "" },
   {"compute-checksum",	OPT_COMPUTE_CHECKSUM, 0, OPTION_HIDDEN, "" },
+  {"digest-benchmark",	OPT_DIGEST_BENCHMARK, 0, OPTION_HIDDEN, "" },
+  {"hashtab-benchmark",	OPT_HASHTAB_BENCHMARK, 0, OPTION_HIDDEN, "" },
+  {"conflict-benchmark",	OPT_CONFLICT_BENCHMARK, 0, OPTION_HIDDEN, "" },
   { 0 }
 };
 
@@ -161,6 +215,11 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case 'h':
       dereference = 1;
       break;
+    case 'j':
+      jobs = strtol (arg, &endarg, 0);
+      if (endarg != strchr (arg, '\0') || jobs < 0)
+	error (EXIT_FAILURE, 0, "-j option requires non-negative numeric argument");
+      break;
     case 'l':
       one_file_system = 1;
       break;
@@ -203,6 +262,15 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case OPT_SHA:
       verify_method = VERIFY_SHA;
       break;
+    case OPT_SHA256:
+      verify_method = VERIFY_SHA256;
+      break;
+    case OPT_BLAKE3:
+      verify_method = VERIFY_BLAKE3;
+      break;
+    case OPT_FAST_VERIFY:
+      fast_verify = 1;
+      break;
     case OPT_CXX_DISABLE:
       enable_cxx_optimizations = 0;
       break;
@@ -225,11 +293,59 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case OPT_COMPUTE_CHECKSUM:
       compute_checksum = 1;
       break;
+    case OPT_DIGEST_BENCHMARK:
+      digest_benchmark = 1;
+      break;
+    case OPT_HASHTAB_BENCHMARK:
+      hashtab_benchmark = 1;
+      break;
+    case OPT_CONFLICT_BENCHMARK:
+      conflict_benchmark = 1;
+      break;
     case OPT_LAYOUT_PAGE_SIZE:
       layout_page_size = strtoull (arg, &endarg, 0);
       if (endarg != strchr (arg, '\0') || (layout_page_size & (layout_page_size - 1)))
 	error (EXIT_FAILURE, 0, "--layout-page-size option requires numberic power-of-two argument");
       break;
+    case OPT_LAYOUT_COLORING:
+      conserve_memory = 1;
+      layout_coloring = 1;
+      break;
+    case OPT_LAYOUT_CLUSTER:
+      layout_cluster = 1;
+      break;
+    case OPT_STABLE_LAYOUT:
+      stable_layout = 1;
+      break;
+    case OPT_HOT_LIBS:
+      hot_libs = arg;
+      break;
+    case OPT_HOT_LIBS_COUNT:
+      hot_libs_count = strtoul (arg, &endarg, 0);
+      if (endarg != strchr (arg, '\0') || hot_libs_count < 0)
+	error (EXIT_FAILURE, 0, "--hot-libs-count option requires numberic argument");
+      break;
+    case OPT_EXPLAIN_CONFLICTS:
+      explain_conflicts = 1;
+      break;
+    case OPT_DEFER_DEBUG:
+      defer_debug = 1;
+      break;
+    case OPT_APPLY_DEBUG:
+      apply_debug = 1;
+      break;
+    case OPT_REBASE_DEBUGINFO:
+      rebase_debuginfo = 1;
+      break;
+    case OPT_DEBUGINFO_DIR:
+      debuginfo_dir = arg;
+      break;
+    case OPT_COMPRESS_UNDO:
+      compress_undo = 1;
+      break;
+    case OPT_FILES_FROM:
+      files_from = arg;
+      break;
     default:
       return ARGP_ERR_UNKNOWN;
     }
@@ -238,6 +354,59 @@ parse_opt (int key, char *arg, struct argp_state *state)
 
 static struct argp argp = { options, parse_opt, "[FILES]", argp_doc };
 
+/* Return the NARGS names in ARGS followed by those listed in the
+   --files-from file in *NAMESP and their count.  */
+static size_t
+read_files_from (char **args, int nargs, char ***namesp)
+{
+  char **names = NULL, *line = NULL;
+  size_t nnames = 0, alloced = 0, len = 0;
+  ssize_t n;
+  FILE *file = NULL;
+  int i;
+
+  if (files_from)
+    {
+      file = strcmp (files_from, "-") ? fopen (files_from, "r") : stdin;
+      if (file == NULL)
+	error (EXIT_FAILURE, errno, "Can't open file list %s", files_from);
+    }
+
+  for (i = 0; ; ++i)
+    {
+      char *name;
+
+      if (i < nargs)
+	name = args[i];
+      else if (file == NULL || (n = getline (&line, &len, file)) < 0)
+	break;
+      else
+	{
+	  if (n && line[n - 1] == '\n')
+	    line[--n] = '\0';
+	  if (n == 0)
+	    continue;
+	  name = strdup (line);
+	  if (name == NULL)
+	    error (EXIT_FAILURE, ENOMEM, "Cannot read file list");
+	}
+      if (nnames == alloced)
+	{
+	  alloced = alloced ? 2 * alloced : 64;
+	  names = (char **) realloc (names, alloced * sizeof (char *));
+	  if (names == NULL)
+	    error (EXIT_FAILURE, ENOMEM, "Cannot read file list");
+	}
+      names[nnames++] = name;
+    }
+
+  free (line);
+  if (file && file != stdin)
+    fclose (file);
+  *namesp = names;
+  return nnames;
+}
+
 #if (defined (__i386__) || defined (__x86_64__)) && defined (__GNUC__)
 static void
 set_default_layout_page_size (void)
@@ -308,6 +477,16 @@ main (int argc, char *argv[])
     error (EXIT_FAILURE, 0, "--dry-run and --verify options are incompatible");
   if ((undo || verify) && quick)
     error (EXIT_FAILURE, 0, "--undo and --quick options are incompatible");
+  if (layout_coloring && layout_cluster)
+    error (EXIT_FAILURE, 0, "--layout-coloring and --layout-cluster options are incompatible");
+  if (apply_debug && (all || reloc_only || undo || verify))
+    error (EXIT_FAILURE, 0, "--apply-debug and either --all, --reloc-only, --undo or --verify options are incompatible");
+  if (files_from && ! verify)
+    error (EXIT_FAILURE, 0, "--files-from can only be used together with --verify");
+  if (fast_verify && ! verify)
+    error (EXIT_FAILURE, 0, "--fast-verify can only be used together with --verify");
+  if (explain_conflicts && verify)
+    error (EXIT_FAILURE, 0, "--explain-conflicts and --verify options are incompatible");
 
   if (print_cache)
     {
@@ -316,7 +495,13 @@ main (int argc, char *argv[])
       return 0;
     }
 
-  if (remaining == argc && ! all)
+  if (hashtab_benchmark)
+    return prelink_hashtab_benchmark ();
+
+  if (conflict_benchmark)
+    return prelink_conflict_benchmark ();
+
+  if (remaining == argc && ! all && files_from == NULL)
     error (EXIT_FAILURE, 0, "no files given and --all not used");
 
   if (undo_output && (!undo || all))
@@ -340,14 +525,23 @@ main (int argc, char *argv[])
       exit (0);
     }
 
+  if (digest_benchmark)
+    return prelink_digest_benchmark (argv + remaining, argc - remaining);
+
   if (verify)
     {
-      if (remaining + 1 != argc)
-	error (EXIT_FAILURE, 0, "only one library or binary can be verified in a single command");
-      return prelink_verify (argv[remaining]);
+      char **names;
+      size_t nnames;
+
+      if (remaining + 1 == argc && files_from == NULL)
+	return prelink_verify (argv[remaining]);
+      nnames = read_files_from (argv + remaining, argc - remaining, &names);
+      if (nnames == 0)
+	error (EXIT_FAILURE, 0, "no library or binary to verify");
+      return prelink_verify_batch (names, nnames);
     }
 
-  if (reloc_only || (undo && ! all))
+  if (reloc_only || apply_debug || (undo && ! all))
     {
       while (remaining < argc)
 	{
@@ -370,6 +564,8 @@ main (int argc, char *argv[])
 
 	  if (undo)
 	    ret = prelink_undo (dso);
+	  else if (apply_debug)
+	    ret = prelink_apply_debug (dso);
 	  else
 	    ret = relocate_dso (dso, reloc_base);
 
@@ -483,6 +679,9 @@ main (int argc, char *argv[])
   layout_libs ();
   prelink_all ();
 
+  if (explain_conflicts)
+    prelink_explain_summary ();
+
   if (! no_update && ! dry_run)
     prelink_save_cache (all);
   return 0;
@@ -55,12 +55,8 @@ static GElf_Addr
 resolve_dso (struct prelink_info *info, GElf_Word r_sym,
 	     int reloc_type)
 {
-  struct prelink_symbol *s;
   int reloc_class = info->dso->arch->reloc_class (reloc_type);
-
-  for (s = & info->symbols[r_sym]; s; s = s->next)
-    if (s->reloc_class == reloc_class)
-      break;
+  struct prelink_symbol *s = prelink_symbol_lookup (info, r_sym, reloc_class);
 
   info->resolveent = NULL;
   info->resolvetls = NULL;
@@ -157,6 +153,7 @@ prelink_prepare (DSO *dso)
 {
   struct reloc_info rinfo;
   int liblist = 0, libstr = 0, newlibstr = 0, undo = 0, newundo = 0;
+  int newdebug = 0;
   int i;
 
   for (i = 1; i < dso->ehdr.e_shnum; ++i)
@@ -282,6 +279,12 @@ prelink_prepare (DSO *dso)
 	    }
 	  break;
 	}
+
+      if (rebase_debuginfo && save_debuglink_crc (dso))
+	return 1;
+
+      if (compress_undo && undo_compress (dso))
+	return 1;
     }
 
   if (dso->ehdr.e_type != ET_DYN)
@@ -338,6 +341,15 @@ prelink_prepare (DSO *dso)
 	      undo = libstr + 1;
 	    }
 	  newundo = 1;
+
+	  /* Only start deferring debugging section changes when the
+	     object is prelinked for the first time, so that
+	     .gnu.prelink_debug always describes all of them.  */
+	  if (defer_debug && has_debug_sections (dso))
+	    {
+	      add_section (move, undo + 1);
+	      newdebug = undo + 1;
+	    }
 	}
       else
 	undo = move->old_to_new[undo];
@@ -408,6 +420,33 @@ prelink_prepare (DSO *dso)
 	  *data = dso->undo;
 	  dso->undo.d_buf = NULL;
 	}
+
+      if (newdebug)
+	{
+	  GElf_Addr newoffset;
+
+	  memset (&dso->shdr[newdebug], 0, sizeof (GElf_Shdr));
+	  dso->shdr[newdebug].sh_name = shstrtabadd (dso, ".gnu.prelink_debug");
+	  if (dso->shdr[newdebug].sh_name == 0)
+	    return 1;
+	  dso->shdr[newdebug].sh_type = SHT_PROGBITS;
+	  dso->shdr[newdebug].sh_offset = dso->shdr[newdebug - 1].sh_offset
+					  + dso->shdr[newdebug - 1].sh_size;
+	  dso->shdr[newdebug].sh_addralign
+	    = gelf_fsize (dso->elf, ELF_T_ADDR, 1, EV_CURRENT);
+	  dso->shdr[newdebug].sh_entsize = 1;
+	  newoffset = dso->shdr[newdebug].sh_offset
+		      + dso->shdr[newdebug].sh_addralign - 1;
+	  newoffset &= ~(dso->shdr[newdebug].sh_addralign - 1);
+	  if (newoffset != dso->shdr[newdebug].sh_offset
+	      && adjust_dso_nonalloc (dso, newdebug + 1,
+				      dso->shdr[newdebug].sh_offset,
+				      newoffset
+				      - dso->shdr[newdebug].sh_offset))
+	    return 1;
+	  dso->shdr[newdebug].sh_offset = newoffset;
+	  dso->debug_deferred = 1;
+	}
     }
   else if (reopen_dso (dso, NULL, NULL))
     return 1;
@@ -813,39 +852,7 @@ free_info (struct prelink_info *info)
   if (info->conflicts)
     {
       for (i = 0; i < info->ent->ndepends + 1; ++i)
-	{
-	  if (info->conflicts[i].hash == &info->conflicts[i].first)
-	    {
-	      struct prelink_conflict *c = info->conflicts[i].first;
-	      void *f;
-
-	      while (c != NULL)
-		{
-		  f = c;
-		  c = c->next;
-		  free (f);
-		}
-	    }
-	  else
-	    {
-	      int j;
-	      for (j = 0; j < 251; j++)
-	        {
-		  struct prelink_conflict *c = info->conflicts[i].hash[j];
-		  void *f;
-
-		  while (c != NULL)
-		    {
-		      f = c;
-		      c = c->next;
-		      free (f);
-		    }
-		}
-	      free (info->conflicts[i].hash);
-	    }
-	  if (info->conflicts[i].hash2 != NULL)
-	    free (info->conflicts[i].hash2);
-	}
+	prelink_conflicts_free (&info->conflicts[i]);
       free (info->conflicts);
     }
   if (info->sonames)
@@ -855,22 +862,8 @@ free_info (struct prelink_info *info)
       free (info->sonames);
     }
   free (info->tls);
-  if (info->symbols)
-    {
-      for (i = 0; i < info->symbol_count; ++i)
-	{
-	  struct prelink_symbol *s = info->symbols[i].next;
-	  void *f;
-
-	  while (s != NULL)
-	    {
-	      f = s;
-	      s = s->next;
-	      free (f);
-	    }
-	}
-      free (info->symbols);
-    }
+  for (i = 0; i < RTYPE_CLASS_COLUMNS; ++i)
+    free (info->symbols[i]);
 }
 
 int
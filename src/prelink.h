@@ -117,6 +117,17 @@ struct PLAdjust
   GElf_Addr adjust;
 };
 
+/* An adjust_dso call whose debugging section changes have been
+   deferred.  RANGES are NRANGES start, end pairs covering the
+   allocated sections at the time of the call.  */
+struct PLDebugStep
+{
+  GElf_Addr start;
+  GElf_Addr adjust;
+  int nranges;
+  GElf_Addr *ranges;
+};
+
 struct section_move
 {
   int old_shnum;
@@ -161,11 +172,24 @@ typedef struct
   GElf_Off mdebug_orig_offset;
   Elf_Data undo;
   int nadjust;
+  /* Debugging section adjustments recorded in .gnu.prelink_debug
+     instead of being done, and the one being replayed.  */
+  struct PLDebugStep *debug_steps, *debug_replay;
+  int ndebug_steps, debug_deferred;
+  /* Adjustments to repeat on the separate debuginfo file.  */
+  struct PLDebugStep *debuginfo_steps;
+  int ndebuginfo_steps;
   int permissive;
+  /* Set if reopen_dso should write into anonymous memory rather than
+     a temporary file, which then has no temp_filename.  */
+  int temp_in_memory;
   struct section_move *move;
   GElf_Shdr shdr[0];
 } DSO;
 
+#define RELOCATE_SCN(shf) \
+  ((shf) & (SHF_WRITE | SHF_ALLOC | SHF_EXECINSTR))
+
 #define dynamic_info_is_set(dso,bit) ((dso)->info_set_mask & (1ULL << (bit)))
 
 struct layout_libs;
@@ -199,6 +223,8 @@ struct PLArch
   int (*prelink_conflict_rela) (DSO *dso, struct prelink_info *info,
   				GElf_Rela *rela, GElf_Addr relaaddr);
   int (*arch_prelink_conflict) (DSO *dso, struct prelink_info *info);
+  /* Apply conflict RELA to BUF.  Returns 6 for a relocation type
+     it does not know how to apply.  */
   int (*apply_conflict_rela) (struct prelink_info *info, GElf_Rela *rela,
 			      char *buf, GElf_Addr dest_addr);
   int (*apply_rel) (struct prelink_info *info, GElf_Rel *rel, char *buf);
@@ -246,7 +272,10 @@ int dso_is_rdwr (DSO *dso);
 void read_dynamic (DSO *dso);
 int set_dynamic (DSO *dso, GElf_Word tag, GElf_Addr value, int fatal);
 int addr_to_sec (DSO *dso, GElf_Addr addr);
+int addr_to_sec_hint (DSO *dso, GElf_Addr addr, int *hint);
+int debug_addr_to_sec (DSO *dso, GElf_Addr addr, int *hint);
 int adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust);
+int adjust_debuginfo (DSO *dso, GElf_Addr start, GElf_Addr adjust);
 int adjust_nonalloc (DSO *dso, GElf_Ehdr *ehdr, GElf_Shdr *shdr, int first,
 		     GElf_Addr start, GElf_Addr adjust);
 int adjust_dso_nonalloc (DSO *dso, int first, GElf_Addr start,
@@ -256,6 +285,8 @@ int adjust_stabs (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust);
 int adjust_dwarf2 (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust);
 int adjust_mdebug (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust);
 int finalize_mdebug (DSO *dso);
+int debug_section_p (DSO *dso, int n);
+int adjust_debug_section (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust);
 int relocate_dso (DSO *dso, GElf_Addr base);
 int copy_fd_to_file (int fdin, const char *name, struct stat64 *st);
 int update_dso (DSO *dso, const char *);
@@ -267,6 +298,23 @@ GElf_Addr adjust_new_to_old (DSO *dso, GElf_Addr addr);
 int strtabfind (DSO *dso, int strndx, const char *name);
 int shstrtabadd (DSO *dso, const char *name);
 
+/* debugdelta.c */
+int read_debug_delta (DSO *dso);
+int debug_ranges (DSO *dso, GElf_Addr **rangesp);
+int record_debug_delta (DSO *dso, GElf_Addr start, GElf_Addr adjust);
+int record_debuginfo_delta (DSO *dso, GElf_Addr start, GElf_Addr adjust);
+int finalize_debug_delta (DSO *dso);
+void free_debug_delta (DSO *dso);
+int has_debug_sections (DSO *dso);
+int prelink_apply_debug (DSO *dso);
+
+/* debuginfo.c */
+int update_debuginfo (DSO *dso, char **namep, char **tempp);
+void finish_debuginfo (char *name, char *temp_name, int commit);
+int save_debuglink_crc (DSO *dso);
+int get_debuglink_crc (DSO *dso, unsigned char *crc);
+void set_debuglink_crc (DSO *dso, const unsigned char *crc);
+
 /* data.c */
 
 /* Used for reading consecutive blocks of data from a DSO.  */
@@ -362,6 +410,8 @@ struct prelink_link
   const char *canon_filename;
 };
 
+struct find_cxx_sym_cache;
+
 struct prelink_entry
 {
   const char *filename;
@@ -387,6 +437,8 @@ struct prelink_entry
   struct prelink_entry **depends;
   struct prelink_entry *prev, *next;
   struct opd_lib *opd;
+  /* C++ tables in the library, see cxx.c.  */
+  struct find_cxx_sym_cache *cxx_cache;
 };
 
 struct prelink_dir
@@ -411,11 +463,18 @@ struct prelink_symbol
       struct prelink_entry *ent;
       struct prelink_tls *tls;
     } u;
-  struct prelink_symbol *next;
   GElf_Addr value;
+  /* Zero if ld.so did not report a lookup for this slot.  */
   int reloc_class;
 };
 
+/* Symbol lookups are kept in one column per relocation class,
+   each column holding one prelink_symbol per .dynsym entry.
+   Columns are allocated when the first lookup of that class
+   is recorded.  */
+#define RTYPE_CLASS_MASK	7
+#define RTYPE_CLASS_COLUMNS	(RTYPE_CLASS_MASK + 1)
+
 struct prelink_conflict
 {
   struct prelink_conflict *next;
@@ -435,16 +494,34 @@ struct prelink_conflict
   /* Value it has in conflict.ent.  */
   GElf_Addr conflictval;
   int reloc_class;
-  unsigned char used;
+  /* Number of relocations which needed this conflict.  */
+  unsigned int used;
+  /* Number of those left in .gnu.conflict, for --explain-conflicts.  */
+  unsigned int applied;
   unsigned char ifunc;
 };
 
+struct prelink_conflict_chunk
+{
+  struct prelink_conflict_chunk *next;
+  size_t used, size;
+  struct prelink_conflict conflicts[0];
+};
+
 struct prelink_conflicts
 {
+  /* All conflicts, chained through next.  */
   struct prelink_conflict *first;
+  /* Open addressing index of the conflicts by symoff,
+     with hash_size (a power of two) slots.  */
   struct prelink_conflict **hash;
+  size_t hash_size;
+  /* 64 minus log2 of hash_size.  */
+  unsigned int hash_shift;
   struct prelink_conflict **hash2;
   size_t count;
+  /* Arena the conflicts are allocated from.  */
+  struct prelink_conflict_chunk *chunks;
 };
 
 #define conflict_lookup_value(cfl)					  \
@@ -456,7 +533,7 @@ struct prelink_info
   DSO *dso;
   DSO **dsos;
   struct prelink_entry *ent;
-  struct prelink_symbol *symbols;
+  struct prelink_symbol *symbols[RTYPE_CLASS_COLUMNS];
   struct prelink_conflicts *conflicts;
   struct prelink_conflicts *curconflicts;
   struct prelink_tls *tls, *curtls;
@@ -468,6 +545,10 @@ struct prelink_info
   GElf_Sym *symtab;
   GElf_Rela *conflict_rela;
   size_t conflict_rela_alloced, conflict_rela_size;
+  /* If non-NULL, conflicts against the search scope entry N are
+     conflict_rela[conflict_scope[N]] ... conflict_rela[conflict_scope[N + 1] - 1],
+     sorted by r_offset.  */
+  size_t *conflict_scope;
   GElf_Addr symtab_start, symtab_end;
   GElf_Addr (*resolve) (struct prelink_info *info, GElf_Word r_sym,
 			 int reloc_type);
@@ -475,10 +556,23 @@ struct prelink_info
   struct prelink_tls *resolvetls;
 };
 
+static inline struct prelink_symbol *
+prelink_symbol_lookup (struct prelink_info *info, GElf_Word r_sym,
+		       int reloc_class)
+{
+  struct prelink_symbol *s = info->symbols[reloc_class & RTYPE_CLASS_MASK];
+
+  if (s == NULL || s[r_sym].reloc_class != reloc_class)
+    return NULL;
+  return &s[r_sym];
+}
+
 int prelink_prepare (DSO *dso);
 int prelink (DSO *dso, struct prelink_entry *ent);
 int prelink_init_cache (void);
 int prelink_load_cache (void);
+int prelink_hashtab_benchmark (void);
+int prelink_conflict_benchmark (void);
 int prelink_print_cache (void);
 int prelink_save_cache (int do_warn);
 struct prelink_entry *
@@ -487,6 +581,16 @@ struct prelink_entry *
 struct prelink_conflict *
   prelink_conflict (struct prelink_info *info, GElf_Word r_sym,
 		    int reloc_type);
+struct prelink_conflict *
+  prelink_conflict_iter (struct prelink_conflicts *conflicts,
+			 GElf_Addr symoff, size_t *pos);
+struct prelink_conflict *
+  prelink_conflict_find (struct prelink_conflicts *conflicts,
+			 GElf_Addr symoff, int reloc_class);
+struct prelink_conflict *
+  prelink_conflict_new (struct prelink_conflicts *conflicts,
+			GElf_Addr symoff, int reloc_class);
+void prelink_conflicts_free (struct prelink_conflicts *conflicts);
 GElf_Rela *prelink_conflict_add_rela (struct prelink_info *info);
 int prelink_get_relocations (struct prelink_info *info);
 int prelink_build_conflicts (struct prelink_info *info);
@@ -494,11 +598,17 @@ int update_dynamic_tags (DSO *dso, GElf_Shdr *shdr, GElf_Shdr *old_shdr,
 			 struct section_move *move);
 int prelink_exec (struct prelink_info *info);
 int prelink_set_checksum (DSO *dso);
+int prelink_checksum_matches (DSO *dso);
 int is_ldso_soname (const char *soname);
 
 int prelink_undo (DSO *dso);
+int undo_compress (DSO *dso);
+int undo_compressed (DSO *dso, int undo);
+int undo_debuglink_crc (DSO *dso, int undo, unsigned char *crc);
 
 int prelink_verify (const char *filename);
+int prelink_verify_batch (char **names, size_t nnames);
+int prelink_digest_benchmark (char **names, size_t nnames);
 ssize_t send_file (int outfd, int infd, off_t *poff, size_t count);
 
 int gather_object (const char *dir, int deref, int onefs);
@@ -512,6 +622,7 @@ FILE *execve_open (const char *path, char *const argv[], char *const envp[]);
 int execve_close (FILE *f);
 
 int remove_redundant_cxx_conflicts (struct prelink_info *info);
+void prelink_explain_summary (void);
 int get_relocated_mem (struct prelink_info *info, DSO *dso, GElf_Addr addr,
 		       char *buf, GElf_Word size, GElf_Addr dest_addr);
 
@@ -521,6 +632,10 @@ void prelink_all (void);
 
 int undo_all (void);
 
+int run_jobs (size_t nitems, int (*fn) (size_t, void *),
+	      void (*done_fn) (size_t, int, void *), void *data,
+	      const char *what);
+
 char *prelink_canonicalize (const char *name, struct stat64 *stp);
 
 extern const char *dynamic_linker;
@@ -532,6 +647,12 @@ extern int all;
 extern int force;
 extern int random_base;
 extern int conserve_memory;
+extern int layout_coloring;
+extern int layout_cluster;
+extern int explain_conflicts;
+extern int stable_layout;
+extern const char *hot_libs;
+extern int hot_libs_count;
 extern int verbose;
 extern int dry_run;
 extern int libs_only;
@@ -539,8 +660,15 @@ extern int enable_cxx_optimizations;
 extern int exec_shield;
 extern int undo;
 extern int verify;
+extern int jobs;
+extern int defer_debug;
+extern int compress_undo;
+extern int fast_verify;
+extern int rebase_debuginfo;
+extern const char *debuginfo_dir;
 extern int print_cache;
-enum verify_method_t { VERIFY_CONTENT, VERIFY_MD5, VERIFY_SHA };
+enum verify_method_t { VERIFY_CONTENT, VERIFY_MD5, VERIFY_SHA, VERIFY_SHA256,
+		       VERIFY_BLAKE3 };
 extern enum verify_method_t verify_method;
 extern int quick;
 extern long long seed;
@@ -0,0 +1,427 @@
+/* sha256.c - Functions to compute the SHA-256 hash (message-digest) of
+   files or blocks of memory.  Complies to the NIST specification
+   FIPS-180-2.
+
+   Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <byteswap.h>
+#include "md5.h"
+#include "sha256.h"
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+# define NOTSWAP(n) (n)
+#else
+# define NOTSWAP(n) bswap_32 (n)
+#endif
+
+/* The SHA extensions of x86-64 and the ARMv8 Cryptography Extensions
+   both implement the SHA-256 rounds and message schedule, which makes
+   them several times faster than the plain C code below.  The former
+   are compiled in whenever the compiler supports them and used if the
+   CPU has them, the latter need a compiler flag like
+   -march=armv8-a+crypto.  */
+#if defined __x86_64__ && defined __GNUC__ && __GNUC__ >= 5
+# define SHA256_X86_SHA 1
+# include <cpuid.h>
+# include <immintrin.h>
+#elif defined __aarch64__ && defined __ARM_FEATURE_CRYPTO
+# define SHA256_ARM_CRYPTO 1
+# include <arm_neon.h>
+#endif
+
+/* This array contains the bytes used to pad the buffer to the next
+   64-byte boundary.  */
+static const unsigned char fillbuf[64] = { 0x80, 0 /* , 0, 0, ...  */ };
+
+static const md5_uint32 sha256_k[64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+void
+sha256_init_ctx (struct sha256_ctx *ctx)
+{
+  ctx->state[0] = 0x6a09e667;
+  ctx->state[1] = 0xbb67ae85;
+  ctx->state[2] = 0x3c6ef372;
+  ctx->state[3] = 0xa54ff53a;
+  ctx->state[4] = 0x510e527f;
+  ctx->state[5] = 0x9b05688c;
+  ctx->state[6] = 0x1f83d9ab;
+  ctx->state[7] = 0x5be0cd19;
+
+  ctx->total[0] = ctx->total[1] = 0;
+  ctx->buflen = 0;
+}
+
+/* Put result from CTX in first 32 bytes following RESBUF.  The result
+   must be in big endian byte order.
+
+   IMPORTANT: On some systems it is required that RESBUF is correctly
+   aligned for a 32 bits value.  */
+void *
+sha256_read_ctx (const struct sha256_ctx *ctx, void *resbuf)
+{
+  int i;
+
+  for (i = 0; i < 8; ++i)
+    ((md5_uint32 *) resbuf)[i] = NOTSWAP (ctx->state[i]);
+
+  return resbuf;
+}
+
+/* Process the remaining bytes in the internal buffer and the usual
+   prolog according to the standard and write the result to RESBUF.
+
+   IMPORTANT: On some systems it is required that RESBUF is correctly
+   aligned for a 32 bits value.  */
+void *
+sha256_finish_ctx (struct sha256_ctx *ctx, void *resbuf)
+{
+  /* Take yet unprocessed bytes into account.  */
+  md5_uint32 bytes = ctx->buflen;
+  size_t pad;
+
+  /* Now count remaining bytes.  */
+  ctx->total[0] += bytes;
+  if (ctx->total[0] < bytes)
+    ++ctx->total[1];
+
+  pad = bytes >= 56 ? 64 + 56 - bytes : 56 - bytes;
+  memcpy (&ctx->buffer[bytes], fillbuf, pad);
+
+  /* Put the 64-bit file length in *bits* at the end of the buffer.  */
+  *(md5_uint32 *) &ctx->buffer[bytes + pad + 4] = NOTSWAP (ctx->total[0] << 3);
+  *(md5_uint32 *) &ctx->buffer[bytes + pad] = NOTSWAP ((ctx->total[1] << 3) |
+						    (ctx->total[0] >> 29));
+
+  /* Process last bytes.  */
+  sha256_process_block (ctx->buffer, bytes + pad + 8, ctx);
+
+  return sha256_read_ctx (ctx, resbuf);
+}
+
+/* Compute SHA-256 message digest for LEN bytes beginning at BUFFER.
+   The result is always in big endian byte order, so that a byte-wise
+   output yields to the wanted ASCII representation of the message
+   digest.  */
+void *
+sha256_buffer (const char *buffer, size_t len, void *resblock)
+{
+  struct sha256_ctx ctx;
+
+  /* Initialize the computation context.  */
+  sha256_init_ctx (&ctx);
+
+  /* Process whole buffer but last len % 64 bytes.  */
+  sha256_process_bytes (buffer, len, &ctx);
+
+  /* Put result in desired memory area.  */
+  return sha256_finish_ctx (&ctx, resblock);
+}
+
+void
+sha256_process_bytes (const void *buffer, size_t len, struct sha256_ctx *ctx)
+{
+  /* When we already have some bits in our internal buffer concatenate
+     both inputs first.  */
+  if (ctx->buflen != 0)
+    {
+      size_t left_over = ctx->buflen;
+      size_t add = 128 - left_over > len ? len : 128 - left_over;
+
+      memcpy (&ctx->buffer[left_over], buffer, add);
+      ctx->buflen += add;
+
+      if (ctx->buflen > 64)
+	{
+	  sha256_process_block (ctx->buffer, ctx->buflen & ~63, ctx);
+
+	  ctx->buflen &= 63;
+	  /* The regions in the following copy operation cannot overlap.  */
+	  memcpy (ctx->buffer, &ctx->buffer[(left_over + add) & ~63],
+		  ctx->buflen);
+	}
+
+      buffer = (const char *) buffer + add;
+      len -= add;
+    }
+
+  /* Process available complete blocks.  */
+  if (len >= 64)
+    {
+#define UNALIGNED_P(p) (((md5_uintptr) p) % __alignof__ (md5_uint32) != 0)
+      if (UNALIGNED_P (buffer))
+	while (len > 64)
+	  {
+	    sha256_process_block (memcpy (ctx->buffer, buffer, 64), 64, ctx);
+	    buffer = (const char *) buffer + 64;
+	    len -= 64;
+	  }
+      else
+	{
+	  sha256_process_block (buffer, len & ~63, ctx);
+	  buffer = (const char *) buffer + (len & ~63);
+	  len &= 63;
+	}
+    }
+
+  /* Move remaining bytes in internal buffer.  */
+  if (len > 0)
+    {
+      size_t left_over = ctx->buflen;
+
+      memcpy (&ctx->buffer[left_over], buffer, len);
+      left_over += len;
+      if (left_over >= 64)
+	{
+	  sha256_process_block (ctx->buffer, 64, ctx);
+	  left_over -= 64;
+	  memcpy (ctx->buffer, &ctx->buffer[64], left_over);
+	}
+      ctx->buflen = left_over;
+    }
+}
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+#define S0(x) (ROR (x, 2) ^ ROR (x, 13) ^ ROR (x, 22))
+#define S1(x) (ROR (x, 6) ^ ROR (x, 11) ^ ROR (x, 25))
+#define G0(x) (ROR (x, 7) ^ ROR (x, 18) ^ ((x) >> 3))
+#define G1(x) (ROR (x, 17) ^ ROR (x, 19) ^ ((x) >> 10))
+
+static void
+sha256_blocks_c (const unsigned char *p, size_t nblocks, md5_uint32 *state)
+{
+  md5_uint32 w[64], a, b, c, d, e, f, g, h, t1, t2;
+  int t;
+
+  while (nblocks-- > 0)
+    {
+      for (t = 0; t < 16; t++, p += 4)
+	w[t] = NOTSWAP (*(const md5_uint32 *) p);
+      for (; t < 64; t++)
+	w[t] = G1 (w[t - 2]) + w[t - 7] + G0 (w[t - 15]) + w[t - 16];
+
+      a = state[0];
+      b = state[1];
+      c = state[2];
+      d = state[3];
+      e = state[4];
+      f = state[5];
+      g = state[6];
+      h = state[7];
+      for (t = 0; t < 64; t++)
+	{
+	  t1 = h + S1 (e) + CH (e, f, g) + sha256_k[t] + w[t];
+	  t2 = S0 (a) + MAJ (a, b, c);
+	  h = g;
+	  g = f;
+	  f = e;
+	  e = d + t1;
+	  d = c;
+	  c = b;
+	  b = a;
+	  a = t1 + t2;
+	}
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+      state[5] += f;
+      state[6] += g;
+      state[7] += h;
+    }
+}
+
+#ifdef SHA256_X86_SHA
+static int
+sha256_have_x86_sha (void)
+{
+  unsigned int eax, ebx, ecx, edx;
+
+  if (! __get_cpuid (1, &eax, &ebx, &ecx, &edx)
+      || (ecx & (bit_SSSE3 | bit_SSE4_1)) != (bit_SSSE3 | bit_SSE4_1))
+    return 0;
+  if (__get_cpuid_max (0, NULL) < 7)
+    return 0;
+  __cpuid_count (7, 0, eax, ebx, ecx, edx);
+  return (ebx & (1 << 29)) != 0;
+}
+
+/* The SHA-256 instructions keep the state as ABEF and CDGH halves
+   and do four rounds per pair of sha256rnds2 instructions.  */
+static void __attribute__ ((target ("sha,sse4.1")))
+sha256_blocks_x86_sha (const unsigned char *p, size_t nblocks,
+		       md5_uint32 *state)
+{
+  const __m128i mask = _mm_set_epi64x (0x0c0d0e0f08090a0bULL,
+				       0x0405060700010203ULL);
+  __m128i state0, state1, abef, cdgh, msg, tmp, w[4];
+  int g;
+
+  tmp = _mm_loadu_si128 ((const __m128i *) &state[0]);
+  state1 = _mm_loadu_si128 ((const __m128i *) &state[4]);
+  tmp = _mm_shuffle_epi32 (tmp, 0xb1);
+  state1 = _mm_shuffle_epi32 (state1, 0x1b);
+  state0 = _mm_alignr_epi8 (tmp, state1, 8);
+  state1 = _mm_blend_epi16 (state1, tmp, 0xf0);
+
+  while (nblocks-- > 0)
+    {
+      abef = state0;
+      cdgh = state1;
+      for (g = 0; g < 16; g++)
+	{
+	  if (g < 4)
+	    w[g] = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *)
+						      (p + 16 * g)), mask);
+	  else
+	    {
+	      tmp = _mm_sha256msg1_epu32 (w[g & 3], w[(g + 1) & 3]);
+	      tmp = _mm_add_epi32 (tmp, _mm_alignr_epi8 (w[(g + 3) & 3],
+							 w[(g + 2) & 3], 4));
+	      w[g & 3] = _mm_sha256msg2_epu32 (tmp, w[(g + 3) & 3]);
+	    }
+	  msg = _mm_add_epi32 (w[g & 3],
+			       _mm_loadu_si128 ((const __m128i *)
+						&sha256_k[4 * g]));
+	  state1 = _mm_sha256rnds2_epu32 (state1, state0, msg);
+	  msg = _mm_shuffle_epi32 (msg, 0x0e);
+	  state0 = _mm_sha256rnds2_epu32 (state0, state1, msg);
+	}
+      state0 = _mm_add_epi32 (state0, abef);
+      state1 = _mm_add_epi32 (state1, cdgh);
+      p += 64;
+    }
+
+  tmp = _mm_shuffle_epi32 (state0, 0x1b);
+  state1 = _mm_shuffle_epi32 (state1, 0xb1);
+  state0 = _mm_blend_epi16 (tmp, state1, 0xf0);
+  state1 = _mm_alignr_epi8 (state1, tmp, 8);
+  _mm_storeu_si128 ((__m128i *) &state[0], state0);
+  _mm_storeu_si128 ((__m128i *) &state[4], state1);
+}
+#endif
+
+#ifdef SHA256_ARM_CRYPTO
+static void
+sha256_blocks_arm_crypto (const unsigned char *p, size_t nblocks,
+			  md5_uint32 *state)
+{
+  uint32x4_t state0, state1, abcd, efgh, msg, tmp, w[4];
+  int g;
+
+  state0 = vld1q_u32 (&state[0]);
+  state1 = vld1q_u32 (&state[4]);
+  while (nblocks-- > 0)
+    {
+      abcd = state0;
+      efgh = state1;
+      for (g = 0; g < 4; g++)
+	w[g] = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (p + 16 * g)));
+      for (g = 0; g < 16; g++)
+	{
+	  msg = vaddq_u32 (w[g & 3], vld1q_u32 (&sha256_k[4 * g]));
+	  if (g < 12)
+	    w[g & 3] = vsha256su1q_u32 (vsha256su0q_u32 (w[g & 3],
+							w[(g + 1) & 3]),
+					w[(g + 2) & 3], w[(g + 3) & 3]);
+	  tmp = state0;
+	  state0 = vsha256hq_u32 (state0, state1, msg);
+	  state1 = vsha256h2q_u32 (state1, tmp, msg);
+	}
+      state0 = vaddq_u32 (state0, abcd);
+      state1 = vaddq_u32 (state1, efgh);
+      p += 64;
+    }
+  vst1q_u32 (&state[0], state0);
+  vst1q_u32 (&state[4], state1);
+}
+#endif
+
+static void (*sha256_blocks) (const unsigned char *, size_t, md5_uint32 *);
+static const char *sha256_name;
+
+static void
+sha256_choose (void)
+{
+  sha256_blocks = sha256_blocks_c;
+  sha256_name = "C";
+#ifdef SHA256_X86_SHA
+  if (sha256_have_x86_sha ())
+    {
+      sha256_blocks = sha256_blocks_x86_sha;
+      sha256_name = "x86 SHA extensions";
+    }
+#endif
+#ifdef SHA256_ARM_CRYPTO
+  sha256_blocks = sha256_blocks_arm_crypto;
+  sha256_name = "ARMv8 Cryptography Extensions";
+#endif
+  if (getenv ("PRELINK_DIGEST_C") != NULL)
+    {
+      sha256_blocks = sha256_blocks_c;
+      sha256_name = "C";
+    }
+}
+
+const char *
+sha256_implementation (void)
+{
+  if (sha256_blocks == NULL)
+    sha256_choose ();
+  return sha256_name;
+}
+
+/* Process LEN bytes of BUFFER, accumulating context into CTX.
+   It is assumed that LEN % 64 == 0.  */
+
+void
+sha256_process_block (const void *buffer, size_t len, struct sha256_ctx *ctx)
+{
+  /* First increment the byte count.  FIPS 180-2 specifies the possible
+     length of the file up to 2^64 bits.  Here we only compute the
+     number of bytes.  Do a double word increment.  */
+  ctx->total[0] += len;
+  if (ctx->total[0] < len)
+    ++ctx->total[1];
+
+  if (sha256_blocks == NULL)
+    sha256_choose ();
+  sha256_blocks (buffer, len / 64, ctx->state);
+}
@@ -148,7 +148,7 @@ adjust_stabs (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
       case N_BNSYM:
       case N_ENSYM:
 	value = read_32 (data->d_buf + off + 8);
-	sec = addr_to_sec (dso, value);
+	sec = debug_addr_to_sec (dso, value, &dso->lastscn);
 	if (sec != -1)
 	  {
 	    addr_adjust (value, start, adjust);
@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <error.h>
 #include <fcntl.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -145,19 +146,237 @@ remove_dynamic_prelink_tags (DSO *dso)
   return 0;
 }
 
+/* .gnu.prelink_undo sections hold the original ELF header, program
+   headers and section headers but the first.  With --rebase-debuginfo
+   the original 4 byte CRC of .gnu_debuglink follows them, as
+   update_debuginfo changes it.
+
+   Compressed .gnu.prelink_undo sections start with a 12 byte header:
+   the "\177PLU" magic (which can never start the ELF header in the
+   uncompressed format), version, method, flags, a reserved byte and
+   the original e_phnum and e_shnum as little endian 16-bit numbers.
+   Method 1 is the only one defined so far: each program and section
+   header is XORed with the preceding one, which clears most bytes
+   of neighbouring entries, and the result is run-length encoded.
+   A token byte below 0x80 is followed by that many plus one literal
+   bytes, otherwise it stands for (token & 0x7f) + 1 zero bytes.
+   UNDO_FLAG_DEBUGLINK in flags says the CRC is included.  */
+
+#define UNDO_MAGIC		"\177PLU"
+#define UNDO_HDR_SIZE		12
+#define UNDO_VERSION		1
+#define UNDO_METHOD_XOR_RLE	1
+#define UNDO_FLAG_DEBUGLINK	1
+#define UNDO_DEBUGLINK_SIZE	4
+
+/* Size of the headers at the start of uncompressed .gnu.prelink_undo
+   data for PHNUM program and SHNUM section headers.  */
+static size_t
+undo_headers_size (DSO *dso, int phnum, int shnum)
+{
+  return gelf_fsize (dso->elf, ELF_T_EHDR, 1, EV_CURRENT)
+	 + gelf_fsize (dso->elf, ELF_T_PHDR, phnum, EV_CURRENT)
+	 + gelf_fsize (dso->elf, ELF_T_SHDR, shnum - 1, EV_CURRENT);
+}
+
+static void
+undo_xor_entries (unsigned char *buf, size_t entsize, int n, int encode)
+{
+  size_t k;
+  int i;
+
+  if (encode)
+    {
+      for (i = n - 1; i > 0; --i)
+	for (k = 0; k < entsize; ++k)
+	  buf[i * entsize + k] ^= buf[(i - 1) * entsize + k];
+    }
+  else
+    for (i = 1; i < n; ++i)
+      for (k = 0; k < entsize; ++k)
+	buf[i * entsize + k] ^= buf[(i - 1) * entsize + k];
+}
+
+static void
+undo_xor (DSO *dso, unsigned char *buf, int phnum, int shnum, int encode)
+{
+  size_t ehsize = gelf_fsize (dso->elf, ELF_T_EHDR, 1, EV_CURRENT);
+  size_t phsize = gelf_fsize (dso->elf, ELF_T_PHDR, 1, EV_CURRENT);
+  size_t shsize = gelf_fsize (dso->elf, ELF_T_SHDR, 1, EV_CURRENT);
+
+  undo_xor_entries (buf + ehsize, phsize, phnum, encode);
+  undo_xor_entries (buf + ehsize + phnum * phsize, shsize, shnum - 1,
+		    encode);
+}
+
+int
+undo_compress (DSO *dso)
+{
+  unsigned char *in = dso->undo.d_buf, *out, *p;
+  size_t size = dso->undo.d_size, i, j;
+
+  /* Worst case is one token per 128 literal bytes.  */
+  out = malloc (UNDO_HDR_SIZE + size + size / 128 + 1);
+  if (out == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not compress .gnu.prelink_undo section",
+	     dso->filename);
+      return 1;
+    }
+
+  undo_xor (dso, in, dso->ehdr.e_phnum, dso->ehdr.e_shnum, 1);
+  memcpy (out, UNDO_MAGIC, 4);
+  out[4] = UNDO_VERSION;
+  out[5] = UNDO_METHOD_XOR_RLE;
+  out[6] = size > undo_headers_size (dso, dso->ehdr.e_phnum,
+				     dso->ehdr.e_shnum)
+	   ? UNDO_FLAG_DEBUGLINK : 0;
+  out[7] = 0;
+  out[8] = dso->ehdr.e_phnum & 0xff;
+  out[9] = dso->ehdr.e_phnum >> 8;
+  out[10] = dso->ehdr.e_shnum & 0xff;
+  out[11] = dso->ehdr.e_shnum >> 8;
+  p = out + UNDO_HDR_SIZE;
+  for (i = 0; i < size; )
+    {
+      for (j = i; j < size && j - i < 128 && in[j] == 0; ++j)
+	;
+      if (j - i >= 2 || j == size)
+	{
+	  *p++ = 0x80 + (j - i - 1);
+	  i = j;
+	  continue;
+	}
+      /* Collect literals up to the next run of at least two zeros.  */
+      for (j = i; j < size && j - i < 128; ++j)
+	if (in[j] == 0 && j + 1 < size && in[j + 1] == 0)
+	  break;
+      *p++ = j - i - 1;
+      memcpy (p, in + i, j - i);
+      p += j - i;
+      i = j;
+    }
+
+  if ((size_t) (p - out) >= size)
+    {
+      /* Not worth it, keep the plain format.  */
+      undo_xor (dso, in, dso->ehdr.e_phnum, dso->ehdr.e_shnum, 0);
+      free (out);
+      return 0;
+    }
+
+  free (dso->undo.d_buf);
+  dso->undo.d_buf = out;
+  dso->undo.d_size = p - out;
+  return 0;
+}
+
+int
+undo_compressed (DSO *dso, int undo)
+{
+  Elf_Data *d = elf_getdata (dso->scn[undo], NULL);
+
+  return d != NULL && d->d_size >= UNDO_HDR_SIZE
+	 && memcmp (d->d_buf, UNDO_MAGIC, 4) == 0;
+}
+
+static size_t
+undo_expanded_size (DSO *dso, Elf_Data *d)
+{
+  const unsigned char *in = d->d_buf;
+  int phnum, shnum;
+  size_t size;
+
+  if (in[4] != UNDO_VERSION || in[5] != UNDO_METHOD_XOR_RLE)
+    {
+      error (0, 0, "%s: Unsupported .gnu.prelink_undo section version %d",
+	     dso->filename, in[4]);
+      return 0;
+    }
+  phnum = in[8] | (in[9] << 8);
+  shnum = in[10] | (in[11] << 8);
+  if (shnum == 0)
+    {
+      error (0, 0, "%s: Could not read .gnu.prelink_undo section",
+	     dso->filename);
+      return 0;
+    }
+  /* Prelinking never removes program headers, and each token expands
+     to at most 128 bytes.  The callers allocate the result on the
+     stack, so don't trust the counts beyond that.  */
+  size = undo_headers_size (dso, phnum, shnum)
+	 + ((in[6] & UNDO_FLAG_DEBUGLINK) ? UNDO_DEBUGLINK_SIZE : 0);
+  if (phnum > dso->ehdr.e_phnum
+      || size > 128 * (d->d_size - UNDO_HDR_SIZE))
+    {
+      error (0, 0, "%s: Corrupted .gnu.prelink_undo section",
+	     dso->filename);
+      return 0;
+    }
+  return size;
+}
+
+static int
+undo_expand (DSO *dso, Elf_Data *d, Elf_Data *data)
+{
+  const unsigned char *hdr = d->d_buf, *in, *end = hdr + d->d_size;
+  unsigned char *out = data->d_buf;
+  size_t size = data->d_size, len, i = 0;
+
+  for (in = hdr + UNDO_HDR_SIZE; in < end; )
+    {
+      len = (*in & 0x7f) + 1;
+      if (len > size - i)
+	break;
+      if (*in++ & 0x80)
+	memset (out + i, 0, len);
+      else
+	{
+	  if (len > end - in)
+	    break;
+	  memcpy (out + i, in, len);
+	  in += len;
+	}
+      i += len;
+    }
+
+  if (in != end || i != size)
+    {
+      error (0, 0, "%s: Corrupted .gnu.prelink_undo section",
+	     dso->filename);
+      return 1;
+    }
+
+  undo_xor (dso, out, hdr[8] | (hdr[9] << 8), hdr[10] | (hdr[11] << 8), 0);
+  return 0;
+}
+
 int
 undo_sections (DSO *dso, int undo, struct section_move *move,
 	       struct reloc_info *rinfo, GElf_Ehdr *ehdr,
 	       GElf_Phdr *phdr, GElf_Shdr *shdr)
 {
-  Elf_Data src, dst, *d;
+  Elf_Data src, dst, expanded, *d;
   Elf_Scn *scn;
+  size_t size;
   int i, j;
 
   scn = dso->scn[undo];
   d = elf_getdata (scn, NULL);
   assert (d != NULL && elf_getdata (scn, d) == NULL);
 
+  if (undo_compressed (dso, undo))
+    {
+      expanded = *d;
+      expanded.d_size = undo_expanded_size (dso, d);
+      if (expanded.d_size == 0)
+	return 1;
+      expanded.d_buf = alloca (expanded.d_size);
+      if (undo_expand (dso, d, &expanded))
+	return 1;
+      d = &expanded;
+    }
+
   src = *d;
   src.d_type = ELF_T_EHDR;
   src.d_align = dso->shdr[undo].sh_addralign;
@@ -229,11 +448,8 @@ undo_sections (DSO *dso, int undo, struct section_move *move,
       return 1;
     }
 
-  if (d->d_size != (src.d_size
-		    + gelf_fsize (dso->elf, ELF_T_PHDR, ehdr->e_phnum,
-				  EV_CURRENT)
-		    + gelf_fsize (dso->elf, ELF_T_SHDR, ehdr->e_shnum - 1,
-				  EV_CURRENT)))
+  size = undo_headers_size (dso, ehdr->e_phnum, ehdr->e_shnum);
+  if (d->d_size != size && d->d_size != size + UNDO_DEBUGLINK_SIZE)
     {
       error (0, 0, "%s: Incorrect size of .gnu.prelink_undo section",
 	     dso->filename);
@@ -355,6 +571,7 @@ undo_sections (DSO *dso, int undo, struct section_move *move,
 				   dso->shdr[i].sh_name);
 
 	if (! strcmp (name, ".gnu.prelink_undo")
+	    || ! strcmp (name, ".gnu.prelink_debug")
 	    || ! strcmp (name, ".gnu.conflict")
 	    || ! strcmp (name, ".gnu.liblist")
 	    || ! strcmp (name, ".gnu.libstr")
@@ -480,6 +697,58 @@ undo_sections (DSO *dso, int undo, struct section_move *move,
   return 0;
 }
 
+/* Copy the original .gnu_debuglink CRC saved in .gnu.prelink_undo
+   section UNDO of DSO to CRC.  Return 1 if it was saved, 0 if not
+   and -1 on error.  */
+int
+undo_debuglink_crc (DSO *dso, int undo, unsigned char *crc)
+{
+  Elf_Data expanded, *d = elf_getdata (dso->scn[undo], NULL);
+  unsigned char *buf;
+  int phnum, shnum;
+
+  if (d == NULL || d->d_buf == NULL)
+    return 0;
+
+  if (undo_compressed (dso, undo))
+    {
+      buf = d->d_buf;
+      if (! (buf[6] & UNDO_FLAG_DEBUGLINK))
+	return 0;
+      expanded = *d;
+      expanded.d_size = undo_expanded_size (dso, d);
+      if (expanded.d_size == 0)
+	return -1;
+      expanded.d_buf = alloca (expanded.d_size);
+      if (undo_expand (dso, d, &expanded))
+	return -1;
+      d = &expanded;
+    }
+
+  buf = d->d_buf;
+  if (gelf_getclass (dso->elf) == ELFCLASS32)
+    {
+      if (d->d_size < sizeof (Elf32_Ehdr))
+	return 0;
+      phnum = buf_read_une16 (dso, buf + offsetof (Elf32_Ehdr, e_phnum));
+      shnum = buf_read_une16 (dso, buf + offsetof (Elf32_Ehdr, e_shnum));
+    }
+  else
+    {
+      if (d->d_size < sizeof (Elf64_Ehdr))
+	return 0;
+      phnum = buf_read_une16 (dso, buf + offsetof (Elf64_Ehdr, e_phnum));
+      shnum = buf_read_une16 (dso, buf + offsetof (Elf64_Ehdr, e_shnum));
+    }
+
+  if (shnum == 0
+      || d->d_size != (undo_headers_size (dso, phnum, shnum)
+		       + UNDO_DEBUGLINK_SIZE))
+    return 0;
+  memcpy (crc, buf + d->d_size - UNDO_DEBUGLINK_SIZE, UNDO_DEBUGLINK_SIZE);
+  return 1;
+}
+
 int
 prelink_undo (DSO *dso)
 {
@@ -488,9 +757,10 @@ prelink_undo (DSO *dso)
   GElf_Phdr phdr[dso->ehdr.e_phnum];
   Elf_Scn *scn;
   Elf_Data *d;
-  int undo, i;
+  int undo, i, debuglink;
   struct section_move *move;
   struct reloc_info rinfo;
+  unsigned char crc[4];
 
   for (undo = 1; undo < dso->ehdr.e_shnum; ++undo)
     if (! strcmp (strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[undo].sh_name),
@@ -516,6 +786,10 @@ prelink_undo (DSO *dso)
   if (undo_sections (dso, undo, move, &rinfo, &ehdr, phdr, shdr))
     goto error_out;
 
+  debuglink = undo_debuglink_crc (dso, undo, crc);
+  if (debuglink == -1)
+    goto error_out;
+
   if (reopen_dso (dso, move, (undo_output && strcmp (undo_output, "-") == 0)
 			     ? "/tmp/undo" : undo_output))
     goto error_out;
@@ -704,6 +978,9 @@ prelink_undo (DSO *dso)
   dso->ehdr.e_phoff = ehdr.e_phoff;
   dso->ehdr.e_shoff = ehdr.e_shoff;
   dso->ehdr.e_phnum = ehdr.e_phnum;
+  /* update_debuginfo may have changed the CRC since.  */
+  if (debuglink)
+    set_debuglink_crc (dso, crc);
   free (move);
   return 0;
 
@@ -26,23 +26,22 @@
 #include <unistd.h>
 #include "prelinktab.h"
 
+struct undo_list
+{
+  struct prelink_entry **ents;
+  size_t nents;
+};
+
 static int
-undo_one (void **p, void *info)
+undo_one (size_t n, void *info)
 {
-  struct prelink_entry *ent = * (struct prelink_entry **) p;
+  struct prelink_entry *ent = ((struct undo_list *) info)->ents[n];
   DSO *dso;
   struct stat64 st;
   struct prelink_link *hardlink;
   char *move = NULL;
   size_t movelen = 0;
 
-  if (ent->done != 2)
-    return 1;
-
-  if (ent->type != ET_DYN
-      && (ent->type != ET_EXEC || libs_only))
-    return 1;
-
   dso = open_dso (ent->canon_filename);
   if (dso == NULL)
     goto error_out;
@@ -155,19 +154,49 @@ undo_one (void **p, void *info)
 	}
     }
   free (move);
-  return 1;
+  return 0;
 
 error_out:
   if (dso)
     close_dso (dso);
-  (*(int *)info)++;
+  return 1;
+}
+
+static int
+undo_add (void **p, void *info)
+{
+  struct prelink_entry *ent = * (struct prelink_entry **) p;
+  struct undo_list *l = (struct undo_list *) info;
+
+  if (ent->done != 2)
+    return 1;
+
+  if (ent->type != ET_DYN
+      && (ent->type != ET_EXEC || libs_only))
+    return 1;
+
+  l->ents[l->nents++] = ent;
   return 1;
 }
 
 int
 undo_all (void)
 {
-  int failures = 0;
-  htab_traverse (prelink_filename_htab, undo_one, &failures);
+  struct undo_list l;
+  int failures;
+
+  l.ents = malloc (htab_elements (prelink_filename_htab)
+		   * sizeof (struct prelink_entry *));
+  if (l.ents == NULL)
+    {
+      error (0, ENOMEM, "Could not undo prelinking");
+      return 1;
+    }
+  l.nents = 0;
+  htab_traverse (prelink_filename_htab, undo_add, &l);
+  /* Hardlinks are redone by the same undo_one call which undoes
+     the file they link to, so the entries are independent.  */
+  failures = run_jobs (l.nents, undo_one, NULL, &l, "undo");
+  free (l.ents);
   return failures != 0;
 }
@@ -26,9 +26,56 @@
 #include <time.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 #include "prelink.h"
 #include "md5.h"
 #include "sha.h"
+#include "sha256.h"
+#include "blake3.h"
+
+/* Length of the longest digest --verify can print.  */
+#define VERIFY_MAX_DIGEST	32
+
+union verify_ctx
+{
+  struct md5_ctx md5;
+  struct sha_ctx sha;
+  struct sha256_ctx sha256;
+  struct blake3_ctx blake3;
+};
+
+/* The digests --verify can print, indexed by verify_method.  */
+static const struct verify_digest
+{
+  const char *name;
+  size_t size;
+  void (*init) (void *);
+  void (*process) (const void *, size_t, void *);
+  void *(*finish) (void *, void *);
+  const char *(*implementation) (void);
+} verify_digests[] =
+{
+  [VERIFY_MD5] = { "md5", 16, (void (*) (void *)) md5_init_ctx,
+		   (void (*) (const void *, size_t, void *)) md5_process_bytes,
+		   (void *(*) (void *, void *)) md5_finish_ctx, NULL },
+  [VERIFY_SHA] = { "sha", 20, (void (*) (void *)) sha_init_ctx,
+		   (void (*) (const void *, size_t, void *)) sha_process_bytes,
+		   (void *(*) (void *, void *)) sha_finish_ctx, NULL },
+  [VERIFY_SHA256] = { "sha256", 32, (void (*) (void *)) sha256_init_ctx,
+		      (void (*) (const void *, size_t, void *))
+		      sha256_process_bytes,
+		      (void *(*) (void *, void *)) sha256_finish_ctx,
+		      sha256_implementation },
+  [VERIFY_BLAKE3] = { "blake3", 32, (void (*) (void *)) blake3_init_ctx,
+		      (void (*) (const void *, size_t, void *))
+		      blake3_process_bytes,
+		      (void *(*) (void *, void *)) blake3_finish_ctx,
+		      blake3_implementation }
+};
+
+/* Set when the configuration has been read for a batch of files.  */
+static int verify_configured;
 
 ssize_t
 send_file (int outfd, int infd, off_t *poff, size_t count)
@@ -119,7 +166,7 @@ checksum_file (int fd, size_t count,
 }
 
 static int
-handle_verify (int fd, const char *filename)
+handle_verify (int fd, const char *filename, FILE *out)
 {
   off_t off;
   size_t cnt;
@@ -140,49 +187,63 @@ handle_verify (int fd, const char *filename)
 	  return 1;
 	}
     }
-  else if (verify_method == VERIFY_MD5)
+  else
     {
-      struct md5_ctx ctx;
-      unsigned char bin_buffer[16];
+      const struct verify_digest *d = &verify_digests[verify_method];
+      union verify_ctx ctx;
+      unsigned char bin_buffer[VERIFY_MAX_DIGEST];
 
-      md5_init_ctx (&ctx);
-      if (checksum_file (fd, st.st_size,
-			 (void (*) (const void *, size_t, void *))
-			 md5_process_bytes, &ctx))
+      d->init (&ctx);
+      if (checksum_file (fd, st.st_size, d->process, &ctx))
 	{
 	  error (0, errno, "%s: Couldn't read temporary file", filename);
 	  return 1;
 	}
 
-      md5_finish_ctx (&ctx, bin_buffer);
-      for (cnt = 0; cnt < 16; ++cnt)
-	printf ("%02x", bin_buffer[cnt]);
-      printf ("  %s\n", filename);
+      d->finish (&ctx, bin_buffer);
+      for (cnt = 0; cnt < d->size; ++cnt)
+	fprintf (out, "%02x", bin_buffer[cnt]);
+      fprintf (out, "  %s\n", filename);
     }
-  else if (verify_method == VERIFY_SHA)
-    {
-      struct sha_ctx ctx;
-      unsigned char bin_buffer[20];
+  return 0;
+}
 
-      sha_init_ctx (&ctx);
-      if (checksum_file (fd, st.st_size,
-			 (void (*) (const void *, size_t, void *))
-			 sha_process_bytes, &ctx))
-	{
-	  error (0, errno, "%s: Couldn't read temporary file", filename);
-	  return 1;
-	}
+/* Undo DSO, whose DT_CHECKSUM shows that its allocated sections are
+   as prelink left them, into anonymous memory and output the result
+   without prelinking it again.  */
 
-      sha_finish_ctx (&ctx, bin_buffer);
-      for (cnt = 0; cnt < 20; ++cnt)
-	printf ("%02x", bin_buffer[cnt]);
-      printf ("  %s\n", filename);
+static int
+verify_in_memory (DSO *dso, const char *filename, FILE *out)
+{
+  dso->temp_in_memory = 1;
+  if (prelink_undo (dso))
+    goto failure;
+
+  switch (write_dso (dso))
+    {
+    case 2:
+      error (0, 0, "Could not write undone %s: %s", filename,
+	     elf_errmsg (-1));
+      goto failure;
+    case 1:
+      goto failure;
+    case 0:
+      break;
     }
+
+  if (handle_verify (dso->fd, filename, out))
+    goto failure;
+
+  close_dso (dso);
   return 0;
+
+failure:
+  close_dso (dso);
+  return EXIT_FAILURE;
 }
 
-int
-prelink_verify (const char *filename)
+static int
+verify_one (const char *filename, FILE *out)
 {
   DSO *dso = NULL, *dso2 = NULL;
   int fd = -1, fdorig = -1, fdundone = -1, undo, ret;
@@ -190,6 +251,7 @@ prelink_verify (const char *filename)
   struct prelink_entry *ent;
   GElf_Addr base;
   char buffer[32768], buffer2[32768];
+  unsigned char crc[4];
   size_t count;
   char *p, *q;
 
@@ -214,6 +276,13 @@ prelink_verify (const char *filename)
   if (undo == dso->ehdr.e_shnum)
     goto not_prelinked;
 
+  /* Prelink it again the same way.  prelink_undo restores the
+     original .gnu_debuglink CRC, remember the current one.  */
+  defer_debug = dso->debug_deferred;
+  compress_undo = undo_compressed (dso, undo);
+  rebase_debuginfo = undo_debuglink_crc (dso, undo, crc) == 1
+		     && get_debuglink_crc (dso, crc);
+
   if (fstat64 (dso->fd, &st2) < 0)
     {
       error (0, errno, "Couldn't fstat %s", filename);
@@ -227,11 +296,14 @@ prelink_verify (const char *filename)
       goto failure;
     }
 
-  if (read_config (prelink_conf))
-    goto failure;
+  if (! verify_configured)
+    {
+      if (read_config (prelink_conf))
+	goto failure;
 
-  if (gather_config ())
-    goto failure;
+      if (gather_config ())
+	goto failure;
+    }
 
   if (gather_object (filename, 0, 0))
     goto failure;
@@ -253,6 +325,22 @@ prelink_verify (const char *filename)
   base = dso->base;
   ent->base = base;
 
+  /* The dependencies are unchanged, so if the checksum shows the file
+     is too, prelinking it again would give the same file.  */
+  if (fast_verify)
+    {
+      if (prelink_checksum_matches (dso))
+	{
+	  if (verbose)
+	    error (0, 0, "%s: checksum matches, not prelinking it again",
+		   filename);
+	  return verify_in_memory (dso, filename, out);
+	}
+      if (verbose)
+	error (0, 0, "%s: checksum does not match, prelinking it again",
+	       filename);
+    }
+
   ret = prelink_undo (dso);
   if (ret)
     goto failure;
@@ -304,6 +392,9 @@ prelink_verify (const char *filename)
   if (prelink (dso2, ent))
     goto failure_unlink;
 
+  if (rebase_debuginfo)
+    set_debuglink_crc (dso2, crc);
+
   unlink (ent->filename);
 
   if (write_dso (dso2))
@@ -409,7 +500,7 @@ prelink_verify (const char *filename)
 	}
     }
 
-  if (handle_verify (fdundone, filename))
+  if (handle_verify (fdundone, filename, out))
     goto failure;
 
   close (fd);
@@ -437,9 +528,182 @@ not_prelinked:
     close_dso (dso);
   fd = open (filename, O_RDONLY);
   if (fd < 0)
-    error (EXIT_FAILURE, errno, "Couldn't open %s", filename);
-  if (handle_verify (fd, filename))
-    return EXIT_FAILURE;
+    {
+      error (0, errno, "Couldn't open %s", filename);
+      return EXIT_FAILURE;
+    }
+  if (handle_verify (fd, filename, out))
+    {
+      close (fd);
+      return EXIT_FAILURE;
+    }
   close (fd);
   return 0;
 }
+
+int
+prelink_verify (const char *filename)
+{
+  return verify_one (filename, stdout);
+}
+
+struct verify_batch
+{
+  char **names;
+  char *lines;
+  size_t *off;
+  char *state;
+  size_t nnames, next;
+};
+
+/* Verify one file of a batch in a child process, as verification
+   changes the prelink entries of the file and its dependencies, and
+   store its digest line in the shared line buffer.  */
+
+static int
+verify_item (size_t n, void *data)
+{
+  struct verify_batch *b = (struct verify_batch *) data;
+  int status;
+  pid_t pid;
+
+  fflush (stdout);
+  fflush (stderr);
+  pid = fork ();
+  if (pid < 0)
+    {
+      error (0, errno, "Could not verify %s", b->names[n]);
+      return 1;
+    }
+  if (pid == 0)
+    {
+      FILE *out = fmemopen (b->lines + b->off[n], b->off[n + 1] - b->off[n],
+			    "w");
+
+      if (out == NULL)
+	{
+	  error (0, errno, "Could not verify %s", b->names[n]);
+	  _exit (1);
+	}
+      status = verify_one (b->names[n], out);
+      if (fclose (out))
+	status = 1;
+      fflush (stderr);
+      _exit (status != 0);
+    }
+  while (waitpid (pid, &status, 0) < 0)
+    if (errno != EINTR)
+      {
+	error (0, errno, "Could not verify %s", b->names[n]);
+	return 1;
+      }
+  return ! WIFEXITED (status) || WEXITSTATUS (status) != 0;
+}
+
+/* Print digest lines in the order of the files, as soon as all the
+   files before them are done.  */
+
+static void
+verify_done (size_t n, int failed, void *data)
+{
+  struct verify_batch *b = (struct verify_batch *) data;
+
+  b->state[n] = failed ? 2 : 1;
+  while (b->next < b->nnames && b->state[b->next])
+    {
+      if (b->state[b->next] == 1)
+	fputs (b->lines + b->off[b->next], stdout);
+      ++b->next;
+    }
+  fflush (stdout);
+}
+
+int
+prelink_verify_batch (char **names, size_t nnames)
+{
+  struct verify_batch b;
+  size_t i, size;
+  int failures;
+
+  if (verify_method == VERIFY_CONTENT)
+    error (EXIT_FAILURE, 0, "verifying more than one library or binary requires --md5, --sha, --sha256 or --blake3");
+
+  if (read_config (prelink_conf) || gather_config ())
+    return EXIT_FAILURE;
+  verify_configured = 1;
+
+  memset (&b, 0, sizeof (b));
+  b.names = names;
+  b.nnames = nnames;
+  b.off = malloc ((nnames + 1) * sizeof (size_t));
+  b.state = calloc (nnames, 1);
+  if (b.off == NULL || b.state == NULL)
+    error (EXIT_FAILURE, ENOMEM, "Could not verify");
+  /* Room for the hex digest, two spaces, the name, newline and
+     terminating zero.  */
+  for (i = 0, size = 0; i < nnames; ++i)
+    {
+      b.off[i] = size;
+      size += 2 * VERIFY_MAX_DIGEST + 4 + strlen (names[i]);
+    }
+  b.off[nnames] = size;
+  b.lines = mmap (NULL, size ?: 1, PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (b.lines == MAP_FAILED)
+    error (EXIT_FAILURE, errno, "Could not verify");
+
+  failures = run_jobs (nnames, verify_item, verify_done, &b, "verify");
+
+  munmap (b.lines, size ?: 1);
+  free (b.off);
+  free (b.state);
+  return failures ? EXIT_FAILURE : 0;
+}
+
+/* Time all digests --verify can print on NAMES, as read through
+   checksum_file, and print their throughput.  Each digest gets at
+   least a second, so that small files give meaningful numbers too.  */
+int
+prelink_digest_benchmark (char **names, size_t nnames)
+{
+  enum verify_method_t m;
+
+  for (m = VERIFY_MD5; m <= VERIFY_BLAKE3; ++m)
+    {
+      const struct verify_digest *d = &verify_digests[m];
+      union verify_ctx ctx;
+      unsigned char bin_buffer[VERIFY_MAX_DIGEST];
+      struct timeval start, now;
+      double elapsed;
+      uint64_t bytes = 0;
+      size_t i;
+
+      gettimeofday (&start, NULL);
+      do
+	{
+	  for (i = 0; i < nnames; ++i)
+	    {
+	      struct stat64 st;
+	      int fd = open (names[i], O_RDONLY);
+
+	      if (fd < 0 || fstat64 (fd, &st) < 0)
+		error (EXIT_FAILURE, errno, "Could not open %s", names[i]);
+	      d->init (&ctx);
+	      if (checksum_file (fd, st.st_size, d->process, &ctx))
+		error (EXIT_FAILURE, errno, "Could not read %s", names[i]);
+	      d->finish (&ctx, bin_buffer);
+	      close (fd);
+	      bytes += st.st_size;
+	    }
+	  gettimeofday (&now, NULL);
+	  elapsed = (now.tv_sec - start.tv_sec)
+		    + (now.tv_usec - start.tv_usec) / 1000000.0;
+	}
+      while (elapsed < 1.0);
+
+      printf ("%-8s %-8s %10.1f MB/s\n", d->name,
+	      d->implementation ? d->implementation () : "C",
+	      bytes / elapsed / (1024 * 1024));
+    }
+  return 0;
+}
@@ -0,0 +1,16 @@
+struct V
+  {
+    virtual int v ();
+    int x;
+  };
+struct D : virtual V
+  {
+    virtual int d ();
+    int y;
+  };
+struct E : D
+  {
+    virtual int e ();
+  };
+
+int do_check (E *x);
@@ -0,0 +1,45 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that conflicts in VTTs are removed like those in virtual tables,
+# and that the conflicts dropped as redundant are not in .gnu.conflict.
+rm -f cxx4 cxx4lib*.so cxx4.log
+rm -f prelink.cache
+$CXX -shared -O2 -fpic -o cxx4lib1.so $srcdir/cxx4lib1.C
+$CXX -shared -O2 -fpic -o cxx4lib2.so $srcdir/cxx4lib2.C cxx4lib1.so
+BINS="cxx4"
+LIBS="cxx4lib1.so cxx4lib2.so"
+$CXXLINK -o cxx4 $srcdir/cxx4.C -Wl,--rpath-link,. cxx4lib2.so cxx4lib1.so
+savelibs
+echo $PRELINK -vvvv ${PRELINK_OPTS--vm} ./cxx4 > cxx4.log
+$PRELINK -vvvv ${PRELINK_OPTS--vm} ./cxx4 >> cxx4.log 2>&1 || exit 1
+grep ^`echo $PRELINK | sed 's/ .*$/: /'` cxx4.log \
+  | grep -v 'C++ conflict' | grep -q -v 'Removing conflict at' && exit 2
+case "`uname -m`" in
+  arm*) ;; # EABI says that vtables/typeinfo aren't vague linkage if there is a key method
+  *) grep -q 'Removing C++ conflict .*:_ZTT1D+' cxx4.log || exit 3;;
+esac
+LD_LIBRARY_PATH=. ./cxx4 || exit 4
+readelf -a ./cxx4 >> cxx4.log 2>&1 || exit 5
+readelf -Wr ./cxx4 | sed -n '/\.gnu\.conflict/,/^$/p' \
+  | awk '$1 ~ /^[0-9a-f]+$/ { print $1 }' > cxx4.conflicts
+# .gnu.conflict has as many entries as were left after folding, and
+# none of those reported as dropped.
+n=`sed -n 's/^\.\/cxx4: [0-9]* conflicts, \([0-9]*\) after removing redundant ones$/\1/p' cxx4.log`
+test -n "$n" || exit 6
+test `wc -l < cxx4.conflicts` -eq $n || exit 7
+for a in `sed -n 's/^.*Removing conflict at \([0-9a-f]*\),.*$/\1/p' cxx4.log`; do
+  grep -q "^0*$a\$" cxx4.conflicts && exit 8
+done
+# Nor may any conflict be left in the VTTs of cxx4lib1.so.
+readelf -Ws cxx4lib1.so | awk '$8 ~ /^_ZTT/ { print $2, $3 }' | sort -u \
+  | while read addr size; do
+  awk -v lo=$((0x$addr)) -v hi=$((0x$addr + $size)) '
+    { n = 0
+      for (i = 1; i <= length($1); i++)
+	n = n * 16 + index("0123456789abcdef", substr($1, i, 1)) - 1
+      if (n >= lo && n < hi) exit 1 }' cxx4.conflicts || exit 1
+done || exit 9
+rm -f cxx4.conflicts
+# So that it is not prelinked again
+chmod -x ./cxx4
+comparelibs >> cxx4.log 2>&1 || exit 10
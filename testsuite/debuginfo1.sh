@@ -0,0 +1,32 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that --rebase-debuginfo adjusts separate debuginfo files.
+objcopy --help 2>/dev/null | grep -q add-gnu-debuglink || exit 77
+rm -f debuginfo1 debuginfo1lib*.so debuginfo1lib*.so.debug debuginfo1.log
+rm -f prelink.cache
+$CC -shared -O2 -fpic -g -o debuginfo1lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -fpic -g -o debuginfo1lib2.so $srcdir/reloc1lib2.c debuginfo1lib1.so
+objcopy --only-keep-debug debuginfo1lib1.so debuginfo1lib1.so.debug
+objcopy --strip-debug --add-gnu-debuglink=debuginfo1lib1.so.debug debuginfo1lib1.so
+BINS="debuginfo1"
+LIBS="debuginfo1lib1.so debuginfo1lib2.so"
+$CCLINK -o debuginfo1 $srcdir/reloc1.c -Wl,--rpath-link,. debuginfo1lib2.so -lc debuginfo1lib1.so
+savelibs
+cp -p debuginfo1lib1.so.debug debuginfo1lib1.so.debug.orig
+echo $PRELINK ${PRELINK_OPTS--vm} --rebase-debuginfo --debuginfo-dir=/nonexistent ./debuginfo1 > debuginfo1.log
+$PRELINK ${PRELINK_OPTS--vm} --rebase-debuginfo --debuginfo-dir=/nonexistent ./debuginfo1 >> debuginfo1.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` debuginfo1.log && exit 2
+LD_LIBRARY_PATH=. ./debuginfo1 || exit 3
+readelf -a ./debuginfo1 >> debuginfo1.log 2>&1 || exit 4
+# The DW_AT_low_pc of f1 in the debuginfo file must follow the library.
+addr=`readelf -Ws debuginfo1lib1.so | awk '$8 == "f1" { print $2; exit }'`
+lowpc=`readelf -wi debuginfo1lib1.so.debug | awk '/DW_AT_name.*: f1$/ { f = 1 } f && /DW_AT_low_pc/ { print $NF; exit }'`
+test -n "$addr" -a -n "$lowpc" || exit 5
+test $((0x$addr)) -eq $(($lowpc)) || exit 6
+symaddr=`readelf -Ws debuginfo1lib1.so.debug | awk '$8 == "f1" { print $2; exit }'`
+test "$addr" = "$symaddr" || exit 7
+# Undoing must give back both original files.
+echo $PRELINK -u --rebase-debuginfo --debuginfo-dir=/nonexistent debuginfo1lib1.so >> debuginfo1.log
+$PRELINK -u --rebase-debuginfo --debuginfo-dir=/nonexistent debuginfo1lib1.so >> debuginfo1.log 2>&1 || exit 8
+cmp -s debuginfo1lib1.so.orig debuginfo1lib1.so || exit 9
+cmp -s debuginfo1lib1.so.debug.orig debuginfo1lib1.so.debug || exit 10
@@ -0,0 +1,41 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that --verify and --undo give back the original .gnu_debuglink
+# CRC after --rebase-debuginfo changed it.
+objcopy --help 2>/dev/null | grep -q add-gnu-debuglink || exit 77
+rm -f debuginfo2 debuginfo2lib*.so debuginfo2lib*.so.debug debuginfo2.log
+rm -f debuginfo2.first debuginfo2.second
+rm -f prelink.cache
+$CC -shared -O2 -fpic -g -o debuginfo2lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -fpic -g -o debuginfo2lib2.so $srcdir/reloc1lib2.c debuginfo2lib1.so
+objcopy --only-keep-debug debuginfo2lib1.so debuginfo2lib1.so.debug
+objcopy --strip-debug --add-gnu-debuglink=debuginfo2lib1.so.debug debuginfo2lib1.so
+BINS="debuginfo2"
+LIBS="debuginfo2lib1.so debuginfo2lib2.so"
+$CCLINK -o debuginfo2 $srcdir/reloc1.c -Wl,--rpath-link,. debuginfo2lib2.so -lc debuginfo2lib1.so
+savelibs
+cp -p debuginfo2lib1.so.debug debuginfo2lib1.so.debug.orig
+echo $PRELINK ${PRELINK_OPTS--vm} --rebase-debuginfo --debuginfo-dir=/nonexistent ./debuginfo2 > debuginfo2.log
+$PRELINK ${PRELINK_OPTS--vm} --rebase-debuginfo --debuginfo-dir=/nonexistent ./debuginfo2 >> debuginfo2.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` debuginfo2.log && exit 2
+LD_LIBRARY_PATH=. ./debuginfo2 || exit 3
+readelf -a ./debuginfo2 >> debuginfo2.log 2>&1 || exit 4
+# The debuginfo file was adjusted, so the CRC must have changed.
+cmp -s debuginfo2lib1.so.debug.orig debuginfo2lib1.so.debug && exit 5
+readelf -x .gnu_debuglink debuginfo2lib1.so.orig > debuginfo2.first 2>&1
+readelf -x .gnu_debuglink debuginfo2lib1.so > debuginfo2.second 2>&1
+cmp -s debuginfo2.first debuginfo2.second && exit 6
+for i in $LIBS $BINS; do
+  echo "`md5sum < $i.orig | sed 's/ .*$//'`  $i"
+done > debuginfo2.first
+echo $PRELINK --md5 -y $LIBS $BINS >> debuginfo2.log
+$PRELINK --md5 -y $LIBS $BINS > debuginfo2.second 2>> debuginfo2.log || exit 7
+cmp -s debuginfo2.first debuginfo2.second || exit 8
+rm -f debuginfo2.second
+# So that it is not prelinked again
+chmod -x ./debuginfo2
+comparelibs >> debuginfo2.log 2>&1 || exit 9
+# The debuginfo file is left alone when undoing without
+# --rebase-debuginfo.
+cmp -s debuginfo2lib1.so.debug.orig debuginfo2lib1.so.debug && exit 10
+exit 0
@@ -0,0 +1,64 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that the line tables, range and location lists and .debug_addr
+# of DWARF 5 libraries follow them when they are relocated with -r,
+# for 32-bit and 64-bit DWARF and for split DWARF skeletons.
+rm -f dwarf1lib*.so dwarf1lib*.so.* dwarf1*.dwo dwarf1*.o dwarf1.log
+# -gsplit-dwarf needs a real output file to name the .dwo after.
+echo 'int i;' | $CC -gdwarf-5 -gdwarf64 -gsplit-dwarf -xc -c -o dwarf1probe.o - > /dev/null 2>&1 || exit 77
+rm -f dwarf1probe.o dwarf1probe.dwo
+# Dump the debug sections of $1, adding $2 to all addresses, with
+# spacing normalized.
+dwarfdump() {
+  readelf -wN --debug-dump=Ranges,loc,addr,decodedline $1 2>&1 | awk -v delta=$2 '
+function hex2num(s,  i, n) {
+  n = 0
+  for (i = 1; i <= length(s); i++)
+    n = n * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+  return n
+}
+function num2hex(n, w,  s) {
+  s = ""
+  do { s = substr("0123456789abcdef", n % 16 + 1, 1) s; n = int(n / 16) } while (n > 0)
+  while (length(s) < w) s = "0" s
+  return s
+}
+{ $1 = $1
+  # Lines start with a section offset, except for the address ranges
+  # which follow "views at ... for:" in location lists.
+  for (i = last ~ /for:$/ ? 1 : 2; i <= NF; i++)
+    if ($i ~ /^[0-9a-f]+$/ && length($i) >= 8 && $(i - 1) != "at")
+      $i = num2hex(hex2num($i) + delta, length($i))
+    else if (i == 3 && $i ~ /^0x[0-9a-f]+$/ && ($2 ~ /^[0-9]+$/ || $2 == "-"))
+      $i = "0x" num2hex(hex2num(substr($i, 3)) + delta, 1)
+    else if ($(i - 1) == "DW_OP_addr:" && match($i, /^[0-9a-f]+/))
+      $i = num2hex(hex2num(substr($i, 1, RLENGTH)) + delta, 1) substr($i, RLENGTH + 1)
+  last = $0
+  print
+}'
+}
+$CC -shared -O2 -fpic -g -gdwarf-5 -DNAME=dwarf1lib1 -o dwarf1lib1.so $srcdir/dwarf1lib1.c
+$CC -shared -O2 -fpic -g -gdwarf-5 -gdwarf64 -DNAME=dwarf1lib2 -o dwarf1lib2.so $srcdir/dwarf1lib1.c
+$CC -shared -O2 -fpic -g -gdwarf-5 -gsplit-dwarf -DNAME=dwarf1lib3 -o dwarf1lib3.so $srcdir/dwarf1lib1.c
+LIBS="dwarf1lib1.so dwarf1lib2.so dwarf1lib3.so"
+echo -n > dwarf1.log
+for i in $LIBS; do
+  cp -p $i $i.orig
+  echo $PRELINK -r 0x41000000 $i >> dwarf1.log
+  $PRELINK -r 0x41000000 $i >> dwarf1.log 2>&1 || exit 1
+done
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` dwarf1.log && exit 2
+for i in $LIBS; do
+  old=`readelf -Wl $i.orig | awk '$1 == "LOAD" { print $3; exit }'`
+  new=`readelf -Wl $i | awk '$1 == "LOAD" { print $3; exit }'`
+  test -n "$old" -a -n "$new" || exit 3
+  test $(($new)) -ne $(($old)) || exit 4
+  dwarfdump $i.orig $(($new - $old)) > $i.first
+  dwarfdump $i 0 > $i.second
+  diff -u $i.first $i.second >> dwarf1.log 2>&1 || exit 5
+done
+# Make sure the interesting parts were there to compare.
+grep -q 'location view pair' dwarf1lib1.so.second || exit 6
+grep -q 'location view pair' dwarf1lib2.so.second || exit 7
+grep -q 'debug_addr' dwarf1lib3.so.second || exit 8
+grep -q 'debug_rnglists' dwarf1lib3.so.second || exit 9
@@ -0,0 +1,42 @@
+#include <stdlib.h>
+
+static int counter;
+
+static int __attribute__((noinline))
+step (int x)
+{
+  return x * 3 + counter;
+}
+
+static int __attribute__((noinline))
+sum (int *p, int n)
+{
+  int i, s = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      int v = step (p[i]);
+      if (__builtin_expect (v < 0, 0))
+	abort ();
+      s += v;
+    }
+  return s;
+}
+
+static int __attribute__((noinline))
+first (int *p, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    if (p[i] == counter)
+      return i;
+  return -1;
+}
+
+int
+NAME (int *p, int n)
+{
+  counter = n;
+  return sum (p, n) + first (p, n);
+}
@@ -0,0 +1,37 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that --defer-debug leaves debug info alone and --apply-debug
+# adjusts it later.
+rm -f dwarf3 dwarf3lib*.so dwarf3.log
+rm -f prelink.cache
+$CC -shared -O2 -fpic -g -o dwarf3lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -fpic -g -o dwarf3lib2.so $srcdir/reloc1lib2.c dwarf3lib1.so
+BINS="dwarf3"
+LIBS="dwarf3lib1.so dwarf3lib2.so"
+$CCLINK -g -o dwarf3 $srcdir/reloc1.c -Wl,--rpath-link,. dwarf3lib2.so -lc dwarf3lib1.so
+savelibs
+lowpc0=`readelf -wi dwarf3lib1.so | awk '/DW_AT_name.*: f1$/ { f = 1 } f && /DW_AT_low_pc/ { print $NF; exit }'`
+echo $PRELINK ${PRELINK_OPTS--vm} --defer-debug ./dwarf3 > dwarf3.log
+$PRELINK ${PRELINK_OPTS--vm} --defer-debug ./dwarf3 >> dwarf3.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` dwarf3.log && exit 2
+LD_LIBRARY_PATH=. ./dwarf3 || exit 3
+readelf -a ./dwarf3 >> dwarf3.log 2>&1 || exit 4
+# The DW_AT_low_pc of f1 must not have been touched yet.
+addr=`readelf -Ws dwarf3lib1.so | awk '$8 == "f1" { print $2; exit }'`
+lowpc=`readelf -wi dwarf3lib1.so | awk '/DW_AT_name.*: f1$/ { f = 1 } f && /DW_AT_low_pc/ { print $NF; exit }'`
+test -n "$addr" -a -n "$lowpc" -a -n "$lowpc0" || exit 6
+test $(($lowpc0)) -eq $(($lowpc)) || exit 7
+readelf -S dwarf3lib1.so | grep -q '\.gnu\.prelink_debug' || exit 8
+# So that it is not prelinked again
+chmod -x ./dwarf3
+comparelibs >> dwarf3.log 2>&1 || exit 5
+echo $PRELINK --apply-debug dwarf3lib1.so >> dwarf3.log
+$PRELINK --apply-debug dwarf3lib1.so >> dwarf3.log 2>&1 || exit 9
+lowpc=`readelf -wi dwarf3lib1.so | awk '/DW_AT_name.*: f1$/ { f = 1 } f && /DW_AT_low_pc/ { print $NF; exit }'`
+test $((0x$addr)) -eq $(($lowpc)) || exit 10
+readelf -S dwarf3lib1.so | grep -q '\.gnu\.prelink_debug' && exit 11
+LD_LIBRARY_PATH=. ./dwarf3 || exit 12
+cp -p dwarf3lib1.so dwarf3lib1.so.new
+$PRELINK -u dwarf3lib1.so.new >> dwarf3.log 2>&1 || exit 13
+cmp -s dwarf3lib1.so.orig dwarf3lib1.so.new || exit 14
+rm -f dwarf3lib1.so.new
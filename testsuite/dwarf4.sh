@@ -0,0 +1,20 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that adjusting debug info with several threads, one unit each,
+# gives the same result as adjusting it in one go.
+echo 'int i;' | $CC -gdwarf-5 -xc -c -o /dev/null - > /dev/null 2>&1 || exit 77
+rm -f dwarf4lib*.so dwarf4lib*.so.* dwarf4*.o dwarf4.log
+for i in 1 2 3 4 5; do
+  $CC -O2 -fpic -g -gdwarf-5 -DNAME=dwarf4lib$i -c -o dwarf4lib$i.o $srcdir/dwarf1lib1.c
+done
+$CC -shared -O2 -fpic -g -gdwarf-5 -o dwarf4lib1.so dwarf4lib[1-5].o
+rm -f dwarf4lib*.o
+test `readelf -wi dwarf4lib1.so | grep -c 'Compilation Unit @'` -eq 5 || exit 1
+cp -p dwarf4lib1.so dwarf4lib1.so.orig
+cp -p dwarf4lib1.so dwarf4lib1.so.threads
+echo $PRELINK -r 0x41000000 dwarf4lib1.so > dwarf4.log
+$PRELINK -r 0x41000000 dwarf4lib1.so >> dwarf4.log 2>&1 || exit 2
+echo PRELINK_DWARF2_CHUNK=1 $PRELINK -r 0x41000000 dwarf4lib1.so.threads >> dwarf4.log
+PRELINK_DWARF2_CHUNK=1 $PRELINK -r 0x41000000 dwarf4lib1.so.threads >> dwarf4.log 2>&1 || exit 3
+cmp -s dwarf4lib1.so dwarf4lib1.so.orig && exit 4
+cmp dwarf4lib1.so dwarf4lib1.so.threads >> dwarf4.log 2>&1 || exit 5
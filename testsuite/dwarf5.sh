@@ -0,0 +1,25 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that DWARF abbreviation codes with large gaps, too sparse for
+# the dense index, are found just like with the uncached lookup.
+rm -f dwarf5lib*.so dwarf5lib*.so.* dwarf5.log
+$CC -shared -O2 -fpic -o dwarf5lib1.so $srcdir/dwarf5lib1.c
+test `readelf -wi dwarf5lib1.so | grep -c 'Compilation Unit @'` -eq 3 || exit 1
+readelf -wi dwarf5lib1.so | grep -q 'Abbrev Number: 131072 ' || exit 2
+cp -p dwarf5lib1.so dwarf5lib1.so.orig
+cp -p dwarf5lib1.so dwarf5lib1.so.nocache
+echo $PRELINK -r 0x41000000 dwarf5lib1.so > dwarf5.log
+$PRELINK -r 0x41000000 dwarf5lib1.so >> dwarf5.log 2>&1 || exit 3
+echo PRELINK_DWARF2_NO_ABBREV_CACHE=1 $PRELINK -r 0x41000000 dwarf5lib1.so.nocache >> dwarf5.log
+PRELINK_DWARF2_NO_ABBREV_CACHE=1 $PRELINK -r 0x41000000 dwarf5lib1.so.nocache >> dwarf5.log 2>&1 || exit 4
+cmp -s dwarf5lib1.so dwarf5lib1.so.orig && exit 5
+cmp dwarf5lib1.so dwarf5lib1.so.nocache >> dwarf5.log 2>&1 || exit 6
+# The variables' DW_OP_addr must have moved along with them.
+for i in 1 2 3; do
+  var=`readelf -Ws dwarf5lib1.so | awk '$8 == "dwarf5var'$i'" { print $2; exit }'`
+  loc=`readelf -wi dwarf5lib1.so | sed -n 's/^.*(DW_OP_addr: \([0-9a-f]*\))/\1/p' \
+       | sed -n ${i}p`
+  test -n "$var" -a -n "$loc" || exit 7
+  test $((0x$var)) -eq $((0x$loc)) || exit 8
+done
+exit 0
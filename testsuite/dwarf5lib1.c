@@ -0,0 +1,69 @@
+/* Debug info with sparse DWARF abbreviation codes.  Compilers number
+   abbreviations 1, 2, 3, ..., so it has to be written by hand.  The
+   first two units share a table with codes far apart, the last one
+   uses a mostly dense table with one code well past the rest.  */
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#if __SIZEOF_POINTER__ == 8
+# define ADDR ".quad "
+#else
+# define ADDR ".long "
+#endif
+
+int dwarf5var1 = 1, dwarf5var2 = 2, dwarf5var3 = 3;
+
+int dwarf5fn1 (void) { return dwarf5var1; }
+int dwarf5fn2 (void) { return dwarf5var2; }
+int dwarf5fn3 (void) { return dwarf5var3; }
+
+#define ABBREV(code, tag, children) \
+  ".uleb128 " #code "; .uleb128 " #tag "; .byte " #children "\n\t"
+#define ABBREV_ATTR(attr, form) \
+  ".uleb128 " #attr "; .uleb128 " #form "\n\t"
+#define ABBREV_END ".byte 0, 0\n\t"
+
+/* DW_TAG_compile_unit with DW_AT_producer, DW_TAG_base_type with
+   DW_AT_name, DW_AT_byte_size and DW_AT_encoding, DW_TAG_subprogram
+   with DW_AT_name, DW_AT_type, DW_AT_low_pc and DW_AT_high_pc, and
+   DW_TAG_variable with DW_AT_name, DW_AT_type and DW_AT_location.  */
+#define ABBREVS(cu, base, fn, var) \
+  ABBREV (cu, 0x11, 1) ABBREV_ATTR (0x25, 0x08) ABBREV_END		\
+  ABBREV (base, 0x24, 0) ABBREV_ATTR (0x03, 0x08)			\
+  ABBREV_ATTR (0x0b, 0x0b) ABBREV_ATTR (0x3e, 0x0b) ABBREV_END		\
+  ABBREV (fn, 0x2e, 0) ABBREV_ATTR (0x03, 0x08)				\
+  ABBREV_ATTR (0x49, 0x13) ABBREV_ATTR (0x11, 0x01)			\
+  ABBREV_ATTR (0x12, 0x01) ABBREV_END					\
+  ABBREV (var, 0x34, 0) ABBREV_ATTR (0x03, 0x08)			\
+  ABBREV_ATTR (0x49, 0x13) ABBREV_ATTR (0x02, 0x18) ABBREV_END
+
+#define UNIT(n, abbrev, cu, base, fn, var) \
+  ".long .Ldwarf5end" #n " - .Ldwarf5start" #n "\n"			\
+  ".Ldwarf5start" #n ":\n\t"						\
+  ".2byte 4; .long " abbrev "; .byte " XSTR (__SIZEOF_POINTER__) "\n"	\
+  ".Ldwarf5cu" #n ":\n\t"							\
+  ".uleb128 " #cu "; .string \"dwarf5lib1.c\"\n"			\
+  ".Ldwarf5int" #n ":\n\t"						\
+  ".uleb128 " #base "; .string \"int\"; .byte 4, 5\n\t"			\
+  ".uleb128 " #fn "; .string \"dwarf5fn" #n "\"\n\t"			\
+  ".long .Ldwarf5int" #n " - .Ldwarf5cu" #n " + 11\n\t"			\
+  ADDR "dwarf5fn" #n "; " ADDR "dwarf5fn" #n " + 1\n\t"			\
+  ".uleb128 " #var "; .string \"dwarf5var" #n "\"\n\t"			\
+  ".long .Ldwarf5int" #n " - .Ldwarf5cu" #n " + 11\n\t"			\
+  ".uleb128 " XSTR (__SIZEOF_POINTER__) " + 1; .byte 3\n\t"		\
+  ADDR "dwarf5var" #n "\n\t"						\
+  ".byte 0\n"								\
+  ".Ldwarf5end" #n ":\n\t"
+
+asm (".pushsection .debug_abbrev,\"\",%progbits\n"
+     ".Ldwarf5sparse:\n\t"
+     ABBREVS (0x1001, 7, 0x9999, 0x20000)
+     ".byte 0\n"
+     ".Ldwarf5dense:\n\t"
+     ABBREVS (1, 2, 3, 80)
+     ".byte 0\n\t"
+     ".popsection\n\t"
+     ".pushsection .debug_info,\"\",%progbits\n\t"
+     UNIT (1, ".Ldwarf5sparse", 0x1001, 7, 0x9999, 0x20000)
+     UNIT (2, ".Ldwarf5sparse", 0x1001, 7, 0x9999, 0x20000)
+     UNIT (3, ".Ldwarf5dense", 1, 2, 3, 80)
+     ".popsection");
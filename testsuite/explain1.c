@@ -0,0 +1,12 @@
+#include <stdlib.h>
+
+extern int *pfoo;
+extern int getfoo (void);
+extern int getbar (void);
+
+int main()
+{
+  if (*pfoo != 2 || getfoo () != 2 || getbar () != 3)
+    abort ();
+  exit (0);
+}
@@ -0,0 +1,44 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that --explain-conflicts reports the interposed symbols with
+# the relocations left in .gnu.conflict, not those removed later.
+rm -f explain1 explain1cxx explain1lib*.so explain1.log explain1.out
+rm -f prelink.cache
+$CC -shared -O2 -fpic -o explain1lib1.so $srcdir/explain1lib1.c
+$CC -shared -O2 -fpic -o explain1lib2.so $srcdir/explain1lib2.c explain1lib1.so
+$CXX -shared -O2 -fpic -o explain1lib3.so $srcdir/cxx4lib1.C
+$CXX -shared -O2 -fpic -o explain1lib4.so $srcdir/cxx4lib2.C explain1lib3.so
+BINS="explain1 explain1cxx"
+LIBS="explain1lib1.so explain1lib2.so explain1lib3.so explain1lib4.so"
+$CCLINK -o explain1 $srcdir/explain1.c -Wl,--rpath-link,. explain1lib2.so explain1lib1.so
+$CXXLINK -o explain1cxx $srcdir/cxx4.C -Wl,--rpath-link,. explain1lib4.so explain1lib3.so
+savelibs
+echo $PRELINK --explain-conflicts ./explain1 ./explain1cxx > explain1.log
+$PRELINK --explain-conflicts ./explain1 ./explain1cxx > explain1.out 2>> explain1.log || exit 1
+cat explain1.out >> explain1.log
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` explain1.log && exit 2
+LD_LIBRARY_PATH=. ./explain1 || exit 3
+LD_LIBRARY_PATH=. ./explain1cxx || exit 4
+readelf -a ./explain1 ./explain1cxx >> explain1.log 2>&1 || exit 5
+dir=`pwd -P`
+for i in $BINS; do
+  n=`readelf -Wr ./$i | sed -n '/\.gnu\.conflict/,/^$/p' | grep -c '^ *[0-9a-f]\+ '`
+  grep -q "^$dir/$i: $n conflicts applied at startup, " explain1.out || exit 6
+  # Conflicts removed by the C++ pass or as redundant must not be
+  # counted.
+  sum=`awk -v bin="$dir/$i:" '
+    $1 == bin { p = 1; next }
+    /^[^ ]/ { p = 0 }
+    p && / interposes / { s += $(NF - 1) }
+    END { print s + 0 }' explain1.out`
+  test $sum -le $n || exit 7
+done
+case "`uname -m`" in
+  x86_64|i?86)
+    grep -q "^  $dir/explain1lib2.so interposes $dir/explain1lib1.so: 1 symbols, 2 relocations\$" explain1.out || exit 8
+    grep -q '^    foo [a-z]* 2$' explain1.out || exit 9;;
+esac
+grep -q "^$dir/explain1lib2.so	" explain1.out || exit 10
+# So that it is not prelinked again
+chmod -x ./explain1 ./explain1cxx
+comparelibs >> explain1.log 2>&1 || exit 11
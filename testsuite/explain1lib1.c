@@ -0,0 +1,7 @@
+int foo = 1;
+int *pfoo = &foo;
+
+int getfoo (void)
+{
+  return foo;
+}
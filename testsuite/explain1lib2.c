@@ -0,0 +1,6 @@
+int foo = 2;
+
+int getbar (void)
+{
+  return 3;
+}
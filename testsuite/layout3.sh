@@ -0,0 +1,54 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that --layout-coloring gives libraries which are used together
+# disjoint slots and lets libraries which never are share addresses.
+rm -f prelink.cache
+rm -f layout3a layout3b layout3lib*.so layout3.log
+BINS="layout3a layout3b"
+LIBS=
+i=1
+while [ $i -lt 7 ]; do
+  $CC -shared -fpic -o layout3lib$i.so $srcdir/layout3lib.c
+  LIBS="$LIBS layout3lib$i.so"
+  i=`expr $i + 1`
+done
+$CCLINK -o layout3a $srcdir/layout3.c -Wl,--no-as-needed \
+  layout3lib1.so layout3lib2.so layout3lib3.so
+$CCLINK -o layout3b $srcdir/layout3.c -Wl,--no-as-needed \
+  layout3lib4.so layout3lib5.so layout3lib6.so
+savelibs
+echo $PRELINK -v --layout-coloring ./layout3a ./layout3b > layout3.log
+$PRELINK -v --layout-coloring ./layout3a ./layout3b >> layout3.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout3.log && exit 2
+LD_LIBRARY_PATH=. ./layout3a || exit 3
+LD_LIBRARY_PATH=. ./layout3b || exit 4
+readelf -a ./layout3a ./layout3b >> layout3.log 2>&1 || exit 5
+grep -q '^Libraries use 0x[0-9a-f]* bytes of virtual address space$' \
+  layout3.log || exit 6
+# Print the slot assigned to library $1 as decimal start and end.
+slot() {
+  set -- `sed -n "s,^\(.*/\)\?$1 *\([0-9a-f]*\)-\([0-9a-f]*\)\$,\2 \3,p" \
+	  layout3.log`
+  test $# -eq 2 && echo $((0x$1)) $((0x$2))
+}
+overlap() {
+  set -- `slot $1` `slot $2`
+  test $# -eq 4 || exit 7
+  test $1 -lt $4 -a $3 -lt $2
+}
+# Libraries of one binary must not overlap each other...
+for p in "1 2" "1 3" "2 3" "4 5" "4 6" "5 6"; do
+  set -- $p
+  overlap layout3lib$1.so layout3lib$2.so && exit 8
+done
+# ...but libraries of different binaries can share slots.
+shared=0
+for i in 1 2 3; do
+  for j in 4 5 6; do
+    overlap layout3lib$i.so layout3lib$j.so && shared=1
+  done
+done
+test $shared -eq 1 || exit 9
+# So that it is not prelinked again
+chmod -x ./layout3a ./layout3b
+comparelibs >> layout3.log 2>&1 || exit 10
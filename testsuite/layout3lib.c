@@ -0,0 +1,11 @@
+#ifndef LAYOUTLIB_SIZE
+#define LAYOUTLIB_SIZE 4096
+#endif
+
+int layoutlib[LAYOUTLIB_SIZE];
+
+int
+layoutfn (void)
+{
+  return layoutlib[0];
+}
@@ -0,0 +1,58 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that --stable-layout resolves overlaps by moving as few
+# libraries as possible and keeps the bases of the others.
+rm -f prelink.cache
+rm -f layout4a layout4b layout4c layout4d layout4lib*.so layout4.log
+BINS="layout4a layout4b layout4c layout4d"
+LIBS=
+i=1
+while [ $i -lt 4 ]; do
+  $CC -shared -fpic -o layout4lib$i.so $srcdir/layout3lib.c
+  LIBS="$LIBS layout4lib$i.so"
+  i=`expr $i + 1`
+done
+# Big enough to overlap the slots of two of the others.
+$CC -shared -fpic -DLAYOUTLIB_SIZE=1048576 -o layout4lib4.so \
+  $srcdir/layout3lib.c
+LIBS="$LIBS layout4lib4.so"
+$CCLINK -o layout4a $srcdir/layout3.c -Wl,--no-as-needed \
+  layout4lib1.so layout4lib2.so layout4lib3.so
+$CCLINK -o layout4c $srcdir/layout3.c -Wl,--no-as-needed layout4lib4.so
+$CCLINK -o layout4d $srcdir/layout3.c -Wl,--no-as-needed layout4lib4.so
+# Print the base address of $1.
+base() {
+  readelf -Wl $1 | awk '$1 == "LOAD" { print $3; exit }'
+}
+echo $PRELINK -v ./layout4a > layout4.log
+$PRELINK -v ./layout4a >> layout4.log 2>&1 || exit 1
+# Without the cache, layout4lib4.so gets the slots of the others.
+rm -f prelink.cache
+echo $PRELINK -v ./layout4c ./layout4d >> layout4.log
+$PRELINK -v ./layout4c ./layout4d >> layout4.log 2>&1 || exit 2
+test `base layout4lib4.so` = `base layout4lib1.so` || exit 3
+# Adding a binary which uses all of them makes layout4lib4.so overlap
+# layout4lib1.so and layout4lib2.so.  Moving just layout4lib4.so,
+# although it is the most widely used one, resolves both.
+$CCLINK -o layout4b $srcdir/layout3.c -Wl,--no-as-needed \
+  layout4lib1.so layout4lib2.so layout4lib3.so layout4lib4.so
+for i in 1 2 3 4; do
+  eval base$i=`base layout4lib$i.so`
+done
+savelibs
+echo $PRELINK -v --stable-layout ./layout4a ./layout4b ./layout4c ./layout4d >> layout4.log
+$PRELINK -v --stable-layout ./layout4a ./layout4b ./layout4c ./layout4d >> layout4.log 2>&1 || exit 4
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout4.log && exit 5
+grep '^Predicted' layout4.log | tail -n 1 \
+  | grep -q '^Predicted 1 libraries to be relocated' || exit 6
+for i in 1 2 3; do
+  test `base layout4lib$i.so` = `eval echo \\$base$i` || exit 7
+done
+test `base layout4lib4.so` = $base4 && exit 8
+for i in a b c d; do
+  LD_LIBRARY_PATH=. ./layout4$i || exit 9
+done
+readelf -a ./layout4b >> layout4.log 2>&1 || exit 10
+# So that it is not prelinked again
+chmod -x ./layout4a ./layout4b ./layout4c ./layout4d
+comparelibs >> layout4.log 2>&1 || exit 11
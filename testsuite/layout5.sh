@@ -0,0 +1,68 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that --hot-libs and --hot-libs-count lay the hot libraries out
+# before the other libraries, on 2MB boundaries.
+rm -f prelink.cache
+rm -f layout5 layout5b layout5c layout5lib*.so layout5.log layout5.hot
+BINS="layout5 layout5b layout5c"
+LIBS=
+i=1
+while [ $i -lt 5 ]; do
+  $CC -shared -fpic -Wl,-soname,layout5lib$i.so -o layout5lib$i.so \
+    $srcdir/layout3lib.c
+  LIBS="$LIBS layout5lib$i.so"
+  i=`expr $i + 1`
+done
+$CCLINK -o layout5 $srcdir/layout3.c -Wl,--no-as-needed \
+  layout5lib1.so layout5lib2.so layout5lib3.so layout5lib4.so
+$CCLINK -o layout5b $srcdir/layout3.c -Wl,--no-as-needed layout5lib2.so
+$CCLINK -o layout5c $srcdir/layout3.c -Wl,--no-as-needed layout5lib2.so
+savelibs
+# Print the slots assigned to layout5lib*.so in the last run as decimal
+# start and end followed by the name, ordered by address.
+slots() {
+  sed -n '/^Assigned virtual address space slots/h
+	  /^Assigned virtual address space slots/!H
+	  ${x;p}' layout5.log \
+    | sed -n 's,^\(.*/\)\?\(layout5lib[0-9]*\.so\) *\([0-9a-f]*\)-\([0-9a-f]*\)$,\2 \3 \4,p' \
+    | while read name start end; do
+      echo $((0x$start)) $((0x$end)) $name
+    done | sort -n
+}
+# Succeed if the lowest slots are those of libraries $@, in this order
+# and on 2MB boundaries.
+check_hot() {
+  slots | awk -v names="$*" '
+    BEGIN { nhot = split(names, hot) }
+    NR <= nhot && ($3 != hot[NR] || $1 % 2097152) { exit 1 }
+    END { if (NR < nhot) exit 1 }'
+}
+echo 'layout5lib3.so
+# Comments and empty lines are ignored.
+
+layout5lib1.so' > layout5.hot
+echo $PRELINK -v --hot-libs=layout5.hot ./layout5 > layout5.log
+$PRELINK -v --hot-libs=layout5.hot ./layout5 >> layout5.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout5.log && exit 2
+grep -q '^Laying out 2 hot libraries on 0x200000 boundaries$' layout5.log \
+  || exit 3
+check_hot layout5lib3.so layout5lib1.so || exit 4
+LD_LIBRARY_PATH=. ./layout5 || exit 5
+# layout5lib2.so is used by every binary, so after the dynamic linker
+# and libc it is the most widely used library.
+for i in $LIBS $BINS; do cp -p $i.orig $i; done
+rm -f prelink.cache
+echo $PRELINK -v --hot-libs-count=3 ./layout5 ./layout5b ./layout5c >> layout5.log
+$PRELINK -v --hot-libs-count=3 ./layout5 ./layout5b ./layout5c >> layout5.log 2>&1 || exit 6
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout5.log && exit 7
+grep '^Laying out [0-9]* hot' layout5.log | tail -n 1 \
+  | grep -q '^Laying out 3 hot libraries' || exit 8
+check_hot layout5lib2.so || exit 9
+for i in $BINS; do
+  LD_LIBRARY_PATH=. ./$i || exit 10
+done
+readelf -a ./layout5 >> layout5.log 2>&1 || exit 11
+rm -f layout5.hot
+# So that it is not prelinked again
+chmod -x ./layout5 ./layout5b ./layout5c
+comparelibs >> layout5.log 2>&1 || exit 12
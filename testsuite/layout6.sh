@@ -0,0 +1,48 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that --layout-cluster gives libraries used together by most
+# binaries adjacent slots, even if they are not used equally widely.
+rm -f prelink.cache
+rm -f layout6[a-e] layout6lib*.so layout6.log
+BINS="layout6a layout6b layout6c layout6d layout6e"
+LIBS=
+# layout6lib1.so is the biggest one, so without --layout-cluster it is
+# laid out first, followed by layout6lib2.so to layout6lib4.so, which
+# are used as widely, and then layout6lib5.so.
+$CC -shared -fpic -DLAYOUTLIB_SIZE=65536 -o layout6lib1.so $srcdir/layout3lib.c
+i=2
+while [ $i -lt 6 ]; do
+  $CC -shared -fpic -o layout6lib$i.so $srcdir/layout3lib.c
+  i=`expr $i + 1`
+done
+LIBS="layout6lib1.so layout6lib2.so layout6lib3.so layout6lib4.so layout6lib5.so"
+# But layout6lib1.so is used together with layout6lib5.so by two
+# binaries and with each of the others only by one.
+$CCLINK -o layout6a $srcdir/layout3.c -Wl,--no-as-needed \
+  layout6lib1.so layout6lib5.so
+$CCLINK -o layout6b $srcdir/layout3.c -Wl,--no-as-needed \
+  layout6lib1.so layout6lib5.so
+$CCLINK -o layout6c $srcdir/layout3.c -Wl,--no-as-needed \
+  layout6lib1.so layout6lib2.so layout6lib3.so layout6lib4.so
+$CCLINK -o layout6d $srcdir/layout3.c -Wl,--no-as-needed \
+  layout6lib2.so layout6lib3.so layout6lib4.so
+$CCLINK -o layout6e $srcdir/layout3.c -Wl,--no-as-needed \
+  layout6lib2.so layout6lib3.so layout6lib4.so
+savelibs
+echo $PRELINK -v --layout-cluster $BINS > layout6.log
+$PRELINK -v --layout-cluster $BINS >> layout6.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout6.log && exit 2
+# Ordered by address, layout6lib5.so has to follow layout6lib1.so.
+sed -n 's,^\(.*/\)\?\(layout6lib[0-9]*\.so\) *\([0-9a-f]*\)-[0-9a-f]*$,\3 \2,p' \
+  layout6.log | sort | awk '{ print $2 }' > layout6.order
+cat layout6.order >> layout6.log
+grep -A1 '^layout6lib1\.so$' layout6.order | tail -n 1 \
+  | grep -q '^layout6lib5\.so$' || exit 3
+rm -f layout6.order
+for i in $BINS; do
+  LD_LIBRARY_PATH=. ./$i || exit 4
+done
+readelf -a ./layout6c >> layout6.log 2>&1 || exit 5
+# So that it is not prelinked again
+chmod -x $BINS
+comparelibs >> layout6.log 2>&1 || exit 6
@@ -0,0 +1,42 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that libraries are laid out into the first hole big enough
+# for them between already prelinked libraries.
+rm -f prelink.cache
+rm -f layout7a layout7b layout7lib*.so layout7.log
+BINS="layout7a layout7b"
+LIBS="layout7lib1.so layout7lib2.so layout7lib3.so layout7lib4.so"
+for i in 1 2 3 4; do
+  $CC -shared -fpic -o layout7lib$i.so $srcdir/layout3lib.c
+done
+$CCLINK -o layout7a $srcdir/layout3.c -Wl,--no-as-needed \
+  layout7lib1.so layout7lib2.so layout7lib3.so
+# Print the base address of $1.
+base() {
+  readelf -Wl $1 | awk '$1 == "LOAD" { print $3; exit }'
+}
+echo $PRELINK -v ./layout7a > layout7.log
+$PRELINK -v ./layout7a >> layout7.log 2>&1 || exit 1
+for i in 1 2 3; do
+  eval base$i=`base layout7lib$i.so`
+done
+# Make the slot of layout7lib2.so a hole too small for its new
+# version, but big enough for layout7lib4.so.
+$CC -shared -fpic -DLAYOUTLIB_SIZE=1048576 -o layout7lib2.so \
+  $srcdir/layout3lib.c
+$CCLINK -o layout7b $srcdir/layout3.c -Wl,--no-as-needed \
+  layout7lib1.so layout7lib2.so layout7lib3.so layout7lib4.so
+savelibs
+echo $PRELINK -v ./layout7a ./layout7b >> layout7.log
+$PRELINK -v ./layout7a ./layout7b >> layout7.log 2>&1 || exit 2
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout7.log && exit 3
+test `base layout7lib1.so` = $base1 || exit 4
+test `base layout7lib3.so` = $base3 || exit 5
+test `base layout7lib4.so` = $base2 || exit 6
+test $((`base layout7lib2.so`)) -gt $(($base3)) || exit 7
+LD_LIBRARY_PATH=. ./layout7a || exit 8
+LD_LIBRARY_PATH=. ./layout7b || exit 9
+readelf -a ./layout7b >> layout7.log 2>&1 || exit 10
+# So that it is not prelinked again
+chmod -x ./layout7a ./layout7b
+comparelibs >> layout7.log 2>&1 || exit 11
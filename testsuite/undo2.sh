@@ -0,0 +1,26 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that compressed .gnu.prelink_undo sections can be undone and verified.
+rm -f undo2 undo2lib*.so undo2.log
+rm -f prelink.cache
+$CC -shared -O2 -fpic -o undo2lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -fpic -o undo2lib2.so $srcdir/reloc1lib2.c undo2lib1.so
+BINS="undo2"
+LIBS="undo2lib1.so undo2lib2.so"
+$CCLINK -o undo2 $srcdir/reloc1.c -Wl,--rpath-link,. undo2lib2.so -lc undo2lib1.so
+savelibs
+echo $PRELINK ${PRELINK_OPTS--vm} --compress-undo ./undo2 > undo2.log
+$PRELINK ${PRELINK_OPTS--vm} --compress-undo ./undo2 >> undo2.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` undo2.log && exit 2
+LD_LIBRARY_PATH=. ./undo2 || exit 3
+readelf -a ./undo2 >> undo2.log 2>&1 || exit 4
+for i in undo2 undo2lib1.so undo2lib2.so; do
+  readelf -x .gnu.prelink_undo $i | grep -q '0x00000000 7f504c55' || exit 8
+done
+# So that it is not prelinked again
+chmod -x ./undo2
+echo $PRELINK -uo undo2.undo undo2 >> undo2.log
+$PRELINK -uo undo2.undo undo2 >> undo2.log 2>&1 || exit 5
+cmp -s undo2.undo undo2.orig >> undo2.log 2>&1 || exit 6
+rm -f undo2.undo
+comparelibs >> undo2.log 2>&1 || exit 7
@@ -0,0 +1,31 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that prelink -ua -j undoes everything, including hardlinks.
+PRELINK=`echo $PRELINK | sed -e 's, \./prelink\.conf, undoall1.tree/prelink.conf,'`
+rm -rf undoall1.tree
+rm -f undoall1lib*.so undoall1.log
+rm -f prelink.cache
+mkdir -p undoall1.tree/bin
+$CC -shared -O2 -fpic -o undoall1lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -fpic -o undoall1lib2.so $srcdir/reloc1lib2.c undoall1lib1.so
+BINS="undoall1.tree/bin/undoall1"
+LIBS="undoall1lib1.so undoall1lib2.so"
+$CCLINK -o undoall1.tree/bin/undoall1 $srcdir/reloc1.c -Wl,--rpath-link,. undoall1lib2.so -lc undoall1lib1.so
+savelibs
+chmod 644 undoall1.tree/bin/undoall1.orig
+ln undoall1.tree/bin/undoall1 undoall1.tree/bin/undoall1.link
+echo undoall1.tree/bin > undoall1.tree/prelink.conf
+echo $PRELINK ${PRELINK_OPTS--vm} -a > undoall1.log
+$PRELINK ${PRELINK_OPTS--vm} -a >> undoall1.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` undoall1.log && exit 2
+LD_LIBRARY_PATH=. undoall1.tree/bin/undoall1 || exit 3
+readelf -S undoall1.tree/bin/undoall1 | grep -q .gnu.prelink_undo || exit 4
+echo $PRELINK -v -ua -j 2 >> undoall1.log
+$PRELINK -v -ua -j 2 >> undoall1.log 2>&1 || exit 5
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` undoall1.log && exit 6
+cmp -s undoall1.tree/bin/undoall1 undoall1.tree/bin/undoall1.orig || exit 7
+test undoall1.tree/bin/undoall1 -ef undoall1.tree/bin/undoall1.link || exit 8
+for i in $LIBS; do
+  cmp -s $i $i.orig || exit 9
+done
+exit 0
@@ -0,0 +1,29 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that --verify handles many files at once in the right order.
+rm -f verify1 verify1lib*.so verify1.log verify1.new verify1.first verify1.second
+rm -f prelink.cache
+$CC -shared -O2 -fpic -o verify1lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -fpic -o verify1lib2.so $srcdir/reloc1lib2.c verify1lib1.so
+BINS="verify1"
+LIBS="verify1lib1.so verify1lib2.so"
+$CCLINK -o verify1 $srcdir/reloc1.c -Wl,--rpath-link,. verify1lib2.so -lc verify1lib1.so
+savelibs
+echo $PRELINK ${PRELINK_OPTS--vm} ./verify1 > verify1.log
+$PRELINK ${PRELINK_OPTS--vm} ./verify1 >> verify1.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` verify1.log && exit 2
+LD_LIBRARY_PATH=. ./verify1 || exit 3
+for i in $LIBS $BINS; do
+  echo "`md5sum < $i.orig | sed 's/ .*$//'`  $i"
+done > verify1.first
+echo verify1lib2.so > verify1.new
+echo verify1 >> verify1.new
+echo $PRELINK --md5 -y -j 2 verify1lib1.so --files-from=verify1.new >> verify1.log
+$PRELINK --md5 -y -j 2 verify1lib1.so --files-from=verify1.new > verify1.second 2>> verify1.log || exit 4
+cmp -s verify1.first verify1.second || exit 5
+echo $PRELINK --md5 -y $LIBS $BINS >> verify1.log
+$PRELINK --md5 -y $LIBS $BINS > verify1.second 2>> verify1.log || exit 6
+cmp -s verify1.first verify1.second || exit 7
+rm -f verify1.second
+comparelibs >> verify1.log 2>&1 || exit 8
+exit 0
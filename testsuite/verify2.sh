@@ -0,0 +1,38 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check the --sha256 and --blake3 digests printed by --verify.
+rm -f verify2 verify2lib*.so verify2.log verify2.first verify2.second
+rm -f prelink.cache
+$CC -shared -O2 -fpic -o verify2lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -fpic -o verify2lib2.so $srcdir/reloc1lib2.c verify2lib1.so
+BINS="verify2"
+LIBS="verify2lib1.so verify2lib2.so"
+$CCLINK -o verify2 $srcdir/reloc1.c -Wl,--rpath-link,. verify2lib2.so -lc verify2lib1.so
+savelibs
+echo $PRELINK ${PRELINK_OPTS--vm} ./verify2 > verify2.log
+$PRELINK ${PRELINK_OPTS--vm} ./verify2 >> verify2.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` verify2.log && exit 2
+LD_LIBRARY_PATH=. ./verify2 || exit 3
+for i in $LIBS $BINS; do
+  echo "`sha256sum < $i.orig | sed 's/ .*$//'`  $i"
+done > verify2.first
+echo $PRELINK --sha256 -y $LIBS $BINS >> verify2.log
+$PRELINK --sha256 -y $LIBS $BINS > verify2.second 2>> verify2.log || exit 4
+cmp -s verify2.first verify2.second || exit 5
+# Both the accelerated and the plain C kernels must give the same result.
+echo $PRELINK --blake3 -y $LIBS $BINS >> verify2.log
+$PRELINK --blake3 -y $LIBS $BINS > verify2.first 2>> verify2.log || exit 6
+PRELINK_DIGEST_C=1 $PRELINK --blake3 -y $LIBS $BINS > verify2.second 2>> verify2.log || exit 7
+cmp -s verify2.first verify2.second || exit 8
+PRELINK_DIGEST_C=1 $PRELINK --sha256 -y $LIBS $BINS > verify2.second 2>> verify2.log || exit 9
+for i in $LIBS $BINS; do
+  echo "`sha256sum < $i.orig | sed 's/ .*$//'`  $i"
+done | cmp -s - verify2.second || exit 10
+if type b3sum > /dev/null 2>&1; then
+  for i in $LIBS $BINS; do
+    echo "`b3sum < $i.orig | sed 's/ .*$//'`  $i"
+  done | cmp -s - verify2.first || exit 11
+fi
+rm -f verify2.first verify2.second
+comparelibs >> verify2.log 2>&1 || exit 12
+exit 0
@@ -0,0 +1,58 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Check that --fast-verify gives the same result as --verify, skips
+# prelinking unchanged files again and notices modified ones.
+rm -f verify3 verify3lib*.so verify3.log verify3.first verify3.second
+rm -f verify3.third
+rm -f prelink.cache
+$CC -shared -O2 -fpic -o verify3lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -fpic -o verify3lib2.so $srcdir/reloc1lib2.c verify3lib1.so
+BINS="verify3"
+LIBS="verify3lib1.so verify3lib2.so"
+$CCLINK -o verify3 $srcdir/reloc1.c -Wl,--rpath-link,. verify3lib2.so -lc verify3lib1.so
+savelibs
+echo $PRELINK ${PRELINK_OPTS--vm} ./verify3 > verify3.log
+$PRELINK ${PRELINK_OPTS--vm} ./verify3 >> verify3.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` verify3.log && exit 2
+LD_LIBRARY_PATH=. ./verify3 || exit 3
+for i in $LIBS $BINS; do
+  echo "`md5sum < $i.orig | sed 's/ .*$//'`  $i"
+done > verify3.first
+echo $PRELINK --fast-verify --md5 -y $LIBS $BINS >> verify3.log
+$PRELINK --fast-verify --md5 -y $LIBS $BINS > verify3.second 2>> verify3.log || exit 4
+cmp -s verify3.first verify3.second || exit 5
+for i in $LIBS $BINS; do
+  echo $PRELINK --fast-verify -y $i >> verify3.log
+  $PRELINK --fast-verify -y $i > verify3.second 2>> verify3.log || exit 6
+  cmp -s $i.orig verify3.second || exit 7
+done
+# With unchanged files, the checksum is enough.
+echo $PRELINK --fast-verify -v --md5 -y $LIBS $BINS >> verify3.log
+$PRELINK --fast-verify -v --md5 -y $LIBS $BINS > verify3.second 2> verify3.third || exit 8
+cat verify3.third >> verify3.log
+for i in $LIBS $BINS; do
+  grep -q ": $i: checksum matches, not prelinking it again\$" verify3.third \
+    || exit 9
+done
+grep 'prelinking it again$' verify3.third \
+  | grep -v -q 'not prelinking it again$' && exit 10
+# Change the value of bar in verify3lib1.so.  The checksum no longer
+# matches, so it is prelinked again and the difference is found.
+cp -p verify3lib1.so verify3lib1.so.new
+set -- `readelf -WS verify3lib1.so | sed -n 's/^ *\[ *[0-9]*\] //p' \
+	| awk '$1 == ".data" { print $3, $4 }'`
+bar=`readelf -Ws verify3lib1.so | awk '$8 == "bar" { print $2; exit }'`
+test -n "$2" -a -n "$bar" || exit 11
+printf '\052' | dd of=verify3lib1.so bs=1 seek=$((0x$bar - 0x$1 + 0x$2)) \
+  conv=notrunc 2> /dev/null || exit 12
+echo $PRELINK --fast-verify -v -y verify3lib1.so >> verify3.log
+$PRELINK --fast-verify -v -y verify3lib1.so > verify3.second 2> verify3.third && exit 13
+cat verify3.third >> verify3.log
+grep -q ': verify3lib1.so: checksum does not match, prelinking it again$' \
+  verify3.third || exit 14
+grep -q ': verify3lib1.so: prelinked file was modified$' verify3.third \
+  || exit 15
+mv -f verify3lib1.so.new verify3lib1.so
+rm -f verify3.first verify3.second verify3.third
+comparelibs >> verify3.log 2>&1 || exit 16
+exit 0